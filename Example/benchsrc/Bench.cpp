@@ -0,0 +1,518 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/Allocations.hpp"
+#include "../src/Main.hpp"
+#include "../src/Stroke.hpp"
+#include "../src/EventRecorder.hpp"
+
+// Definition of extern var from tools.hpp
+booba::ApplicationContext* booba::APPCONTEXT = nullptr;
+
+// Headless benchmark of plugin and rendering paths.
+// Plugins are loaded the same way Canvas does, every tool replays the same event stream against offscreen image.
+// Usage: Bench.out [--plugins dir] [--strokes n] [--seed n] [--replay log] [--no-render] [--layers n] [--max-p99-us n]
+// With --replay events recorded by Graph.out --record are replayed instead of random strokes.
+// With --layers tools draw on the top of n layers, so tree tick includes their composite.
+// With --max-p99-us exit code is 1 if p99 latency of any tool apply is above it, so CI can catch regressions.
+
+using BenchClock = std::chrono::steady_clock;
+
+const uint32_t BenchImageWidth  = MainCanvasWidth;
+const uint32_t BenchImageHeight = MainCanvasHeight;
+
+const uint32_t DefaultBenchStrokes = 200;
+const uint32_t BenchStrokeMoves    = 64;
+const int32_t  BenchMaxMoveStep    = 12;
+// Every n-th stroke is a single click
+const uint32_t BenchClickPeriod    = 8;
+
+const uint32_t BenchDrawIterations = 50;
+
+struct BenchOptions {
+    std::string pluginsPath;
+    std::string replayPath;
+    uint32_t strokes;
+    uint32_t seed;
+    bool isRendering;
+    uint32_t layers;
+    double maxP99Us;
+};
+
+// Move of stroke keeps its resampled points. Like in Canvas, tool with batched events gets them
+// as StrokeMoved instead of the move, so every move is at most one event for every tool.
+struct BenchEvent {
+    Event event;
+    bool isStroke;
+    std::vector<CordsPair> points;
+    // Positions of moves merged into this one, tools without batched events get a move per position like in Canvas
+    std::vector<CordsPair> moves;
+};
+
+class LatencySamples {
+    private:
+        std::vector<uint64_t> samples_;
+
+    public:
+        LatencySamples() :
+        samples_()
+        {}
+
+        // Samples are reserved before measuring, so they don't show in allocations count
+        void Reserve(size_t amount) {
+            samples_.reserve(amount);
+        }
+
+        void Add(BenchClock::duration duration) {
+            samples_.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+        }
+
+        uint64_t GetAmount() const {
+            return samples_.size();
+        }
+
+        // Microseconds
+        double GetPercentile(double percentile) {
+            if (samples_.empty()) {
+                return 0;
+            }
+
+            size_t sampleIdx = std::min(size_t(double(samples_.size()) * percentile / 100), samples_.size() - 1);
+            std::nth_element(samples_.begin(), samples_.begin() + int64_t(sampleIdx), samples_.end());
+
+            return double(samples_[sampleIdx]) / 1e3;
+        }
+
+        double GetTotalSeconds() const {
+            uint64_t totalNs = 0;
+
+            for (auto& curSample : samples_) {
+                totalNs += curSample;
+            }
+
+            return double(totalNs) / 1e9;
+        }
+
+        void Print(const char* name) {
+            fprintf(stdout, "  %-12s p50 %9.2lf us, p90 %9.2lf us, p99 %9.2lf us, max %9.2lf us\n",
+                    name, GetPercentile(50), GetPercentile(90), GetPercentile(99), GetPercentile(100));
+        }
+};
+
+// Offscreen root of widget tree, its texture isn't placed anywhere
+class BenchRoot : public Window {
+    public:
+        BenchRoot(uint32_t width, uint32_t height) :
+        Window(0, 0, width, height)
+        {}
+
+        virtual void PlaceTexture() override {}
+};
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+    options = {DefaultToolsPath, "", DefaultBenchStrokes, 1, true, 1, 0};
+
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        bool hasValue = (argIdx + 1 < argc);
+
+        if (!strcmp(argv[argIdx], "--no-render")) {
+            options.isRendering = false;
+        }
+        else if (!strcmp(argv[argIdx], "--plugins") && hasValue) {
+            options.pluginsPath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--strokes") && hasValue) {
+            options.strokes = uint32_t(strtoul(argv[++argIdx], nullptr, 10));
+        }
+        else if (!strcmp(argv[argIdx], "--replay") && hasValue) {
+            options.replayPath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--seed") && hasValue) {
+            options.seed = uint32_t(strtoul(argv[++argIdx], nullptr, 10));
+        }
+        else if (!strcmp(argv[argIdx], "--layers") && hasValue) {
+            options.layers = std::clamp(uint32_t(strtoul(argv[++argIdx], nullptr, 10)), 1u, MaxLayers);
+        }
+        else if (!strcmp(argv[argIdx], "--max-p99-us") && hasValue) {
+            options.maxP99Us = strtod(argv[++argIdx], nullptr);
+        }
+        else {
+            fprintf(stderr, "Unknown argument %s\n", argv[argIdx]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static BenchEvent MakeButtonEvent(EventType type, const CordsPair& cords) {
+    BenchEvent benchEvent = {};
+
+    benchEvent.event.type_ = type;
+    benchEvent.event.Oleg_.mbedata.x      = cords.x;
+    benchEvent.event.Oleg_.mbedata.y      = cords.y;
+    benchEvent.event.Oleg_.mbedata.button = MouseButton::Left;
+
+    return benchEvent;
+}
+
+// Random walk strokes, resampled by StrokeSampler like in Canvas. Same seed gives the same stream.
+static std::vector<BenchEvent> GenerateStrokes(uint32_t strokesAmount, uint32_t seed) {
+    std::mt19937 random(seed);
+
+    std::uniform_int_distribution<int32_t> startX(0, int32_t(BenchImageWidth) - 1);
+    std::uniform_int_distribution<int32_t> startY(0, int32_t(BenchImageHeight) - 1);
+    std::uniform_int_distribution<int32_t> step(-BenchMaxMoveStep, BenchMaxMoveStep);
+
+    std::vector<BenchEvent> stream;
+    StrokeSampler sampler;
+
+    for (uint32_t strokeIdx = 0; strokeIdx < strokesAmount; strokeIdx++) {
+        CordsPair cords = {startX(random), startY(random)};
+
+        stream.push_back(MakeButtonEvent(EventType::MousePressed, cords));
+
+        if (strokeIdx % BenchClickPeriod == 0) {
+            stream.push_back(MakeButtonEvent(EventType::MouseReleased, cords));
+            continue;
+        }
+
+        sampler.Begin(cords);
+
+        for (uint32_t moveIdx = 0; moveIdx < BenchStrokeMoves; moveIdx++) {
+            CordsPair newCords = {std::clamp(cords.x + step(random), 0, int32_t(BenchImageWidth)  - 1),
+                                  std::clamp(cords.y + step(random), 0, int32_t(BenchImageHeight) - 1)};
+
+            sampler.ClearPoints();
+            sampler.AddSample(newCords);
+
+            BenchEvent moveEvent = {};
+            moveEvent.event.type_ = EventType::MouseMoved;
+            moveEvent.event.Oleg_.motion = {newCords.x, newCords.y, newCords.x - cords.x, newCords.y - cords.y};
+            moveEvent.isStroke = true;
+            moveEvent.points   = sampler.GetPoints();
+
+            stream.push_back(moveEvent);
+            cords = newCords;
+        }
+
+        sampler.End();
+
+        stream.push_back(MakeButtonEvent(EventType::MouseReleased, cords));
+    }
+
+    return stream;
+}
+
+static bool IsOnCanvas(const CordsPair& cords) {
+    return (cords.x >= 0) && (cords.y >= 0) && (cords.x < int32_t(BenchImageWidth)) && (cords.y < int32_t(BenchImageHeight));
+}
+
+// Events of window are turned into events of tool like Canvas does with default view: moves of one frame
+// are merged into the last move with resampled stroke points. Recorded pan and zoom are not applied.
+static bool LoadReplay(const char* path, std::vector<BenchEvent>& stream) {
+    EventReplayer replayer;
+
+    if (!replayer.Open(path)) {
+        return false;
+    }
+
+    std::vector<RecordedEvent> frame;
+    int64_t frameTime = 0;
+
+    StrokeSampler sampler;
+    CordsPair lastCords = {0, 0};
+    std::vector<CordsPair> frameMoves;
+
+    auto flushMoves = [&]() {
+        if (frameMoves.empty()) {
+            return;
+        }
+
+        BenchEvent moveEvent = {};
+        moveEvent.event.type_ = EventType::MouseMoved;
+        moveEvent.event.Oleg_.motion = {lastCords.x, lastCords.y, 0, 0};
+        moveEvent.moves = frameMoves;
+
+        if (sampler.IsActive()) {
+            moveEvent.isStroke = true;
+            moveEvent.points   = sampler.GetPoints();
+        }
+
+        sampler.ClearPoints();
+
+        if (moveEvent.isStroke || std::any_of(frameMoves.begin(), frameMoves.end(), IsOnCanvas)) {
+            stream.push_back(moveEvent);
+        }
+
+        frameMoves.clear();
+    };
+
+    while (replayer.NextFrame(frame, frameTime)) {
+        for (auto& curRecorded : frame) {
+            const Event& curEvent = curRecorded.event;
+
+            if (curEvent.type_ == EventType::MouseMoved) {
+                lastCords = {curEvent.Oleg_.motion.x - int32_t(MainCanvasX), curEvent.Oleg_.motion.y - int32_t(MainCanvasY)};
+                frameMoves.push_back(lastCords);
+
+                if (sampler.IsActive()) {
+                    sampler.AddSample(lastCords);
+                }
+
+                continue;
+            }
+
+            flushMoves();
+
+            if ((curEvent.type_ != EventType::MousePressed) && (curEvent.type_ != EventType::MouseReleased)) {
+                continue;
+            }
+
+            CordsPair cords = {curEvent.Oleg_.mbedata.x - int32_t(MainCanvasX), curEvent.Oleg_.mbedata.y - int32_t(MainCanvasY)};
+
+            if ((curEvent.type_ == EventType::MousePressed) && (curEvent.Oleg_.mbedata.button == MouseButton::Left) && IsOnCanvas(cords)) {
+                sampler.Begin(cords);
+                stream.push_back(MakeButtonEvent(EventType::MousePressed, cords));
+            }
+            else if ((curEvent.type_ == EventType::MouseReleased) && sampler.IsActive()) {
+                sampler.End();
+                stream.push_back(MakeButtonEvent(EventType::MouseReleased, cords));
+            }
+        }
+
+        flushMoves();
+    }
+
+    fprintf(stdout, "Replay %s: %lu tool events, %.1lf s recorded\n", path, stream.size(), double(frameTime) / 1e6);
+    return true;
+}
+
+static uint64_t GetDirtyArea(const Image& image) {
+    uint64_t area = 0;
+
+    for (auto& curRect : image.GetDirty().GetRects()) {
+        area += uint64_t(curRect.width) * curRect.height;
+    }
+
+    return area;
+}
+
+// Returns p99 of apply in microseconds
+static double BenchTool(uint64_t toolIdx, std::vector<BenchEvent>& stream, Image& image, ImageWindow* imageWindow, BenchRoot* root) {
+    ToolManager& toolManager = ToolManager::GetInstance();
+    booba::Tool* tool = toolManager.GetTool(toolIdx);
+
+    toolManager.SelectTool(tool);
+
+    std::string name = PluginManager::GetInstance().GetPluginName(tool);
+    fprintf(stdout, "Tool %lu (%s, %s)\n", toolIdx, name.empty() ? "host" : name.c_str(), tool->getTexture());
+
+    image.Create(BenchImageWidth, BenchImageHeight, 0xffffffff);
+
+    // New image is taken by tile cache before measuring
+    if (root) {
+        imageWindow->SetChanged();
+        root->OnTick(Event());
+    }
+
+    image.ClearDirty();
+
+    booba::Filter* tileFilter = toolManager.GetActiveTileFilter();
+
+    if (tileFilter) {
+        BenchClock::time_point start = BenchClock::now();
+
+        FilterJob filterJob(&image, tileFilter, toolManager.IsActiveCapable(booba::AbiTileParallel));
+        filterJob.Start();
+        filterJob.Wait();
+        filterJob.Commit();
+
+        double seconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+        fprintf(stdout, "  tile filter  %.2lf ms, %.3le pixels/s\n", seconds * 1e3, double(BenchImageWidth) * BenchImageHeight / seconds);
+
+        return 0;
+    }
+
+    LatencySamples applySamples;
+    LatencySamples tickSamples;
+    uint64_t pixelsAmount = 0;
+
+    applySamples.Reserve(stream.size());
+    tickSamples.Reserve(stream.size());
+
+    uint64_t startAllocations = GetAllocationsTotal();
+
+    bool isBatched = toolManager.IsActiveCapable(booba::AbiBatchedEvents);
+
+    auto applyEvent = [&](const Event& toolEvent) {
+        booba::Event stEvent = ConvertToPluginEvent(toolEvent);
+
+        BenchClock::time_point start = BenchClock::now();
+        toolManager.ApplyActive(&image, &stEvent);
+        applySamples.Add(BenchClock::now() - start);
+
+        pixelsAmount += GetDirtyArea(image);
+
+        if (!root) {
+            image.ClearDirty();
+            return;
+        }
+
+        imageWindow->SetChanged();
+
+        start = BenchClock::now();
+        root->OnTick(Event());
+        tickSamples.Add(BenchClock::now() - start);
+    };
+
+    // Last position sent to tool, relative motion of replayed moves is counted from it
+    CordsPair lastToolPos = {0, 0};
+
+    for (auto& curEvent : stream) {
+        Event toolEvent = curEvent.event;
+
+        if (isBatched && curEvent.isStroke) {
+            if (curEvent.points.empty()) {
+                continue;
+            }
+
+            toolEvent.type_ = EventType::StrokeMoved;
+            toolEvent.Oleg_.stedata.points = curEvent.points.data();
+            toolEvent.Oleg_.stedata.count  = uint32_t(curEvent.points.size());
+        }
+        else if (!curEvent.moves.empty()) {
+            for (auto& curMove : curEvent.moves) {
+                if (!IsOnCanvas(curMove)) {
+                    continue;
+                }
+
+                toolEvent.Oleg_.motion = {curMove.x, curMove.y, curMove.x - lastToolPos.x, curMove.y - lastToolPos.y};
+                lastToolPos = curMove;
+
+                applyEvent(toolEvent);
+            }
+
+            continue;
+        }
+
+        if (toolEvent.type_ == EventType::MouseMoved) {
+            lastToolPos = {toolEvent.Oleg_.motion.x, toolEvent.Oleg_.motion.y};
+        }
+        else if ((toolEvent.type_ == EventType::MousePressed) || (toolEvent.type_ == EventType::MouseReleased)) {
+            lastToolPos = {toolEvent.Oleg_.mbedata.x, toolEvent.Oleg_.mbedata.y};
+        }
+
+        applyEvent(toolEvent);
+    }
+
+    uint64_t allocations = GetAllocationsTotal() - startAllocations;
+
+    double applySeconds = std::max(applySamples.GetTotalSeconds(), 1e-9);
+
+    fprintf(stdout, "  %lu events, %.3le events/s, %.3le pixels/s\n", applySamples.GetAmount(),
+            double(applySamples.GetAmount()) / applySeconds, double(pixelsAmount) / applySeconds);
+
+    applySamples.Print("apply");
+
+    if (root) {
+        tickSamples.Print("tree tick");
+    }
+
+    // Apply and tick shouldn't allocate once caches are warm, count shows regressions
+    fprintf(stdout, "  allocations  %lu, %.3lf per event\n", allocations, double(allocations) / double(std::max(applySamples.GetAmount(), uint64_t(1))));
+
+    return applySamples.GetPercentile(99);
+}
+
+// Full image is uploaded and drawn every iteration
+static void BenchImageDraw(Image& image) {
+    Surface surface;
+    surface.create(BenchImageWidth, BenchImageHeight);
+
+    LatencySamples drawSamples;
+
+    for (uint32_t iteration = 0; iteration < BenchDrawIterations; iteration++) {
+        image.MarkDirty();
+
+        BenchClock::time_point start = BenchClock::now();
+        image.Draw(surface, {0, 0}, {0, 0}, BenchImageWidth, BenchImageHeight);
+        surface.display();
+        drawSamples.Add(BenchClock::now() - start);
+    }
+
+    fprintf(stdout, "Image::Draw of %ux%u\n", BenchImageWidth, BenchImageHeight);
+    drawSamples.Print("draw");
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options = {};
+
+    if (!ParseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    booba::APPCONTEXT = new booba::ApplicationContext();
+    booba::APPCONTEXT->fgColor = 0xFF0000FF;
+
+    PluginManager::GetInstance().LoadAll(options.pluginsPath);
+
+    ToolManager& toolManager = ToolManager::GetInstance();
+
+    if (!toolManager.GetToolSize()) {
+        fprintf(stderr, "No tools in %s\n", options.pluginsPath.c_str());
+        return 1;
+    }
+
+    std::vector<BenchEvent> stream;
+
+    if (options.replayPath.empty()) {
+        stream = GenerateStrokes(options.strokes, options.seed);
+    }
+    else if (!LoadReplay(options.replayPath.c_str(), stream)) {
+        return 1;
+    }
+
+    // Without rendering nothing needs graphics context, so it runs on machines without display
+    Image offscreenImage(BenchImageWidth, BenchImageHeight);
+    BenchRoot* root = nullptr;
+    ImageWindow* imageWindow = nullptr;
+
+    if (options.isRendering) {
+        root = new BenchRoot(BenchImageWidth, BenchImageHeight);
+        imageWindow = new ImageWindow(0, 0, BenchImageWidth, BenchImageHeight);
+
+        *root += imageWindow;
+
+        for (uint32_t layerIdx = 1; layerIdx < options.layers; layerIdx++) {
+            imageWindow->layers_.AddLayer();
+        }
+    }
+
+    Image& image = imageWindow ? imageWindow->GetActiveImage() : offscreenImage;
+
+    bool isOverBudget = false;
+
+    for (uint64_t toolIdx = 0; toolIdx < toolManager.GetToolSize(); toolIdx++) {
+        double p99 = BenchTool(toolIdx, stream, image, imageWindow, root);
+
+        if ((options.maxP99Us > 0) && (p99 > options.maxP99Us)) {
+            fprintf(stderr, "Tool %lu: p99 %.2lf us is over %.2lf us\n", toolIdx, p99, options.maxP99Us);
+            isOverBudget = true;
+        }
+    }
+
+    if (options.isRendering) {
+        BenchImageDraw(offscreenImage);
+    }
+
+    delete booba::APPCONTEXT;
+
+    return isOverBudget ? 1 : 0;
+}
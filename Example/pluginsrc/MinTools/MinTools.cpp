@@ -5,21 +5,50 @@ void DotTool::apply(booba::Image* image, const booba::Event* event) {
         return;
     }
 
-    const int32_t sqSize = 3;
-
-    if (event->type == booba::EventType::MousePressed) {
-        uint32_t pixelsAmount = 0;
-        
-        for (int32_t curX = std::max(0, event->Oleg.mbedata.x - sqSize);     curX < std::min(int32_t(image->getX()), event->Oleg.mbedata.x + sqSize); curX++) {
-            for (int32_t curY = std::max(0, event->Oleg.mbedata.y - sqSize); curY < std::min(int32_t(image->getH()), event->Oleg.mbedata.y + sqSize); curY++) {
-                image->putPixel(curX, curY, booba::APPCONTEXT->fgColor);
-                pixelsAmount++;
-            }
+    if (event->type == booba::EventType::ScrollbarMoved) {
+        if (event->Oleg.smedata.id == sizeScrollbar_) {
+            size_ = float(std::max(event->Oleg.smedata.value, 1));
+            DrawPreview();
         }
-    }   
+    }
+    else if (event->type == booba::EventType::MousePressed) {
+        booba::stampBrush(image, brush_, float(event->Oleg.mbedata.x), float(event->Oleg.mbedata.y), size_, booba::APPCONTEXT->fgColor);
+    }
+    else if (event->type == booba::EventType::StrokeMoved) {
+        booba::strokeBrush(image, brush_, event->Oleg.stedata.points, event->Oleg.stedata.count, size_, booba::APPCONTEXT->fgColor);
+    }
+}
+
+void DotTool::buildSetupWidget() {
+    booba::createLabel(10, 10, 100, 20, "Size");
+
+    sizeScrollbar_ = booba::createScrollbar(10, 40, 200, 16, MaxDotSize, int32_t(size_));
+    preview_       = booba::createCanvas(10, 70, DotPreviewSize, DotPreviewSize);
+
+    DrawPreview();
+}
+
+// Preview is redrawn pixel by pixel, host shows it once per frame
+void DotTool::DrawPreview() {
+    if (!preview_) {
+        return;
+    }
+
+    int32_t dotSize  = int32_t(size_);
+    int32_t dotStart = int32_t(DotPreviewSize / 2) - dotSize / 2;
+
+    for (int32_t curY = 0; curY < int32_t(DotPreviewSize); curY++) {
+        for (int32_t curX = 0; curX < int32_t(DotPreviewSize); curX++) {
+            bool isDot = (curX >= dotStart) && (curX < dotStart + dotSize) && (curY >= dotStart) && (curY < dotStart + dotSize);
+
+            booba::putPixel(preview_, curX, curY, isDot ? booba::APPCONTEXT->fgColor : 0xffffffff);
+        }
+    }
 }
 
 void booba::init_module() {
+    booba::reportAbi(booba::AbiVersion, sizeof(booba::Event), booba::AbiRawBuffer | booba::AbiBatchedEvents | booba::AbiAsync);
+
     DotTool* dotTool = new DotTool();
 
     booba::addTool(dotTool);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <stack>
 #include <chrono>
@@ -9,6 +10,11 @@
 
 const char DotTexture[]   = "./Icons/min/Dot.png";
 
+const float   DefaultDotSize = 6.f;
+const int32_t MaxDotSize     = 32;
+
+const uint32_t DotPreviewSize = 64;
+
 struct CordsPair {
     int32_t x;
     int32_t y;
@@ -43,16 +49,40 @@ class AbstractTool : public booba::Tool {
         }
 };
 
+// Square dots are stamped by host brush made of 1x1 full mask
 class DotTool : public AbstractTool {
+    private:
+        uint64_t brush_;
+        float size_;
+
+        uint64_t sizeScrollbar_;
+        uint64_t preview_;
+
+        void DrawPreview();
+
     public:
         DotTool() :
-        AbstractTool()
+        AbstractTool(),
+        brush_(0),
+        size_(DefaultDotSize),
+        sizeScrollbar_(0),
+        preview_(0)
         {
             toolImage_ = DotTexture;
+
+            const uint8_t fullMask = 255;
+            booba::BrushShape shape = {1.f, 0.25f, &fullMask, 1, 1};
+
+            brush_ = booba::createBrush(&shape);
         }
 
         virtual ~DotTool() {}
 
         virtual void apply(booba::Image* image, const booba::Event* event) override;
-        virtual void buildSetupWidget() override {}
+        virtual void buildSetupWidget() override;
+
+        // Dot stamps depend only on event, so they can be drawn from worker thread
+        virtual bool supportsAsync() override {
+            return true;
+        }
 };
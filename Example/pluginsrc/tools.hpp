@@ -22,6 +22,18 @@ namespace booba { // boot of outstanding best api
      */
     extern "C" void init_module();
 
+    // Module which doesn't call reportAbi from init_module is version 1: no StrokeMoved, no supportsAsync,
+    // operator() of Image works without lock, pixel by pixel, with straight colors
+    const uint32_t AbiVersion = 2;
+
+    const uint64_t AbiRawBuffer     = 1u << 0;
+    const uint64_t AbiBatchedEvents = 1u << 1;
+    const uint64_t AbiTileParallel  = 1u << 2;
+    const uint64_t AbiAsync         = 1u << 3;
+
+    // Oleg has fixed size, so new event data doesn't change layout of Event
+    const uint32_t EventDataSize = 32;
+
     enum class EventType
     {
         NoEvent        = 0,
@@ -34,6 +46,7 @@ namespace booba { // boot of outstanding best api
         CanvasMPressed  = 6,
         CanvasMReleased = 7,
         CanvasMMoved    = 8,
+        StrokeMoved     = 9,
 
     };
 
@@ -74,6 +87,17 @@ namespace booba { // boot of outstanding best api
         int32_t x, y; 
     };
 
+    struct Point
+    {
+        int32_t x, y;
+    };
+
+    struct StrokeEventData
+    {
+        const Point* points;
+        uint32_t count;
+    };
+
     class Event
     {
     public:
@@ -85,23 +109,53 @@ namespace booba { // boot of outstanding best api
             ButtonClickedEventData bcedata;
             ScrollMovedEventData smedata;
             CanvasEventData cedata;
+            StrokeEventData stedata;
+            uint8_t reserved[EventDataSize];
         } Oleg; //Object loading event group.
     };
 
+    static_assert(sizeof(Event::Oleg) == EventDataSize, "Event data must fit into EventDataSize");
+
+
+    // Granted region starts at x, y of image, it may be clipped
+    struct PixelBuffer
+    {
+        uint32_t* pixels;
+        uint32_t  w, h;
+        uint32_t  stride;
+        uint32_t  x, y;
+    };
 
     class Image
     {
     public:
         virtual uint32_t getH()     = 0;
-        virtual uint32_t getX()     = 0;
+        virtual uint32_t getW()     = 0;
         virtual uint32_t getPixel(int32_t x, int32_t y) = 0;
         virtual void putPixel(uint32_t x, uint32_t y, uint32_t color) = 0;        
         virtual uint32_t& operator()(uint32_t x, uint32_t y) = 0;
         virtual const uint32_t& operator()(uint32_t x, uint32_t y) const = 0;
+        virtual PixelBuffer lock(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool write) = 0;
+        virtual void unlock() = 0;
+        virtual void fillRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) = 0;
+        virtual void putSpan(int32_t x, int32_t y, uint32_t w, const uint32_t* colors) = 0;
+        virtual void blit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) = 0;
+        // Straight colors are blended over image, pixels given by lock() are premultiplied
+        virtual void blendRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) = 0;
+        virtual void blendBlit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) = 0;
     protected:
         virtual ~Image() = 0;
     };
 
+    // Round brush if mask is nullptr, otherwise maskW x maskH coverage bitmap stretched to brush size
+    struct BrushShape
+    {
+        float hardness;
+        float spacing;
+        const uint8_t* mask;
+        uint32_t maskW, maskH;
+    };
+
     struct ApplicationContext
     {
         uint32_t fgColor, bgColor;
@@ -114,20 +168,42 @@ namespace booba { // boot of outstanding best api
         virtual ~Tool() = 0;
         virtual const char* getTexture() = 0; 
         virtual void buildSetupWidget() = 0;
+        virtual bool supportsAsync() { return false; }
+    };
+
+    class Filter : public Tool
+    {
+    public:
+        virtual void applyTile(Image* src, Image* dst, uint32_t x, uint32_t y, uint32_t w, uint32_t h) = 0;
     };
 
     // This functions will be given to you;
 
-    extern "C" uint64_t createButton   (int32_t x, int32_t y, uint32_t w, uint32_t h, const char*);
-    extern "C" uint64_t createLabel    (int32_t x, int32_t y, uint32_t w, uint32_t h, const char*);
-    extern "C" uint64_t createScrollbar(int32_t x, int32_t y, uint32_t w, uint32_t h);
+    // Only during buildSetupWidget, x and y are relative to toolbar. Return 0 if widget can't be created
+    extern "C" uint64_t createButton   (int32_t x, int32_t y, uint32_t w, uint32_t h, const char* text);
+    extern "C" uint64_t createLabel    (int32_t x, int32_t y, uint32_t w, uint32_t h, const char* text);
+    extern "C" uint64_t createScrollbar(int32_t x, int32_t y, uint32_t w, uint32_t h, int32_t maxValue, int32_t startValue);
     
+    // Pixels and sprites of canvas are shown in the next frame, all changes of frame are uploaded at once
     extern "C" uint64_t createCanvas(int32_t x, int32_t y, int32_t w, int32_t h);
-    extern "C" uint64_t putPixel (uint64_t canvas, int32_t x, int32_t y, uint32_t color);
-    extern "C" uint64_t putSprite(uint64_t canvas, int32_t x, int32_t y, uint32_t w, uint32_t h, const char* texture);
+    extern "C" void putPixel (uint64_t canvas, int32_t x, int32_t y, uint32_t color);
+    extern "C" void putSprite(uint64_t canvas, int32_t x, int32_t y, uint32_t w, uint32_t h, const char* texture);
     
+    extern "C" void fillPixels(uint32_t* dst, uint32_t count, uint32_t color);
+    extern "C" void blendPixels(uint32_t* dst, const uint32_t* src, uint32_t count);
+    extern "C" void premultiplyPixels(uint32_t* dst, const uint32_t* src, uint32_t count);
+    
+    extern "C" uint64_t createBrush(const BrushShape* shape);
+    extern "C" void stampBrush (Image* image, uint64_t brush, float x, float y, float size, uint32_t color);
+    extern "C" void strokeBrush(Image* image, uint64_t brush, const Point* points, uint32_t count, float size, uint32_t color);
+
     extern "C" void addTool(Tool* tool);
+    // Filter is applied once per click, off UI thread, to copy of image which is put back when apply returns
     extern "C" void addFilter(Tool* tool);
+    extern "C" void addTileFilter(Filter* filter);
+
+    // Only from init_module, eventSize is sizeof(Event) of module
+    extern "C" void reportAbi(uint32_t version, uint32_t eventSize, uint64_t capabilities);
 
     extern ApplicationContext* APPCONTEXT;
 }
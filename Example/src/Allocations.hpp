@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// Global operator new is replaced in Allocations.cpp, it counts every allocation of process and plugins
+uint64_t GetAllocationsTotal();
@@ -0,0 +1,184 @@
+#include "AsyncTool.hpp"
+
+#include <cstring>
+
+#include "Profiler.hpp"
+
+AsyncToolRunner::AsyncToolRunner(uint32_t width, uint32_t height) :
+back_(width, height),
+backMutex_(),
+queueMutex_(),
+queueCondition_(),
+idleCondition_(),
+queue_(DefaultAsyncQueueCapacity),
+queueHead_(0),
+queueSize_(0),
+isWorking_(0),
+isStopping_(0),
+isBackStale_(1),
+worker_()
+{
+    // New image is dirty as a whole, back buffer holds nothing to merge until the first sync
+    back_.ClearDirty();
+
+    for (auto& curTask : queue_) {
+        curTask.points.reserve(DefaultAsyncPathCapacity);
+    }
+
+    worker_ = std::thread(&AsyncToolRunner::WorkerLoop, this);
+}
+
+AsyncToolRunner::~AsyncToolRunner() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        isStopping_ = 1;
+    }
+
+    queueCondition_.notify_all();
+    worker_.join();
+}
+
+void AsyncToolRunner::Push(booba::Tool* tool, const booba::Event& event) {
+    if (!tool) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+
+        if (queueSize_ == queue_.size()) {
+            // Tasks are moved in order, so new ring starts from its first slot
+            std::vector<Task> grown(queue_.size() * 2);
+
+            for (size_t taskIdx = 0; taskIdx < grown.size(); taskIdx++) {
+                if (taskIdx < queueSize_) {
+                    grown[taskIdx] = std::move(queue_[(queueHead_ + taskIdx) % queue_.size()]);
+                }
+                else {
+                    grown[taskIdx].points.reserve(DefaultAsyncPathCapacity);
+                }
+            }
+
+            queue_.swap(grown);
+            queueHead_ = 0;
+        }
+
+        Task& newTask = queue_[(queueHead_ + queueSize_) % queue_.size()];
+        queueSize_++;
+
+        newTask.tool  = tool;
+        newTask.event = event;
+
+        if (event.type == booba::EventType::StrokeMoved) {
+            newTask.points.assign(event.Oleg.stedata.points, event.Oleg.stedata.points + event.Oleg.stedata.count);
+        }
+        else {
+            newTask.points.clear();
+        }
+    }
+
+    queueCondition_.notify_one();
+}
+
+bool AsyncToolRunner::IsIdle() {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+
+    return !queueSize_ && !isWorking_;
+}
+
+void AsyncToolRunner::WorkerLoop() {
+    // Buffer of finished task goes back to ring in place of the taken one
+    Task curTask;
+    curTask.points.reserve(DefaultAsyncPathCapacity);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            queueCondition_.wait(lock, [this]() { return isStopping_ || queueSize_; });
+
+            if (!queueSize_) {
+                return;
+            }
+
+            std::swap(curTask, queue_[queueHead_]);
+            queueHead_ = (queueHead_ + 1) % queue_.size();
+            queueSize_--;
+
+            isWorking_ = 1;
+        }
+
+        if (curTask.event.type == booba::EventType::StrokeMoved) {
+            curTask.event.Oleg.stedata.points = curTask.points.data();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(backMutex_);
+            ScopedTimer timer(ProfilePhase::ToolApply, curTask.tool);
+            curTask.tool->apply(&back_, &curTask.event);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            isWorking_ = 0;
+
+            if (!queueSize_) {
+                idleCondition_.notify_all();
+            }
+        }
+    }
+}
+
+bool AsyncToolRunner::Merge(Image& front, bool isWaiting) {
+    std::unique_lock<std::mutex> lock(backMutex_, std::defer_lock);
+
+    if (isWaiting) {
+        lock.lock();
+    }
+    else if (!lock.try_lock()) {
+        return false;
+    }
+
+    if (!back_.IsDirty()) {
+        return false;
+    }
+
+    // Front write handler saves old pixels for history, so merged changes can be undone
+    for (auto& curRect : back_.GetDirty().GetRects()) {
+        const uint32_t* srcPixels = back_.GetPixels() + size_t(curRect.y) * back_.GetStride() + curRect.x;
+
+        front.BlitPremultiplied(int32_t(curRect.x), int32_t(curRect.y), curRect.width, curRect.height, srcPixels, back_.GetStride());
+    }
+
+    back_.ClearDirty();
+
+    return true;
+}
+
+bool AsyncToolRunner::Drain(Image& front) {
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        idleCondition_.wait(lock, [this]() { return !queueSize_ && !isWorking_; });
+    }
+
+    return Merge(front, true);
+}
+
+void AsyncToolRunner::Sync(const Image& front) {
+    if (!isBackStale_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(backMutex_);
+
+    // Canvas may be resized for document, back buffer follows it
+    if ((back_.width_ != front.width_) || (back_.height_ != front.height_)) {
+        back_.Create(front.width_, front.height_);
+    }
+
+    for (uint32_t curY = 0; curY < front.height_; curY++) {
+        std::memcpy(back_.GetPixels() + size_t(curY) * back_.GetStride(), front.GetPixels() + size_t(curY) * front.GetStride(), size_t(front.width_) * sizeof(uint32_t));
+    }
+
+    back_.ClearDirty();
+    isBackStale_ = 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../pluginsrc/tools.hpp"
+
+#include "Primitives.hpp"
+
+// Queue is a ring of tasks, it grows only if more events are pending than ever before
+const size_t DefaultAsyncQueueCapacity = 64;
+// Points reserved in every task, resampled stroke of one frame rarely has more
+const size_t DefaultAsyncPathCapacity  = 64;
+
+// Applies tools which support it on worker thread. Tool draws into back buffer, while canvas shows front one,
+// and changed parts of back buffer are copied to front at frame boundaries. Outside of its changes
+// back buffer is equal to front, so every write to front not made by runner must be followed by Invalidate().
+class AsyncToolRunner {
+    private:
+        struct Task {
+            booba::Tool* tool;
+            booba::Event event;
+
+            // Copy of stroke path, points of StrokeMoved are valid only during the call
+            std::vector<booba::Point> points;
+
+            Task() :
+            tool(nullptr),
+            event(),
+            points()
+            {}
+
+            // Tasks are only moved around the ring, so their point buffers aren't copied
+            Task(const Task& task)            = delete;
+            Task& operator=(const Task& task) = delete;
+
+            Task(Task&& task)            = default;
+            Task& operator=(Task&& task) = default;
+        };
+
+        Image back_;
+
+        // Held by worker while tool changes back buffer
+        std::mutex backMutex_;
+
+        std::mutex queueMutex_;
+        std::condition_variable queueCondition_;
+        std::condition_variable idleCondition_;
+
+        // Tasks and their point buffers stay in ring, worker swaps the head with its own task,
+        // so after the first strokes neither side allocates
+        std::vector<Task> queue_;
+        size_t queueHead_;
+        size_t queueSize_;
+
+        bool isWorking_;
+        bool isStopping_;
+        bool isBackStale_;
+
+        std::thread worker_;
+
+        void WorkerLoop();
+
+    public:
+        AsyncToolRunner(uint32_t width, uint32_t height);
+        ~AsyncToolRunner();
+
+        AsyncToolRunner(const AsyncToolRunner& runner)            = delete;
+        AsyncToolRunner& operator=(const AsyncToolRunner& runner) = delete;
+
+        void Push(booba::Tool* tool, const booba::Event& event);
+
+        bool IsIdle();
+
+        // Copies changes of back buffer to front. If isWaiting isn't set and worker is busy, does nothing.
+        // Returns whether front was changed
+        bool Merge(Image& front, bool isWaiting = false);
+
+        // Waits until all pushed events are applied and merges them
+        bool Drain(Image& front);
+
+        // Copies front to back if it was invalidated, runner has to be idle
+        void Sync(const Image& front);
+
+        void Invalidate() {
+            isBackStale_ = 1;
+        }
+};
@@ -0,0 +1,301 @@
+#include "BrushEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Color.hpp"
+#include "Kernels.hpp"
+#include "PixelRect.hpp"
+
+uint64_t booba::createBrush(const booba::BrushShape* shape) {
+    if (!shape) {
+        return 0;
+    }
+
+    return BrushEngine::GetInstance().CreateBrush(*shape);
+}
+
+void booba::stampBrush(booba::Image* image, uint64_t brush, float x, float y, float size, uint32_t color) {
+    StampPos stamp = {x, y};
+
+    BrushEngine::GetInstance().Stamp(image, brush, &stamp, 1, size, color);
+}
+
+// Stamps are put along polyline every spacing * size pixels, distance left after a segment is carried to the next one
+void booba::strokeBrush(booba::Image* image, uint64_t brush, const booba::Point* points, uint32_t count, float size, uint32_t color) {
+    if (!points || !count) {
+        return;
+    }
+
+    BrushEngine& engine = BrushEngine::GetInstance();
+
+    float step = std::max(engine.GetSpacing(brush) * size, 1.f);
+
+    // Every thread strokes with its own buffer, it is not freed between strokes
+    thread_local std::vector<StampPos> stamps;
+    stamps.clear();
+
+    stamps.push_back({float(points[0].x), float(points[0].y)});
+
+    float travelled = 0;
+
+    for (uint32_t pointIdx = 1; pointIdx < count; pointIdx++) {
+        float startX = float(points[pointIdx - 1].x);
+        float startY = float(points[pointIdx - 1].y);
+
+        float dx = float(points[pointIdx].x) - startX;
+        float dy = float(points[pointIdx].y) - startY;
+
+        float length = std::sqrt(dx * dx + dy * dy);
+        float dist   = step - travelled;
+
+        for (; dist <= length; dist += step) {
+            stamps.push_back({startX + dx * dist / length, startY + dy * dist / length});
+        }
+
+        travelled = length - (dist - step);
+    }
+
+    engine.Stamp(image, brush, stamps.data(), uint32_t(stamps.size()), size, color);
+}
+
+BrushEngine::BrushEngine() :
+brushes_(),
+masks_(),
+mutex_()
+{
+
+}
+
+uint64_t BrushEngine::CreateBrush(const booba::BrushShape& shape) {
+    bool hasShape = shape.mask && shape.maskW && shape.maskH;
+
+    if (!hasShape && (shape.mask || shape.maskW || shape.maskH)) {
+        fprintf(stderr, "Brush mask %ux%u is wrong\n", shape.maskW, shape.maskH);
+        return 0;
+    }
+
+    Brush brush = {std::clamp(shape.hardness, 0.f, 1.f), (shape.spacing > 0) ? shape.spacing : DefaultBrushSpacing, {}, 0, 0};
+
+    if (hasShape) {
+        brush.shape.assign(shape.mask, shape.mask + size_t(shape.maskW) * shape.maskH);
+        brush.shapeW = shape.maskW;
+        brush.shapeH = shape.maskH;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Reloaded plugin creates its brushes again, they get their old ids and cached masks
+    for (size_t brushIdx = 0; brushIdx < brushes_.size(); brushIdx++) {
+        if (IsSameBrush(brushes_[brushIdx], brush)) {
+            return brushIdx + 1;
+        }
+    }
+
+    brushes_.push_back(std::move(brush));
+    return brushes_.size();
+}
+
+// Parameters are compared bitwise, brushes are the same only if they were created from the same shape
+bool BrushEngine::IsSameBrush(const Brush& first, const Brush& second) {
+    return !std::memcmp(&first.hardness, &second.hardness, sizeof(float)) &&
+           !std::memcmp(&first.spacing,  &second.spacing,  sizeof(float)) &&
+           (first.shapeW == second.shapeW) && (first.shapeH == second.shapeH) && (first.shape == second.shape);
+}
+
+float BrushEngine::GetSpacing(uint64_t brushId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!brushId || (brushId > brushes_.size())) {
+        return DefaultBrushSpacing;
+    }
+
+    return brushes_[brushId - 1].spacing;
+}
+
+// Edge ramp is (1 - hardness) of radius wide, but not less than a pixel, so hard brushes are still antialiased
+float BrushEngine::GetRoundCoverage(const Brush& brush, float radius, float dx, float dy) {
+    float ramp = std::max(radius * (1.f - brush.hardness), 1.f);
+    float t    = std::clamp((radius - std::sqrt(dx * dx + dy * dy)) / ramp, 0.f, 1.f);
+
+    return t * t * (3.f - 2.f * t);
+}
+
+// Shape is stretched to size x size and sampled bilinearly, u and v are in [0, size]
+float BrushEngine::GetShapeCoverage(const Brush& brush, float size, float u, float v) {
+    float shapeX = std::clamp(u / size * float(brush.shapeW) - 0.5f, 0.f, float(brush.shapeW - 1));
+    float shapeY = std::clamp(v / size * float(brush.shapeH) - 0.5f, 0.f, float(brush.shapeH - 1));
+
+    uint32_t leftX = uint32_t(shapeX);
+    uint32_t topY  = uint32_t(shapeY);
+
+    uint32_t rightX = std::min(leftX + 1, brush.shapeW - 1);
+    uint32_t downY  = std::min(topY  + 1, brush.shapeH - 1);
+
+    float fracX = shapeX - float(leftX);
+    float fracY = shapeY - float(topY);
+
+    auto at = [&brush](uint32_t x, uint32_t y) {
+        return float(brush.shape[size_t(y) * brush.shapeW + x]);
+    };
+
+    float top    = at(leftX, topY)  + (at(rightX, topY)  - at(leftX, topY))  * fracX;
+    float bottom = at(leftX, downY) + (at(rightX, downY) - at(leftX, downY)) * fracX;
+
+    return (top + (bottom - top) * fracY) / 255.f;
+}
+
+// Stamp of size pixels starts at sub / BrushSubpixelSteps of the first mask pixel, so mask is a pixel wider if it is shifted
+std::shared_ptr<const BrushMask> BrushEngine::BuildMask(const Brush& brush, uint32_t size, uint32_t subX, uint32_t subY) const {
+    auto mask = std::make_shared<BrushMask>();
+
+    mask->width  = size + (subX ? 1 : 0);
+    mask->height = size + (subY ? 1 : 0);
+
+    mask->coverage.assign(size_t(mask->width) * mask->height, 0);
+
+    float shiftX = float(subX) / float(BrushSubpixelSteps);
+    float shiftY = float(subY) / float(BrushSubpixelSteps);
+
+    float sizeF  = float(size);
+    float radius = sizeF / 2.f;
+
+    for (uint32_t curY = 0; curY < mask->height; curY++) {
+        float top    = std::max(float(curY) - shiftY, 0.f);
+        float bottom = std::min(float(curY + 1) - shiftY, sizeF);
+
+        for (uint32_t curX = 0; curX < mask->width; curX++) {
+            float left  = std::max(float(curX) - shiftX, 0.f);
+            float right = std::min(float(curX + 1) - shiftX, sizeF);
+
+            if ((right <= left) || (bottom <= top)) {
+                continue;
+            }
+
+            float centerX = (left + right) / 2.f;
+            float centerY = (top + bottom) / 2.f;
+
+            float coverage = 0;
+
+            if (brush.shape.empty()) {
+                coverage = GetRoundCoverage(brush, radius, centerX - radius, centerY - radius);
+            }
+            else {
+                // Shape edges are covered by area of pixel
+                coverage = GetShapeCoverage(brush, sizeF, centerX, centerY) * (right - left) * (bottom - top);
+            }
+
+            mask->coverage[size_t(curY) * mask->width + curX] = uint8_t(std::lround(coverage * 255.f));
+        }
+    }
+
+    return mask;
+}
+
+std::shared_ptr<const BrushMask> BrushEngine::GetMask(uint64_t brushId, uint32_t size, uint32_t subX, uint32_t subY) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!brushId || (brushId > brushes_.size())) {
+        return nullptr;
+    }
+
+    uint64_t key = GetMaskKey(brushId, size, subX, subY);
+
+    auto found = masks_.find(key);
+
+    if (found != masks_.end()) {
+        return found->second;
+    }
+
+    if (masks_.size() >= MaxCachedBrushMasks) {
+        masks_.clear();
+    }
+
+    auto mask = BuildMask(brushes_[brushId - 1], size, subX, subY);
+    masks_.emplace(key, mask);
+
+    return mask;
+}
+
+void BrushEngine::Stamp(booba::Image* image, uint64_t brushId, const StampPos* stamps, uint32_t count, float size, uint32_t color) {
+    if (!image || !count || !(size > 0)) {
+        return;
+    }
+
+    uint32_t premultiplied = MyColor(color).GetPremultiplied();
+
+    if (!(premultiplied & 0xff)) {
+        return;
+    }
+
+    uint32_t sizePx = std::clamp(uint32_t(std::lround(size)), 1u, MaxBrushSize);
+    float halfSize  = float(sizePx) / 2.f;
+
+    PixelRect imageRect = {0, 0, image->getW(), image->getH()};
+
+    // Neighbouring stamps mostly have the same offset, so cache is looked up only when it changes
+    std::shared_ptr<const BrushMask> mask = nullptr;
+    uint32_t maskSubX = BrushSubpixelSteps;
+    uint32_t maskSubY = BrushSubpixelSteps;
+
+    for (uint32_t stampIdx = 0; stampIdx < count; stampIdx++) {
+        float originX = stamps[stampIdx].x - halfSize;
+        float originY = stamps[stampIdx].y - halfSize;
+
+        float floorX = std::floor(originX);
+        float floorY = std::floor(originY);
+
+        int64_t  maskX = int64_t(floorX);
+        int64_t  maskY = int64_t(floorY);
+        uint32_t subX  = uint32_t(std::lround((originX - floorX) * float(BrushSubpixelSteps)));
+        uint32_t subY  = uint32_t(std::lround((originY - floorY) * float(BrushSubpixelSteps)));
+
+        if (subX == BrushSubpixelSteps) {
+            maskX++;
+            subX = 0;
+        }
+
+        if (subY == BrushSubpixelSteps) {
+            maskY++;
+            subY = 0;
+        }
+
+        if (!mask || (subX != maskSubX) || (subY != maskSubY)) {
+            mask     = GetMask(brushId, sizePx, subX, subY);
+            maskSubX = subX;
+            maskSubY = subY;
+
+            if (!mask) {
+                return;
+            }
+        }
+
+        // Mask is clipped in signed coordinates, stamp may be partly out of image
+        int64_t left   = std::max(maskX, int64_t(0));
+        int64_t top    = std::max(maskY, int64_t(0));
+        int64_t right  = std::min(maskX + mask->width,  int64_t(imageRect.width));
+        int64_t bottom = std::min(maskY + mask->height, int64_t(imageRect.height));
+
+        if ((right <= left) || (bottom <= top)) {
+            continue;
+        }
+
+        booba::PixelBuffer buffer = image->lock(uint32_t(left), uint32_t(top), uint32_t(right - left), uint32_t(bottom - top), true);
+
+        if (!buffer.pixels || !buffer.w || !buffer.h) {
+            image->unlock();
+            continue;
+        }
+
+        // Image may clip write lock further, e.g. to tile of filter, so mask starts from granted origin
+        const uint8_t* maskRow = mask->coverage.data() + size_t(int64_t(buffer.y) - maskY) * mask->width + size_t(int64_t(buffer.x) - maskX);
+
+        for (uint32_t curY = 0; curY < buffer.h; curY++) {
+            BlendMaskedPixels(buffer.pixels + size_t(curY) * buffer.stride, maskRow + size_t(curY) * mask->width, buffer.w, premultiplied);
+        }
+
+        image->unlock();
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+
+#include "../pluginsrc/tools.hpp"
+
+// Stamp centers are snapped to 1 / BrushSubpixelSteps of pixel, every snapped offset has its own mask
+const uint32_t BrushSubpixelSteps   = 4;
+const uint32_t MaxBrushSize         = 512;
+// Whole cache is dropped when it is full, strokes usually need only a few sizes
+const uint32_t MaxCachedBrushMasks  = 1024;
+const float    DefaultBrushSpacing  = 0.25f;
+
+// Coverage of one stamp, byte per pixel, row stride is width
+struct BrushMask {
+    uint32_t width  = 0;
+    uint32_t height = 0;
+
+    std::vector<uint8_t> coverage = {};
+};
+
+struct StampPos {
+    float x;
+    float y;
+};
+
+// Shapes registered by plugins and their rasterized masks. Stamps are blended by lock of stamp rect and masked span per row.
+// Masks are shared, so stroke from worker thread keeps its masks even if cache is dropped meanwhile.
+class BrushEngine {
+    private:
+        struct Brush {
+            float hardness;
+            float spacing;
+
+            // Empty for round brush
+            std::vector<uint8_t> shape;
+            uint32_t shapeW;
+            uint32_t shapeH;
+        };
+
+        std::deque<Brush> brushes_;
+        std::unordered_map<uint64_t, std::shared_ptr<const BrushMask>> masks_;
+
+        std::mutex mutex_;
+
+        BrushEngine();
+
+        static uint64_t GetMaskKey(uint64_t brushId, uint32_t size, uint32_t subX, uint32_t subY) {
+            return (brushId << 24u) | (uint64_t(size) << 8u) | (subX << 4u) | subY;
+        }
+
+        static bool IsSameBrush(const Brush& first, const Brush& second);
+
+        static float GetRoundCoverage(const Brush& brush, float radius, float dx, float dy);
+        static float GetShapeCoverage(const Brush& brush, float size, float u, float v);
+
+        std::shared_ptr<const BrushMask> BuildMask(const Brush& brush, uint32_t size, uint32_t subX, uint32_t subY) const;
+        std::shared_ptr<const BrushMask> GetMask(uint64_t brushId, uint32_t size, uint32_t subX, uint32_t subY);
+
+    public:
+        BrushEngine(const BrushEngine& engine)            = delete;
+        BrushEngine& operator=(const BrushEngine& engine) = delete;
+
+        static BrushEngine& GetInstance() {
+            static BrushEngine instance;
+
+            return instance;
+        }
+
+        // Returns 0 if shape is wrong. Identical shapes share one brush, so plugin reloads don't add brushes.
+        uint64_t CreateBrush(const booba::BrushShape& shape);
+
+        float GetSpacing(uint64_t brushId);
+
+        // Straight color is premultiplied once and blended by every stamp
+        void Stamp(booba::Image* image, uint64_t brushId, const StampPos* stamps, uint32_t count, float size, uint32_t color);
+};
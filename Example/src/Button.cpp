@@ -0,0 +1,3 @@
+#include "Button.hpp"
+
+Button::~Button() {}
@@ -9,7 +9,7 @@ const int64_t YTextShift = 2;
 
 class Button : public Window {
     protected:
-        BaseHandler<CordsPair>* clickAction_;
+        InlineHandler<CordsPair> clickAction_;
 
         MyColor hoveredColor_;
         MyColor clickedColor_;
@@ -18,15 +18,16 @@ class Button : public Window {
     public:
         Button(uint32_t x, uint32_t y, uint32_t width, uint32_t height) :
         Window(x, y, width, height),
-        clickAction_(nullptr),
-        hoveredColor_(0x80808000), clickedColor_(0x9400d300),
+        clickAction_(),
+        hoveredColor_(0x808080ff), clickedColor_(0x9400d3ff),
         isHovered_(0)
         {   
-            widgetColor_ = 0;
+            widgetColor_ = 0x000000ff;
         }
+        ~Button();
 
-        Button& operator=(const Button& button) = default;
-        Button(const Button& button)            = default;
+        Button& operator=(const Button& button) = delete;
+        Button(const Button& button)            = delete;
 
         virtual void MoveHover(const CordsPair& cords) {
             if (IsClicked(cords)) {
@@ -47,12 +48,9 @@ class Button : public Window {
             MoveHover({curEvent.Oleg_.motion.x, curEvent.Oleg_.motion.y});
         }
 
-        void SetHandler(BaseHandler<CordsPair>* newHandler) {
-            if (clickAction_) {
-                delete clickAction_;
-            }
-
-            clickAction_ = newHandler;
+        template <class THandler, class... TArgs>
+        void SetHandler(TArgs&&... args) {
+            clickAction_.template Emplace<THandler>(std::forward<TArgs>(args)...);
         }
 
         virtual void FlagClicked(const CordsPair& cords) override {
@@ -66,9 +64,7 @@ class Button : public Window {
         virtual void OnClick(const Event& curEvent) override {
             Window::OnClick(curEvent);
 
-            if (clickAction_) {
-                clickAction_->Call({curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y});
-            }
+            clickAction_.Call({curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y});
         }
 
         virtual void ReDraw() override {
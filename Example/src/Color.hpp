@@ -1,28 +1,58 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <cstdint>
 #include <cmath>
 
+// Rounded x / 255 for x <= 255 * 255
+inline uint32_t Div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Colors are 0xRRGGBBAA. Images keep them premultiplied by alpha, everything given to or taken from user is straight.
 class MyColor {
     public:
         uint8_t red_;
         uint8_t green_;
         uint8_t blue_;
+        uint8_t alpha_;
 
-        MyColor(uint32_t color) : 
-        red_(uint8_t((color & 0xff000000) >> 24)), green_(uint8_t((color & 0x00ff0000) >> 16)), blue_(uint8_t((color & 0x0000ff00) >> 8))
+        MyColor(uint32_t color) :
+        red_(uint8_t((color & 0xff000000) >> 24)), green_(uint8_t((color & 0x00ff0000) >> 16)), blue_(uint8_t((color & 0x0000ff00) >> 8)),
+        alpha_(uint8_t(color & 0x000000ff))
         {
 
         }
 
-        MyColor(uint8_t red, uint8_t green, uint8_t blue) :
-        red_(red), green_(green), blue_(blue)
+        MyColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 0xff) :
+        red_(red), green_(green), blue_(blue), alpha_(alpha)
         {
 
         }
 
         operator uint32_t() const {
-            return (uint32_t(red_) << 24u) + (uint32_t(green_) << 16u) + (uint32_t(blue_) << 8u);
+            return (uint32_t(red_) << 24u) + (uint32_t(green_) << 16u) + (uint32_t(blue_) << 8u) + alpha_;
+        }
+
+        uint32_t GetPremultiplied() const {
+            return (Div255(uint32_t(red_)   * alpha_) << 24u) + (Div255(uint32_t(green_) * alpha_) << 16u) +
+                   (Div255(uint32_t(blue_)  * alpha_) << 8u)  + alpha_;
+        }
+
+        // The only place where division is needed, so pixels are unpremultiplied only when user reads them
+        static MyColor FromPremultiplied(uint32_t color) {
+            uint32_t alpha = color & 0xff;
+
+            if (!alpha) {
+                return MyColor(0, 0, 0, 0);
+            }
+
+            auto unpremultiply = [alpha](uint32_t channel) {
+                return uint8_t(std::min((channel * 255 + alpha / 2) / alpha, 255u));
+            };
+
+            return MyColor(unpremultiply(color >> 24), unpremultiply((color >> 16) & 0xff), unpremultiply((color >> 8) & 0xff), uint8_t(alpha));
         }
-};
\ No newline at end of file
+};
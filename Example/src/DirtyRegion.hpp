@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "PixelRect.hpp"
+
+// After that amount of separate rects region collapses into their bounding box
+const uint32_t MaxDirtyRects = 16;
+
+class DirtyRegion {
+    private:
+        std::vector<PixelRect> rects_;
+
+    public:
+        DirtyRegion() :
+        rects_()
+        {
+            rects_.reserve(MaxDirtyRects + 1);
+        }
+
+        bool IsEmpty() const {
+            return rects_.empty();
+        }
+
+        const std::vector<PixelRect>& GetRects() const {
+            return rects_;
+        }
+
+        void Clear() {
+            rects_.clear();
+        }
+
+        void Add(const PixelRect& rect) {
+            if (rect.IsEmpty()) {
+                return;
+            }
+
+            // Most of writes hit the same area as previous one
+            if (!rects_.empty() && rects_.back().Contains(rect)) {
+                return;
+            }
+
+            PixelRect merged = rect;
+
+            for (bool isMerged = true; isMerged; ) {
+                isMerged = false;
+
+                for (auto it = rects_.begin(); it != rects_.end(); it++) {
+                    if (it->Touches(merged)) {
+                        merged = merged.United(*it);
+                        rects_.erase(it);
+
+                        isMerged = true;
+                        break;
+                    }
+                }
+            }
+
+            rects_.push_back(merged);
+
+            if (rects_.size() > MaxDirtyRects) {
+                PixelRect bounds = rects_.front();
+
+                for (auto& curRect : rects_) {
+                    bounds = bounds.United(curRect);
+                }
+
+                rects_.clear();
+                rects_.push_back(bounds);
+            }
+        }
+};
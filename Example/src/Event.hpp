@@ -2,6 +2,12 @@
 
 #include <SFML/Graphics.hpp>
 #include <list>
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+#include "CordsPair.hpp"
 
 enum class EventType {
     NoEvent        = 0,
@@ -14,9 +20,11 @@ enum class EventType {
     CanvasMPressed  = 6,
     CanvasMReleased = 7,
     CanvasMMoved    = 8,
+    StrokeMoved     = 9,
 
     KeyPressed,
     Closed,
+    MouseWheeled,
 };
 
 enum class MouseButton
@@ -146,6 +154,12 @@ enum Key
     KeyCount,     ///< Keep last -- the total number of keyboard keys
 };
 
+struct WheelEventData
+{
+    int32_t x, y;
+    float delta;
+};
+
 struct KeyPressedEventData
 {
     Key code;
@@ -169,6 +183,12 @@ struct CanvasEventData
     int32_t x, y; 
 };
 
+struct StrokeEventData
+{
+    const CordsPair* points;
+    uint32_t count;
+};
+
 class Event {
     public:
     EventType type_;
@@ -181,11 +201,24 @@ class Event {
         ScrollMovedEventData smedata;
         CanvasEventData cedata;
         KeyPressedEventData kpedata;
+        StrokeEventData stedata;
+        WheelEventData wedata;
     } Oleg_; //Object loading event group.
 
+    // MouseMoved events of one frame are merged into one. Path has all their points, the last one is in motion.
+    const CordsPair* path_;
+    uint32_t pathSize_;
+
+    Event() :
+        type_(EventType::NoEvent),
+        Oleg_({0, 0, 0, 0}),
+        path_(nullptr), pathSize_(0)
+    {}
+
     Event(const sf::Event& sfEvent) :
         type_(EventType::NoEvent),
-        Oleg_({0, 0, 0, 0})
+        Oleg_({0, 0, 0, 0}),
+        path_(nullptr), pathSize_(0)
     {
         switch (sfEvent.type) {
             case sf::Event::Closed: {
@@ -221,6 +254,11 @@ class Event {
             case sf::Event::MouseButtonReleased: {
                 type_ = EventType::MouseReleased;
 
+                Oleg_.mbedata.button = (sfEvent.mouseButton.button == sf::Mouse::Button::Right) ? MouseButton::Right : MouseButton::Left;
+
+                Oleg_.mbedata.x = sfEvent.mouseButton.x;
+                Oleg_.mbedata.y = sfEvent.mouseButton.y;
+
                 break;
             }
 
@@ -242,6 +280,20 @@ class Event {
                 break;
             }
 
+            case sf::Event::MouseWheelScrolled: {
+                if (sfEvent.mouseWheelScroll.wheel != sf::Mouse::VerticalWheel) {
+                    break;
+                }
+
+                type_ = EventType::MouseWheeled;
+
+                Oleg_.wedata.x     = sfEvent.mouseWheelScroll.x;
+                Oleg_.wedata.y     = sfEvent.mouseWheelScroll.y;
+                Oleg_.wedata.delta = sfEvent.mouseWheelScroll.delta;
+
+                break;
+            }
+
             case sf::Event::Count:
             case sf::Event::Resized:
             case sf::Event::LostFocus:
@@ -249,7 +301,6 @@ class Event {
             case sf::Event::TextEntered:
             case sf::Event::KeyReleased:
             case sf::Event::MouseWheelMoved:
-            case sf::Event::MouseWheelScrolled:
             case sf::Event::MouseEntered:
             case sf::Event::MouseLeft:
             case sf::Event::JoystickButtonPressed:
@@ -358,4 +409,56 @@ class AddMethodCaller : public BaseHandler<TArguments> {
         TAddMethod callMethod_;
 };
 
+// Enough for every caller above, they hold up to two pointers and a method pointer
+const size_t InlineHandlerSize = 6 * sizeof(void*);
+
+// Owns one handler constructed right inside it, so widgets get their handlers without heap allocation
+template <class TArguments>
+class InlineHandler {
+    private:
+        alignas(std::max_align_t) unsigned char storage_[InlineHandlerSize];
+        BaseHandler<TArguments>* handler_;
+
+    public:
+        InlineHandler() :
+        storage_(),
+        handler_(nullptr)
+        {}
+
+        InlineHandler(const InlineHandler<TArguments>& toCpy)                        = delete;
+        InlineHandler<TArguments>& operator=(const InlineHandler<TArguments>& toCpy) = delete;
+
+        ~InlineHandler() {
+            Reset();
+        }
+
+        template <class THandler, class... TArgs>
+        void Emplace(TArgs&&... args) {
+            static_assert(std::is_base_of_v<BaseHandler<TArguments>, THandler>, "Handler must be derived from BaseHandler");
+            static_assert(sizeof(THandler)  <= InlineHandlerSize,             "Handler doesn't fit into InlineHandler");
+            static_assert(alignof(THandler) <= alignof(std::max_align_t),     "Handler is overaligned");
+
+            Reset();
+
+            handler_ = new (storage_) THandler(std::forward<TArgs>(args)...);
+        }
+
+        void Reset() {
+            if (handler_) {
+                handler_->~BaseHandler<TArguments>();
+                handler_ = nullptr;
+            }
+        }
+
+        bool IsSet() const {
+            return handler_;
+        }
+
+        void Call(const TArguments& args) {
+            if (handler_) {
+                handler_->Call(args);
+            }
+        }
+};
+
 // pimpl, компонентное программирование, Smalltalk, ECS - всё управляется сообщениями и подписками. 
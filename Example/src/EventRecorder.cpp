@@ -0,0 +1,435 @@
+#include "EventRecorder.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+static uint64_t ZigzagEncode(int64_t value) {
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+static int64_t ZigzagDecode(uint64_t value) {
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+static uint8_t PackFlags(bool flag0, bool flag1, bool flag2, bool flag3) {
+    return uint8_t(flag0 | (flag1 << 1) | (flag2 << 2) | (flag3 << 3));
+}
+
+EventRecorder::EventRecorder() :
+file_(nullptr),
+buffer_(),
+sessionStart_(),
+lastTimeUs_(0),
+lastFlushUs_(0),
+lastCords_({0, 0})
+{
+    buffer_.reserve(EventLogFlushSize);
+}
+
+EventRecorder::~EventRecorder() {
+    if (file_) {
+        Flush();
+        fclose(file_);
+    }
+}
+
+bool EventRecorder::Open(const char* path) {
+    std::error_code error;
+    uintmax_t fileSize = std::filesystem::file_size(path, error);
+
+    // Session appended right after broken record would be read as part of it, so log is cut first
+    if (!error && fileSize) {
+        EventReplayer replayer;
+
+        if (!replayer.Open(path)) {
+            return false;
+        }
+
+        size_t completeSize = replayer.GetCompleteSize();
+
+        if (completeSize < fileSize) {
+            fprintf(stderr, "Event log %s ends with broken record, it is cut to the last complete frame\n", path);
+
+            std::filesystem::resize_file(path, completeSize, error);
+
+            if (error) {
+                fprintf(stderr, "Unable to cut event log %s\n", path);
+                return false;
+            }
+        }
+    }
+
+    file_ = fopen(path, "ab");
+
+    if (!file_) {
+        fprintf(stderr, "Unable to open event log %s\n", path);
+        return false;
+    }
+
+    // In append mode position is at the end, so empty file is a new log
+    fseek(file_, 0, SEEK_END);
+
+    if (ftell(file_) == 0) {
+        buffer_.insert(buffer_.end(), EventLogMagic, EventLogMagic + sizeof(EventLogMagic) - 1);
+
+        uint8_t version[sizeof(uint32_t)] = {};
+        memcpy(version, &EventLogVersion, sizeof(version));
+        buffer_.insert(buffer_.end(), version, version + sizeof(version));
+    }
+
+    sessionStart_ = std::chrono::steady_clock::now();
+    lastTimeUs_   = 0;
+    lastFlushUs_  = 0;
+    lastCords_    = {0, 0};
+
+    // Wall clock of session start, only for people who read the log
+    WriteHeader(EventRecordTag::Session);
+    WriteVarint(uint64_t(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()));
+
+    return true;
+}
+
+int64_t EventRecorder::GetTimeUs() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sessionStart_).count();
+}
+
+void EventRecorder::WriteVarint(uint64_t value) {
+    while (value >= 0x80) {
+        buffer_.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+
+    buffer_.push_back(uint8_t(value));
+}
+
+void EventRecorder::WriteCords(const CordsPair& cords) {
+    WriteVarint(ZigzagEncode(int64_t(cords.x) - lastCords_.x));
+    WriteVarint(ZigzagEncode(int64_t(cords.y) - lastCords_.y));
+
+    lastCords_ = cords;
+}
+
+void EventRecorder::WriteHeader(EventRecordTag tag, uint8_t type) {
+    int64_t timeUs = GetTimeUs();
+
+    buffer_.push_back(uint8_t(uint8_t(tag) + type));
+    WriteVarint(uint64_t(timeUs - lastTimeUs_));
+
+    lastTimeUs_ = timeUs;
+}
+
+void EventRecorder::Record(const Event& event) {
+    if (!file_) {
+        return;
+    }
+
+    switch (event.type_) {
+        case EventType::MouseMoved: {
+            WriteHeader(EventRecordTag::Event, uint8_t(event.type_));
+            WriteCords({event.Oleg_.motion.x, event.Oleg_.motion.y});
+
+            break;
+        }
+
+        case EventType::MousePressed:
+        case EventType::MouseReleased: {
+            const MouseButtonEventData& data = event.Oleg_.mbedata;
+
+            WriteHeader(EventRecordTag::Event, uint8_t(event.type_));
+            WriteCords({data.x, data.y});
+            buffer_.push_back(PackFlags(data.button == MouseButton::Right, data.shift, data.alt, data.ctrl));
+
+            break;
+        }
+
+        case EventType::KeyPressed: {
+            const KeyPressedEventData& data = event.Oleg_.kpedata;
+
+            WriteHeader(EventRecordTag::Event, uint8_t(event.type_));
+            WriteVarint(ZigzagEncode(int64_t(data.code)));
+            buffer_.push_back(PackFlags(0, data.shift, data.alt, data.ctrl));
+
+            break;
+        }
+
+        case EventType::MouseWheeled: {
+            WriteHeader(EventRecordTag::Event, uint8_t(event.type_));
+            WriteCords({event.Oleg_.wedata.x, event.Oleg_.wedata.y});
+
+            uint8_t delta[sizeof(float)] = {};
+            memcpy(delta, &event.Oleg_.wedata.delta, sizeof(delta));
+            buffer_.insert(buffer_.end(), delta, delta + sizeof(delta));
+
+            break;
+        }
+
+        case EventType::Closed: {
+            WriteHeader(EventRecordTag::Event, uint8_t(event.type_));
+
+            break;
+        }
+
+        case EventType::NoEvent:
+        case EventType::ButtonClicked:
+        case EventType::ScrollbarMoved:
+        case EventType::CanvasMPressed:
+        case EventType::CanvasMReleased:
+        case EventType::CanvasMMoved:
+        case EventType::StrokeMoved:
+        default:
+            break;
+    }
+}
+
+void EventRecorder::RecordFrame() {
+    if (!file_) {
+        return;
+    }
+
+    WriteHeader(EventRecordTag::Frame);
+
+    if ((buffer_.size() >= EventLogFlushSize) || (lastTimeUs_ - lastFlushUs_ >= EventLogFlushPeriodUs)) {
+        Flush();
+    }
+}
+
+void EventRecorder::Flush() {
+    if (!file_ || buffer_.empty()) {
+        return;
+    }
+
+    if (fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+        fprintf(stderr, "Unable to write event log\n");
+    }
+
+    fflush(file_);
+
+    buffer_.clear();
+    lastFlushUs_ = lastTimeUs_;
+}
+
+EventReplayer::EventReplayer() :
+data_(),
+position_(0),
+timeUs_(0),
+lastCords_({0, 0})
+{}
+
+bool EventReplayer::Open(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file) {
+        fprintf(stderr, "Unable to open event log %s\n", path);
+        return false;
+    }
+
+    data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    uint32_t version = 0;
+
+    if ((data_.size() < EventLogHeaderSize) || memcmp(data_.data(), EventLogMagic, sizeof(EventLogMagic) - 1)) {
+        fprintf(stderr, "%s is not an event log\n", path);
+
+        data_.clear();
+        return false;
+    }
+
+    memcpy(&version, data_.data() + sizeof(EventLogMagic) - 1, sizeof(version));
+
+    if (version != EventLogVersion) {
+        fprintf(stderr, "Event log %s has version %u, only %u is supported\n", path, version, EventLogVersion);
+
+        data_.clear();
+        return false;
+    }
+
+    Rewind();
+    return true;
+}
+
+void EventReplayer::Rewind() {
+    position_      = std::min(EventLogHeaderSize, data_.size());
+    timeUs_        = 0;
+    lastCords_     = {0, 0};
+}
+
+bool EventReplayer::ReadVarint(uint64_t& value) {
+    value = 0;
+
+    for (uint32_t shift = 0; (shift < 64) && (position_ < data_.size()); shift += 7) {
+        uint8_t curByte = data_[position_++];
+        value |= uint64_t(curByte & 0x7f) << shift;
+
+        if (!(curByte & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool EventReplayer::ReadCords(CordsPair& cords) {
+    uint64_t dx = 0;
+    uint64_t dy = 0;
+
+    if (!ReadVarint(dx) || !ReadVarint(dy)) {
+        return false;
+    }
+
+    lastCords_ = {int32_t(lastCords_.x + ZigzagDecode(dx)), int32_t(lastCords_.y + ZigzagDecode(dy))};
+    cords = lastCords_;
+
+    return true;
+}
+
+bool EventReplayer::ReadEvent(EventType type, Event& event) {
+    event = Event();
+    event.type_ = type;
+
+    CordsPair cords = {0, 0};
+
+    switch (type) {
+        case EventType::MouseMoved: {
+            if (!ReadCords(cords)) {
+                return false;
+            }
+
+            event.Oleg_.motion = {cords.x, cords.y, 0, 0};
+            return true;
+        }
+
+        case EventType::MousePressed:
+        case EventType::MouseReleased: {
+            if (!ReadCords(cords) || (position_ >= data_.size())) {
+                return false;
+            }
+
+            uint8_t flags = data_[position_++];
+            event.Oleg_.mbedata = {cords.x, cords.y, (flags & 1) ? MouseButton::Right : MouseButton::Left,
+                                   bool(flags & 2), bool(flags & 4), bool(flags & 8)};
+            return true;
+        }
+
+        case EventType::KeyPressed: {
+            uint64_t code = 0;
+
+            if (!ReadVarint(code) || (position_ >= data_.size())) {
+                return false;
+            }
+
+            uint8_t flags = data_[position_++];
+            event.Oleg_.kpedata = {Key(ZigzagDecode(code)), bool(flags & 2), bool(flags & 4), bool(flags & 8)};
+            return true;
+        }
+
+        case EventType::MouseWheeled: {
+            if (!ReadCords(cords) || (position_ + sizeof(float) > data_.size())) {
+                return false;
+            }
+
+            event.Oleg_.wedata.x = cords.x;
+            event.Oleg_.wedata.y = cords.y;
+
+            memcpy(&event.Oleg_.wedata.delta, data_.data() + position_, sizeof(float));
+            position_ += sizeof(float);
+
+            return true;
+        }
+
+        case EventType::Closed:
+            return true;
+
+        case EventType::NoEvent:
+        case EventType::ButtonClicked:
+        case EventType::ScrollbarMoved:
+        case EventType::CanvasMPressed:
+        case EventType::CanvasMReleased:
+        case EventType::CanvasMMoved:
+        case EventType::StrokeMoved:
+        default:
+            return false;
+    }
+}
+
+bool EventReplayer::ReadFrame(std::vector<RecordedEvent>& events, int64_t& frameTimeUs, bool& isBroken) {
+    events.clear();
+    isBroken = 0;
+
+    while (position_ < data_.size()) {
+        uint8_t tag = data_[position_++];
+        uint64_t deltaUs = 0;
+
+        if (!ReadVarint(deltaUs)) {
+            isBroken = 1;
+            return false;
+        }
+
+        if (tag == uint8_t(EventRecordTag::Session)) {
+            uint64_t wallTime = 0;
+
+            if (!ReadVarint(wallTime)) {
+                isBroken = 1;
+                return false;
+            }
+
+            lastCords_ = {0, 0};
+            continue;
+        }
+
+        timeUs_ += int64_t(deltaUs);
+
+        if (tag == uint8_t(EventRecordTag::Frame)) {
+            frameTimeUs = timeUs_;
+            return true;
+        }
+
+        RecordedEvent recorded = {};
+
+        if ((tag < uint8_t(EventRecordTag::Event)) || !ReadEvent(EventType(tag - uint8_t(EventRecordTag::Event)), recorded.event)) {
+            isBroken = 1;
+            return false;
+        }
+
+        recorded.timeUs = timeUs_;
+        events.push_back(recorded);
+    }
+
+    return false;
+}
+
+bool EventReplayer::NextFrame(std::vector<RecordedEvent>& events, int64_t& frameTimeUs) {
+    bool isBroken = 0;
+
+    if (ReadFrame(events, frameTimeUs, isBroken)) {
+        return true;
+    }
+
+    if (isBroken) {
+        fprintf(stderr, "Broken record in event log, replay stops\n");
+    }
+
+    // Events after the last frame record were cut by crash, they still make the last frame
+    position_   = data_.size();
+    frameTimeUs = timeUs_;
+
+    return !events.empty();
+}
+
+size_t EventReplayer::GetCompleteSize() {
+    Rewind();
+
+    std::vector<RecordedEvent> events;
+    int64_t frameTimeUs = 0;
+    bool isBroken = 0;
+
+    size_t completeSize = position_;
+
+    while (ReadFrame(events, frameTimeUs, isBroken)) {
+        completeSize = position_;
+    }
+
+    Rewind();
+    return completeSize;
+}
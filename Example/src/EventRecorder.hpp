@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Event.hpp"
+
+// Log is "ABOBAEVT", version and records. Recorder only appends, every run starts a new session.
+// Record is a tag byte, time since previous record in microseconds and payload, numbers are varints,
+// cords are zigzag deltas from previous cords. Log cut by crash is cut further to its last complete frame
+// before the next session is appended, replay ignores such tail if it is never appended to.
+const char     EventLogMagic[]     = "ABOBAEVT";
+const uint32_t EventLogVersion     = 1;
+const size_t   EventLogHeaderSize  = sizeof(EventLogMagic) - 1 + sizeof(uint32_t);
+
+// Records are buffered, so recording costs a few bytes of memory per event
+const size_t  EventLogFlushSize     = 64 * 1024;
+const int64_t EventLogFlushPeriodUs = 1000000;
+
+enum class EventRecordTag : uint8_t {
+    Session = 0,
+    Frame   = 1,
+    // Plus EventType
+    Event   = 0x80,
+};
+
+class EventRecorder {
+    private:
+        FILE* file_;
+        std::vector<uint8_t> buffer_;
+
+        std::chrono::steady_clock::time_point sessionStart_;
+        int64_t lastTimeUs_;
+        int64_t lastFlushUs_;
+
+        CordsPair lastCords_;
+
+        int64_t GetTimeUs() const;
+
+        void WriteVarint(uint64_t value);
+        void WriteCords(const CordsPair& cords);
+        void WriteHeader(EventRecordTag tag, uint8_t type = 0);
+
+    public:
+        EventRecorder();
+        ~EventRecorder();
+
+        EventRecorder(const EventRecorder& recorder)            = delete;
+        EventRecorder& operator=(const EventRecorder& recorder) = delete;
+
+        // Creates log or appends new session to existing one
+        bool Open(const char* path);
+
+        bool IsOpen() const {
+            return file_;
+        }
+
+        void Record(const Event& event);
+
+        // Events recorded since previous frame are replayed in one frame
+        void RecordFrame();
+
+        void Flush();
+};
+
+struct RecordedEvent {
+    Event event;
+    // Since start of replay, sessions follow each other
+    int64_t timeUs;
+};
+
+class EventReplayer {
+    private:
+        std::vector<uint8_t> data_;
+        size_t position_;
+
+        // Sessions follow each other, time of new session continues from the end of previous one
+        int64_t timeUs_;
+
+        CordsPair lastCords_;
+
+        bool ReadVarint(uint64_t& value);
+        bool ReadCords(CordsPair& cords);
+        bool ReadEvent(EventType type, Event& event);
+
+        // Returns true on frame record, false on the end of log or broken record
+        bool ReadFrame(std::vector<RecordedEvent>& events, int64_t& frameTimeUs, bool& isBroken);
+
+    public:
+        EventReplayer();
+
+        EventReplayer(const EventReplayer& replayer)            = delete;
+        EventReplayer& operator=(const EventReplayer& replayer) = delete;
+
+        bool Open(const char* path);
+
+        // Events of next recorded frame and time of its end. Returns false when log is over.
+        bool NextFrame(std::vector<RecordedEvent>& events, int64_t& frameTimeUs);
+
+        bool IsDone() const {
+            return position_ >= data_.size();
+        }
+
+        void Rewind();
+
+        // Size of log up to the end of its last complete frame
+        size_t GetCompleteSize();
+};
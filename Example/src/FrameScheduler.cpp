@@ -0,0 +1,66 @@
+#include "FrameScheduler.hpp"
+
+#include <thread>
+
+FrameScheduler::FrameScheduler(uint32_t targetFps, bool isVsync) :
+frameBudget_(),
+frameStart_(Clock::now()),
+nextFrame_(Clock::now()),
+isVsync_(isVsync),
+frameTimes_(),
+framesTotal_(0)
+{
+    SetTargetFps(targetFps);
+}
+
+void FrameScheduler::SetTargetFps(uint32_t targetFps) {
+    frameBudget_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / std::max(targetFps, 1u)));
+}
+
+void FrameScheduler::BeginFrame() {
+    frameStart_ = Clock::now();
+
+    // After idle waiting or a slow frame next deadline is in the past, it shouldn't make frames hurry
+    if (nextFrame_ < frameStart_) {
+        nextFrame_ = frameStart_;
+    }
+}
+
+void FrameScheduler::EndFrame() {
+    Clock::time_point frameEnd = Clock::now();
+
+    frameTimes_[framesTotal_ % FrameStatsWindow] = std::chrono::duration<double, std::milli>(frameEnd - frameStart_).count();
+    framesTotal_++;
+
+    nextFrame_ += frameBudget_;
+
+    if (!isVsync_ && (nextFrame_ > frameEnd)) {
+        std::this_thread::sleep_until(nextFrame_);
+    }
+}
+
+FrameStats FrameScheduler::GetStats() const {
+    FrameStats stats = {0, 0, 0, 0, framesTotal_};
+
+    uint32_t framesAmount = uint32_t(std::min(framesTotal_, uint64_t(FrameStatsWindow)));
+
+    if (framesAmount == 0) {
+        return stats;
+    }
+
+    double budgetMs = GetBudgetMs();
+
+    for (uint32_t curFrame = 0; curFrame < framesAmount; curFrame++) {
+        stats.avgMs += frameTimes_[curFrame];
+        stats.maxMs  = std::max(stats.maxMs, frameTimes_[curFrame]);
+
+        if (frameTimes_[curFrame] > budgetMs) {
+            stats.overBudget++;
+        }
+    }
+
+    stats.avgMs /= framesAmount;
+    stats.lastMs = frameTimes_[(framesTotal_ - 1) % FrameStatsWindow];
+
+    return stats;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include "Window.hpp"
+
+const uint32_t DefaultTargetFps = uint32_t(1000 / TimeBetweenTicks);
+const uint32_t FrameStatsWindow = 120;
+
+struct FrameStats {
+    double lastMs;
+    double avgMs;
+    double maxMs;
+
+    // Of frames in window, how many didn't fit into frame budget
+    uint32_t overBudget;
+    uint64_t framesTotal;
+};
+
+// Keeps main loop at target fps. Frame time is measured from BeginFrame to EndFrame, waiting is not included.
+class FrameScheduler {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Clock::duration   frameBudget_;
+        Clock::time_point frameStart_;
+        Clock::time_point nextFrame_;
+
+        bool isVsync_;
+
+        std::array<double, FrameStatsWindow> frameTimes_;
+        uint64_t framesTotal_;
+
+    public:
+        FrameScheduler(uint32_t targetFps = DefaultTargetFps, bool isVsync = false);
+
+        void SetTargetFps(uint32_t targetFps);
+
+        // With vsync display() waits for screen itself, so scheduler doesn't sleep
+        void SetVsync(bool isVsync) {
+            isVsync_ = isVsync;
+        }
+
+        bool IsVsync() const {
+            return isVsync_;
+        }
+
+        double GetBudgetMs() const {
+            return std::chrono::duration<double, std::milli>(frameBudget_).count();
+        }
+
+        void BeginFrame();
+        void EndFrame();
+
+        FrameStats GetStats() const;
+};
@@ -0,0 +1,283 @@
+#include "History.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+History::History(LayerStack* layers, size_t budget) :
+layers_(layers),
+document_(nullptr), originX_(0), originY_(0), rowBuffer_(),
+undo_(), redo_(),
+current_({{}, 0, 0}),
+spareTiles_(),
+touchedTiles_(),
+tilesInRow_(0),
+isRecording_(0),
+budget_(budget),
+usedBytes_(0)
+{
+    spareTiles_.reserve(MaxSpareHistoryTiles);
+}
+
+History::~History() {}
+
+// Dropped entry gives its buffers to snapshots of next strokes
+void History::Recycle(Entry& entry) {
+    for (auto& curTile : entry.tiles) {
+        if (spareTiles_.size() >= MaxSpareHistoryTiles) {
+            break;
+        }
+
+        spareTiles_.push_back(std::move(curTile.pixels));
+    }
+
+    entry.tiles.clear();
+}
+
+void History::BeginStroke() {
+    if (isRecording_) {
+        EndStroke();
+    }
+
+    tilesInRow_ = (layers_->GetWidth() + HistoryTileSize - 1) / HistoryTileSize;
+    uint32_t tilesInColumn = (layers_->GetHeight() + HistoryTileSize - 1) / HistoryTileSize;
+
+    touchedTiles_.assign(size_t(tilesInRow_) * tilesInColumn, 0);
+
+    current_.tiles.clear();
+    current_.bytes    = 0;
+    current_.layerIdx = layers_->GetActiveIdx();
+
+    isRecording_ = 1;
+}
+
+void History::EndStroke() {
+    if (!isRecording_) {
+        return;
+    }
+
+    isRecording_ = 0;
+
+    if (current_.tiles.empty()) {
+        return;
+    }
+
+    for (auto& curEntry : redo_) {
+        usedBytes_ -= curEntry.bytes;
+        Recycle(curEntry);
+    }
+    redo_.clear();
+
+    usedBytes_ += current_.bytes;
+
+    // Entry gets exact copy of tiles list, current_ keeps its capacity for the next strokes
+    undo_.push_back({{std::make_move_iterator(current_.tiles.begin()), std::make_move_iterator(current_.tiles.end())},
+                     current_.bytes, current_.layerIdx});
+
+    current_.tiles.clear();
+    current_.bytes = 0;
+
+    FitBudget();
+}
+
+void History::Touch(const PixelRect& rect) {
+    if (!isRecording_ || rect.IsEmpty()) {
+        return;
+    }
+
+    const Image& image = layers_->GetLayer(current_.layerIdx);
+
+    PixelRect clipped = rect.Intersected({0, 0, image.width_, image.height_});
+
+    if (clipped.IsEmpty()) {
+        return;
+    }
+
+    const uint32_t* pixels = image.GetPixels();
+    const uint32_t  stride = image.GetStride();
+
+    for (uint32_t tileY = clipped.y / HistoryTileSize; tileY <= (clipped.Bottom() - 1) / HistoryTileSize; tileY++) {
+        for (uint32_t tileX = clipped.x / HistoryTileSize; tileX <= (clipped.Right() - 1) / HistoryTileSize; tileX++) {
+            size_t tileIdx = size_t(tileY) * tilesInRow_ + tileX;
+
+            if (touchedTiles_[tileIdx]) {
+                continue;
+            }
+
+            touchedTiles_[tileIdx] = 1;
+
+            PixelRect tileRect = PixelRect({tileX * HistoryTileSize, tileY * HistoryTileSize, HistoryTileSize, HistoryTileSize})
+                                 .Intersected({0, 0, image.width_, image.height_});
+
+            TileSnapshot snapshot = {{tileRect.x + originX_, tileRect.y + originY_, tileRect.width, tileRect.height}, {}};
+
+            if (!spareTiles_.empty()) {
+                snapshot.pixels = std::move(spareTiles_.back());
+                spareTiles_.pop_back();
+            }
+
+            snapshot.pixels.resize(size_t(tileRect.width) * tileRect.height);
+
+            for (uint32_t curY = 0; curY < tileRect.height; curY++) {
+                std::copy_n(pixels + (size_t(tileRect.y) + curY) * stride + tileRect.x, tileRect.width,
+                            snapshot.pixels.data() + size_t(curY) * tileRect.width);
+            }
+
+            current_.bytes += snapshot.pixels.size() * sizeof(uint32_t);
+            current_.tiles.push_back(std::move(snapshot));
+        }
+    }
+}
+
+void History::SwapWithDocument(uint32_t x, uint32_t y, uint32_t width, uint32_t* saved) {
+    if (!document_ || !width) {
+        return;
+    }
+
+    rowBuffer_.resize(width);
+
+    document_->ReadRect({x, y, width, 1}, rowBuffer_.data(), width);
+    document_->WriteRect({x, y, width, 1}, saved, width);
+
+    std::copy_n(rowBuffer_.data(), width, saved);
+}
+
+// Viewport moves only while there is one layer, so parts outside of window belong to background
+void History::SwapTiles(Entry& entry) {
+    Image& image = layers_->GetLayer(entry.layerIdx);
+
+    uint32_t* pixels = image.GetPixels();
+    const uint32_t stride = image.GetStride();
+
+    PixelRect window = {originX_, originY_, image.width_, image.height_};
+
+    for (auto& curTile : entry.tiles) {
+        const PixelRect& rect = curTile.rect;
+        PixelRect inside = rect.Intersected(window);
+
+        for (uint32_t curY = 0; curY < rect.height; curY++) {
+            uint32_t* savedRow = curTile.pixels.data() + size_t(curY) * rect.width;
+            uint32_t  docY     = rect.y + curY;
+
+            if (inside.IsEmpty() || (docY < inside.y) || (docY >= inside.Bottom())) {
+                SwapWithDocument(rect.x, docY, rect.width, savedRow);
+                continue;
+            }
+
+            uint32_t* imageRow = pixels + size_t(docY - originY_) * stride + (inside.x - originX_);
+
+            SwapWithDocument(rect.x, docY, inside.x - rect.x, savedRow);
+            std::swap_ranges(imageRow, imageRow + inside.width, savedRow + (inside.x - rect.x));
+            SwapWithDocument(inside.Right(), docY, rect.Right() - inside.Right(), savedRow + (inside.Right() - rect.x));
+        }
+
+        if (!inside.IsEmpty()) {
+            image.MarkDirty({inside.x - originX_, inside.y - originY_, inside.width, inside.height});
+        }
+    }
+}
+
+bool History::Undo() {
+    EndStroke();
+
+    if (undo_.empty()) {
+        return false;
+    }
+
+    SwapTiles(undo_.back());
+
+    redo_.push_back(std::move(undo_.back()));
+    undo_.pop_back();
+
+    return true;
+}
+
+bool History::Redo() {
+    EndStroke();
+
+    if (redo_.empty()) {
+        return false;
+    }
+
+    SwapTiles(redo_.back());
+
+    undo_.push_back(std::move(redo_.back()));
+    redo_.pop_back();
+
+    return true;
+}
+
+void History::Reset() {
+    isRecording_ = 0;
+
+    for (auto& curEntry : undo_) {
+        Recycle(curEntry);
+    }
+
+    for (auto& curEntry : redo_) {
+        Recycle(curEntry);
+    }
+
+    undo_.clear();
+    redo_.clear();
+    current_ = {{}, 0, 0};
+
+    usedBytes_ = 0;
+}
+
+// Oldest entries are dropped first. The newest one is kept even if it alone is bigger than budget.
+void History::FitBudget() {
+    while ((usedBytes_ > budget_) && !redo_.empty()) {
+        usedBytes_ -= redo_.front().bytes;
+        Recycle(redo_.front());
+        redo_.erase(redo_.begin());
+    }
+
+    while ((usedBytes_ > budget_) && (undo_.size() > 1)) {
+        usedBytes_ -= undo_.front().bytes;
+        Recycle(undo_.front());
+        undo_.pop_front();
+    }
+}
+
+template <class TEntries>
+void History::RemoveLayerEntries(TEntries& entries, uint32_t layerIdx) {
+    for (auto& curEntry : entries) {
+        if (curEntry.layerIdx == layerIdx) {
+            usedBytes_ -= curEntry.bytes;
+            Recycle(curEntry);
+        }
+    }
+
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [layerIdx](const Entry& entry) {
+        return entry.layerIdx == layerIdx;
+    }), entries.end());
+
+    for (auto& curEntry : entries) {
+        if (curEntry.layerIdx > layerIdx) {
+            curEntry.layerIdx--;
+        }
+    }
+}
+
+void History::OnLayerAdded(uint32_t layerIdx) {
+    EndStroke();
+
+    for (auto& curEntry : undo_) {
+        if (curEntry.layerIdx >= layerIdx) {
+            curEntry.layerIdx++;
+        }
+    }
+
+    for (auto& curEntry : redo_) {
+        if (curEntry.layerIdx >= layerIdx) {
+            curEntry.layerIdx++;
+        }
+    }
+}
+
+void History::OnLayerRemoved(uint32_t layerIdx) {
+    EndStroke();
+
+    RemoveLayerEntries(undo_, layerIdx);
+    RemoveLayerEntries(redo_, layerIdx);
+}
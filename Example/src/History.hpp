@@ -0,0 +1,118 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "Primitives.hpp"
+#include "LayerStack.hpp"
+#include "TiledDocument.hpp"
+
+const uint32_t HistoryTileSize      = 64;
+const size_t   DefaultHistoryBudget = size_t(256) << 20;
+// Pixel buffers of dropped tiles kept for new snapshots, 4 MiB of full tiles
+const size_t   MaxSpareHistoryTiles = 256;
+
+// Undo/redo of layer changes. Layer is split into tiles, first write to tile during stroke saves it.
+// Undo and redo swap saved tiles with layer ones, so every tile is stored only once.
+// Every entry keeps index of layer it was recorded on, so history stays when another layer is chosen.
+// Layers may be a window of document at origin, then tiles are kept in document coordinates
+// and parts of them outside of window are swapped with document itself.
+class History {
+    private:
+        struct TileSnapshot {
+            PixelRect rect;
+            std::vector<uint32_t> pixels;
+        };
+
+        struct Entry {
+            std::vector<TileSnapshot> tiles;
+            size_t bytes;
+            uint32_t layerIdx;
+        };
+
+        LayerStack* layers_;
+
+        TiledDocument* document_;
+        uint32_t originX_;
+        uint32_t originY_;
+        // Row of document pixels while it is swapped
+        std::vector<uint32_t> rowBuffer_;
+
+        std::deque<Entry>  undo_;
+        std::vector<Entry> redo_;
+
+        Entry current_;
+        std::vector<std::vector<uint32_t>> spareTiles_;
+        std::vector<bool> touchedTiles_;
+        uint32_t tilesInRow_;
+
+        bool isRecording_;
+
+        size_t budget_;
+        size_t usedBytes_;
+
+        void SwapWithDocument(uint32_t x, uint32_t y, uint32_t width, uint32_t* saved);
+        void SwapTiles(Entry& entry);
+        void Recycle(Entry& entry);
+        void FitBudget();
+
+        template <class TEntries>
+        void RemoveLayerEntries(TEntries& entries, uint32_t layerIdx);
+
+    public:
+        History(LayerStack* layers, size_t budget = DefaultHistoryBudget);
+        ~History();
+
+        History(const History& history)            = delete;
+        History& operator=(const History& history) = delete;
+
+        // Stroke is recorded on active layer
+        void BeginStroke();
+        void EndStroke();
+
+        // Called by active layer before pixels in rect are changed
+        void Touch(const PixelRect& rect);
+
+        bool Undo();
+        bool Redo();
+
+        // Forgets everything, should be called when layers are recreated or flattened
+        void Reset();
+
+        // Layer is inserted at layerIdx, entries of layers from it upwards are shifted
+        void OnLayerAdded(uint32_t layerIdx);
+
+        // Entries of removed layer are dropped, entries of layers above it are shifted
+        void OnLayerRemoved(uint32_t layerIdx);
+
+        // History of another document starts from scratch
+        void SetDocument(TiledDocument* document) {
+            document_ = document;
+            originX_  = 0;
+            originY_  = 0;
+
+            Reset();
+        }
+
+        // Image shows another part of document now, saved tiles stay where they were in document
+        void SetOrigin(uint32_t originX, uint32_t originY) {
+            EndStroke();
+
+            originX_ = originX;
+            originY_ = originY;
+        }
+
+        void SetBudget(size_t budget) {
+            budget_ = budget;
+
+            FitBudget();
+        }
+
+        size_t GetUsedBytes() const {
+            return usedBytes_;
+        }
+
+        bool IsRecording() const {
+            return isRecording_;
+        }
+};
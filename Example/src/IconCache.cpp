@@ -0,0 +1,223 @@
+#include "IconCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+const uint64_t FnvPrime       = 1099511628211ull;
+
+static uint64_t HashBytes(const std::vector<char>& bytes) {
+    uint64_t hash = FnvOffsetBasis;
+
+    for (char curByte : bytes) {
+        hash ^= uint8_t(curByte);
+        hash *= FnvPrime;
+    }
+
+    return hash;
+}
+
+IconCache::IconCache() :
+icons_(),
+slots_(),
+byPath_(),
+byHash_(),
+decodedMutex_(),
+decoded_(),
+pendingAmount_(0),
+atlasImage_(),
+atlas_(nullptr),
+shelves_(),
+usedHeight_(0)
+{
+    atlasImage_.create(IconAtlasWidth, IconAtlasStartHeight, sf::Color(0, 0, 0, 0));
+}
+
+IconHandle IconCache::Request(const char* path) {
+    if (!path) {
+        return InvalidIcon;
+    }
+
+    std::error_code error;
+
+    int64_t  mtime = int64_t(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+    uint64_t size  = uint64_t(std::filesystem::file_size(path, error));
+
+    auto found = byPath_.find(path);
+
+    if ((found != byPath_.end()) && (icons_[found->second].mtime == mtime) && (icons_[found->second].size == size)) {
+        return found->second;
+    }
+
+    IconHandle newHandle = IconHandle(icons_.size());
+
+    icons_.push_back({path, mtime, size, IconState::Pending, 0});
+    byPath_[path] = newHandle;
+
+    pendingAmount_++;
+
+    std::string pathCopy = path;
+    JobSystem::GetInstance().Submit([this, newHandle, pathCopy]() { Decode(newHandle, pathCopy); });
+
+    return newHandle;
+}
+
+// Runs on worker thread, touches nothing but decoded_
+void IconCache::Decode(IconHandle handle, const std::string& path) {
+    DecodedIcon result = {handle, 0, 0, {}};
+
+    std::ifstream file(path, std::ios::binary);
+
+    if (file) {
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        result.hash     = HashBytes(bytes);
+        result.isLoaded = !bytes.empty() && result.image.loadFromMemory(bytes.data(), bytes.size());
+    }
+
+    std::lock_guard<std::mutex> lock(decodedMutex_);
+    decoded_.push_back(std::move(result));
+}
+
+bool IconCache::Update() {
+    if (pendingAmount_ == 0) {
+        return false;
+    }
+
+    std::vector<DecodedIcon> decoded;
+
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex_);
+        decoded.swap(decoded_);
+    }
+
+    for (auto& curIcon : decoded) {
+        Icon& icon = icons_[curIcon.handle];
+        pendingAmount_--;
+
+        if (!curIcon.isLoaded) {
+            fprintf(stderr, "Unable to load icon: %s\n", icon.path.c_str());
+
+            icon.state = IconState::Failed;
+            continue;
+        }
+
+        auto found = byHash_.find(curIcon.hash);
+
+        if (found != byHash_.end()) {
+            icon.slot  = found->second;
+            icon.state = IconState::Ready;
+
+            continue;
+        }
+
+        sf::Vector2u size = curIcon.image.getSize();
+        sf::IntRect rect;
+
+        if (!Pack(size.x, size.y, rect)) {
+            fprintf(stderr, "Icon %s doesn't fit into atlas\n", icon.path.c_str());
+
+            icon.state = IconState::Failed;
+            continue;
+        }
+
+        ScopedTimer timer(ProfilePhase::Upload);
+
+        atlasImage_.copy(curIcon.image, uint32_t(rect.left), uint32_t(rect.top));
+
+        if (atlas_) {
+            atlas_->update(curIcon.image, uint32_t(rect.left), uint32_t(rect.top));
+        }
+
+        byHash_[curIcon.hash] = uint32_t(slots_.size());
+        slots_.push_back({curIcon.hash, rect});
+
+        icon.slot  = uint32_t(slots_.size() - 1);
+        icon.state = IconState::Ready;
+    }
+
+    return !decoded.empty();
+}
+
+bool IconCache::IsReady(IconHandle handle) {
+    if (handle >= icons_.size()) {
+        return true;
+    }
+
+    Update();
+
+    return icons_[handle].state != IconState::Pending;
+}
+
+const sf::Texture& IconCache::GetTexture() {
+    if (!atlas_) {
+        atlas_ = std::make_unique<sf::Texture>();
+        atlas_->loadFromImage(atlasImage_);
+    }
+
+    return *atlas_;
+}
+
+bool IconCache::GetRect(IconHandle handle, sf::IntRect& rect) const {
+    if ((handle >= icons_.size()) || (icons_[handle].state != IconState::Ready)) {
+        return false;
+    }
+
+    rect = slots_[icons_[handle].slot].rect;
+
+    return true;
+}
+
+// Shelf packing, atlas grows down when shelves are over
+bool IconCache::Pack(uint32_t width, uint32_t height, sf::IntRect& rect) {
+    if ((width == 0) || (height == 0) || (width > IconAtlasWidth)) {
+        return false;
+    }
+
+    for (auto& curShelf : shelves_) {
+        if ((curShelf.height >= height) && (curShelf.height <= height * 2) && (curShelf.usedWidth + width <= IconAtlasWidth)) {
+            rect = {int32_t(curShelf.usedWidth), int32_t(curShelf.y), int32_t(width), int32_t(height)};
+            curShelf.usedWidth += width;
+
+            return true;
+        }
+    }
+
+    if ((usedHeight_ + height > atlasImage_.getSize().y) && !Grow(usedHeight_ + height)) {
+        return false;
+    }
+
+    shelves_.push_back({usedHeight_, height, width});
+    rect = {0, int32_t(usedHeight_), int32_t(width), int32_t(height)};
+
+    usedHeight_ += height;
+
+    return true;
+}
+
+bool IconCache::Grow(uint32_t minHeight) {
+    uint32_t newHeight = std::max(atlasImage_.getSize().y, IconAtlasStartHeight);
+
+    while (newHeight < minHeight) {
+        newHeight *= 2;
+    }
+
+    // Maximum size is known only with graphics context, texture which isn't created yet is checked when it is
+    if (atlas_ && (newHeight > sf::Texture::getMaximumSize())) {
+        return false;
+    }
+
+    sf::Image newImage;
+    newImage.create(IconAtlasWidth, newHeight, sf::Color(0, 0, 0, 0));
+    newImage.copy(atlasImage_, 0, 0);
+
+    atlasImage_ = newImage;
+
+    return !atlas_ || atlas_->loadFromImage(atlasImage_);
+}
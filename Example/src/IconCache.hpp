@@ -0,0 +1,107 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t IconHandle;
+
+const IconHandle InvalidIcon = UINT32_MAX;
+
+const uint32_t IconAtlasWidth       = 1024;
+const uint32_t IconAtlasStartHeight = 256;
+
+// Icons of tools in one atlas texture. Files are read and decoded on JobSystem, icons with equal content
+// share one place in atlas. Atlas is filled on main thread in Update(), handles are valid at once.
+// Changed icon file gets a new handle, old one keeps showing old icon.
+// Texture of atlas is created on the first draw, so cache works without graphics context.
+class IconCache {
+    private:
+        enum class IconState {
+            Pending,
+            Ready,
+            Failed,
+        };
+
+        // File is identified by path, mtime and size, so icon changed by plugin reload is read again
+        struct Icon {
+            std::string path;
+            int64_t  mtime;
+            uint64_t size;
+
+            IconState state;
+            uint32_t slot;
+        };
+
+        struct Slot {
+            uint64_t hash;
+            sf::IntRect rect;
+        };
+
+        struct DecodedIcon {
+            IconHandle handle;
+            uint64_t hash;
+            bool isLoaded;
+            sf::Image image;
+        };
+
+        struct Shelf {
+            uint32_t y;
+            uint32_t height;
+            uint32_t usedWidth;
+        };
+
+        std::vector<Icon> icons_;
+        std::vector<Slot> slots_;
+
+        std::unordered_map<std::string, IconHandle> byPath_;
+        std::unordered_map<uint64_t, uint32_t>      byHash_;
+
+        std::mutex decodedMutex_;
+        std::vector<DecodedIcon> decoded_;
+        std::atomic<uint32_t> pendingAmount_;
+
+        sf::Image atlasImage_;
+        std::unique_ptr<sf::Texture> atlas_;
+
+        std::vector<Shelf> shelves_;
+        uint32_t usedHeight_;
+
+        IconCache();
+
+        void Decode(IconHandle handle, const std::string& path);
+
+        bool Pack(uint32_t width, uint32_t height, sf::IntRect& rect);
+        bool Grow(uint32_t minHeight);
+
+    public:
+        IconCache(const IconCache& cache)            = delete;
+        IconCache& operator=(const IconCache& cache) = delete;
+
+        static IconCache& GetInstance() {
+            static IconCache instance;
+
+            return instance;
+        }
+
+        IconHandle Request(const char* path);
+
+        // Puts decoded icons to atlas, returns whether any icon became ready
+        bool Update();
+
+        // Failed icon is ready too, it just has no rect
+        bool IsReady(IconHandle handle);
+
+        bool GetRect(IconHandle handle, sf::IntRect& rect) const;
+
+        const sf::Texture& GetTexture();
+
+        uint64_t GetSlotsAmount() const {
+            return slots_.size();
+        }
+};
@@ -1,2 +1,3 @@
 #include "Image.hpp"
 
+ImageWindow::~ImageWindow() {}
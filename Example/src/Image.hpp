@@ -5,6 +5,7 @@
 #include <iostream>
 #include <stack>
 #include <filesystem>
+#include <cmath>
 
 #include <dlfcn.h>
 
@@ -12,23 +13,133 @@
 
 #include "Window.hpp"
 #include "Button.hpp"
+#include "TileCache.hpp"
+#include "LayerStack.hpp"
 
 const char DefaultToolsPath[] = "./Plugins/";
 
+const double MinViewZoom  = 1.0 / 16;
+const double MaxViewZoom  = 32;
+// Zoom is multiplied by it for every notch of mouse wheel
+const double ViewZoomStep = 1.25;
+
 class ImageWindow : public Window {
+    private:
+        // Image point shown at window origin, one image pixel takes zoom_ pixels of window
+        double viewX_;
+        double viewY_;
+        double zoom_;
+
+        TileCache tileCache_;
+
+        // Layers are part of document starting at its point (originX_, originY_), if it is shown
+        const TiledDocument* document_;
+        uint32_t originX_;
+        uint32_t originY_;
+
+        // Image which is smaller than window is centered, bigger one can't leave window.
+        // Mip levels show document around layers, so zoomed out view is kept in document instead.
+        void ClampView() {
+            if (document_ && TileCache::ChooseLevel(zoom_)) {
+                viewX_ = ClampViewAxis(viewX_ + originX_, double(document_->GetWidth()),  double(GetWidth())  / zoom_) - originX_;
+                viewY_ = ClampViewAxis(viewY_ + originY_, double(document_->GetHeight()), double(GetHeight()) / zoom_) - originY_;
+
+                return;
+            }
+
+            viewX_ = ClampViewAxis(viewX_, double(layers_.GetWidth()),  double(GetWidth())  / zoom_);
+            viewY_ = ClampViewAxis(viewY_, double(layers_.GetHeight()), double(GetHeight()) / zoom_);
+        }
+
+        static double ClampViewAxis(double view, double imageSize, double visibleSize) {
+            if (visibleSize >= imageSize) {
+                return (imageSize - visibleSize) / 2;
+            }
+
+            return std::clamp(view, 0.0, imageSize - visibleSize);
+        }
+
     public:
-        Image image_;
+        // Tools draw into active layer, window shows composite of all of them
+        LayerStack layers_;
 
         ImageWindow(uint32_t x, uint32_t y, uint32_t width, uint32_t height) :
         Window(x, y, width, height),
-        image_(width, height)
+        viewX_(0), viewY_(0), zoom_(1),
+        tileCache_(),
+        document_(nullptr), originX_(0), originY_(0),
+        layers_(width, height)
         {
 
         }
+        ~ImageWindow();
+
+        ImageWindow(const ImageWindow& window)            = delete;
+        ImageWindow& operator=(const ImageWindow& window) = delete;
+
+        Image& GetActiveImage() {
+            return layers_.GetActive();
+        }
+
+        // Cords are relative to window
+        CordsPair ViewToImage(const CordsPair& cords) const {
+            return {int32_t(std::floor(viewX_ + cords.x / zoom_)), int32_t(std::floor(viewY_ + cords.y / zoom_))};
+        }
+
+        double GetZoom() const {
+            return zoom_;
+        }
+
+        double GetViewX() const {
+            return viewX_;
+        }
+
+        double GetViewY() const {
+            return viewY_;
+        }
+
+        virtual void SetView(double x, double y, double zoom) {
+            viewX_ = x;
+            viewY_ = y;
+            zoom_  = std::clamp(zoom, MinViewZoom, MaxViewZoom);
+
+            ClampView();
+            SetChanged();
+        }
+
+        // Layers start at point (x, y) of document, view keeps its place relative to layers
+        void ShowDocument(const TiledDocument* document, uint32_t x, uint32_t y) {
+            document_ = document;
+            originX_  = x;
+            originY_  = y;
+
+            tileCache_.SetDocument(document, x, y);
+
+            ClampView();
+            SetChanged();
+        }
+
+        void ResetView() {
+            SetView(0, 0, 1);
+        }
+
+        // Image point under cords stays there
+        void ZoomAt(const CordsPair& cords, double factor) {
+            double newZoom = std::clamp(zoom_ * factor, MinViewZoom, MaxViewZoom);
+
+            SetView(viewX_ + cords.x / zoom_ - cords.x / newZoom, viewY_ + cords.y / zoom_ - cords.y / newZoom, newZoom);
+        }
+
+        // dx, dy are in window pixels
+        void PanView(int32_t dx, int32_t dy) {
+            SetView(viewX_ + dx / zoom_, viewY_ + dy / zoom_, zoom_);
+        }
 
         virtual void ReDraw() override {
-            image_.rotation_ = 0;
-            image_.Draw(widgetContainer_, {0, 0}, {0, 0}, uint32_t(GetWidth()), uint32_t(GetHeight()));
+            Image& composite = layers_.Update();
+
+            tileCache_.Update(composite);
+            tileCache_.Draw(widgetContainer_, composite, viewX_, viewY_, zoom_, uint32_t(GetWidth()), uint32_t(GetHeight()));
         }
 };
 
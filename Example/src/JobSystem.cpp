@@ -0,0 +1,97 @@
+#include "JobSystem.hpp"
+
+JobSystem::JobSystem(uint32_t workersAmount) :
+queues_(),
+workers_(),
+sleepMutex_(),
+wakeUp_(),
+queuedJobs_(0),
+nextQueue_(0),
+isStopping_(0)
+{
+    for (uint32_t workerIdx = 0; workerIdx < workersAmount; workerIdx++) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (uint32_t workerIdx = 0; workerIdx < workersAmount; workerIdx++) {
+        workers_.emplace_back(&JobSystem::WorkerLoop, this, workerIdx);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        isStopping_ = 1;
+    }
+
+    wakeUp_.notify_all();
+
+    for (auto& curWorker : workers_) {
+        curWorker.join();
+    }
+}
+
+void JobSystem::Submit(Job job) {
+    uint32_t queueIdx = nextQueue_++ % uint32_t(queues_.size());
+
+    {
+        std::lock_guard<std::mutex> lock(queues_[queueIdx]->mutex);
+        queues_[queueIdx]->jobs.push_back(std::move(job));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        queuedJobs_++;
+    }
+
+    wakeUp_.notify_one();
+}
+
+bool JobSystem::PopJob(uint32_t workerIdx, Job& job) {
+    uint32_t queuesAmount = uint32_t(queues_.size());
+
+    for (uint32_t shift = 0; shift < queuesAmount; shift++) {
+        WorkerQueue& curQueue = *queues_[(workerIdx + shift) % queuesAmount];
+
+        std::lock_guard<std::mutex> lock(curQueue.mutex);
+
+        if (curQueue.jobs.empty()) {
+            continue;
+        }
+
+        // Own jobs are taken LIFO while they are hot in cache, stolen ones FIFO
+        if (shift == 0) {
+            job = std::move(curQueue.jobs.back());
+            curQueue.jobs.pop_back();
+        }
+        else {
+            job = std::move(curQueue.jobs.front());
+            curQueue.jobs.pop_front();
+        }
+
+        queuedJobs_--;
+        return true;
+    }
+
+    return false;
+}
+
+void JobSystem::WorkerLoop(uint32_t workerIdx) {
+    Job curJob;
+
+    while (true) {
+        if (PopJob(workerIdx, curJob)) {
+            curJob();
+            curJob = nullptr;
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wakeUp_.wait(lock, [this]() { return isStopping_ || (queuedJobs_ > 0); });
+
+        if (isStopping_) {
+            return;
+        }
+    }
+}
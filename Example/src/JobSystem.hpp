@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> Job;
+
+// Thread pool with own queue for every worker. Worker takes jobs from the back of its queue
+// and steals from the front of others, when it runs out of work.
+class JobSystem {
+    private:
+        struct WorkerQueue {
+            std::deque<Job> jobs;
+            std::mutex mutex;
+
+            WorkerQueue() :
+            jobs(),
+            mutex()
+            {}
+        };
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues_;
+        std::vector<std::thread> workers_;
+
+        std::mutex sleepMutex_;
+        std::condition_variable wakeUp_;
+
+        std::atomic<int64_t>  queuedJobs_;
+        std::atomic<uint32_t> nextQueue_;
+        std::atomic<bool> isStopping_;
+
+        explicit JobSystem(uint32_t workersAmount);
+
+        bool PopJob(uint32_t workerIdx, Job& job);
+        void WorkerLoop(uint32_t workerIdx);
+
+    public:
+        JobSystem(const JobSystem& jobSystem)            = delete;
+        JobSystem& operator=(const JobSystem& jobSystem) = delete;
+
+        ~JobSystem();
+
+        // Workers are started on first use, one is left for main thread
+        static JobSystem& GetInstance() {
+            static JobSystem instance(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+            return instance;
+        }
+
+        void Submit(Job job);
+
+        uint32_t GetWorkersAmount() const {
+            return uint32_t(workers_.size());
+        }
+};
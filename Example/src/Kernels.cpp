@@ -0,0 +1,705 @@
+#include "Kernels.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#include "../pluginsrc/tools.hpp"
+
+#include "Color.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Scalar
+//-----------------------------------------------------------------------------
+
+static void FillScalar(uint32_t* dst, size_t count, uint32_t color) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        dst[curPixel] = color;
+    }
+}
+
+static inline uint32_t BlendOne(uint32_t dst, uint32_t src) {
+    uint32_t invAlpha = 255 - (src & 0xff);
+    uint32_t result   = 0;
+
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        uint32_t channel = ((src >> shift) & 0xff) + Div255(((dst >> shift) & 0xff) * invAlpha);
+
+        result |= std::min(channel, 255u) << shift;
+    }
+
+    return result;
+}
+
+static void BlendScalar(uint32_t* dst, const uint32_t* src, size_t count) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        dst[curPixel] = BlendOne(dst[curPixel], src[curPixel]);
+    }
+}
+
+static inline uint32_t ScaleOne(uint32_t color, uint32_t factor) {
+    uint32_t result = 0;
+
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        result |= Div255(((color >> shift) & 0xff) * factor) << shift;
+    }
+
+    return result;
+}
+
+static void ScaleScalar(uint32_t* dst, size_t count, uint8_t factor) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        dst[curPixel] = ScaleOne(dst[curPixel], factor);
+    }
+}
+
+static void BlendMaskedScalar(uint32_t* dst, const uint8_t* mask, size_t count, uint32_t color) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        if (mask[curPixel]) {
+            dst[curPixel] = BlendOne(dst[curPixel], ScaleOne(color, mask[curPixel]));
+        }
+    }
+}
+
+static void AddScalar(uint32_t* dst, const uint32_t* src, size_t count) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        uint32_t result = 0;
+
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            result |= std::min(((dst[curPixel] >> shift) & 0xff) + ((src[curPixel] >> shift) & 0xff), 255u) << shift;
+        }
+
+        dst[curPixel] = result;
+    }
+}
+
+// Separable modes for premultiplied colors. Alpha goes through the same formula and gets "over" alpha.
+// multiply: s * d + s * (1 - da) + d * (1 - sa), screen: s + d - s * d
+static void MultiplyScalar(uint32_t* dst, const uint32_t* src, size_t count) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        uint32_t srcAlpha = src[curPixel] & 0xff;
+        uint32_t dstAlpha = dst[curPixel] & 0xff;
+        uint32_t result   = 0;
+
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            uint32_t srcChannel = (src[curPixel] >> shift) & 0xff;
+            uint32_t dstChannel = (dst[curPixel] >> shift) & 0xff;
+
+            uint32_t channel = Div255(srcChannel * dstChannel) + Div255(srcChannel * (255 - dstAlpha)) + Div255(dstChannel * (255 - srcAlpha));
+
+            result |= std::min(channel, 255u) << shift;
+        }
+
+        dst[curPixel] = result;
+    }
+}
+
+static void ScreenScalar(uint32_t* dst, const uint32_t* src, size_t count) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        uint32_t result = 0;
+
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            uint32_t srcChannel = (src[curPixel] >> shift) & 0xff;
+            uint32_t dstChannel = (dst[curPixel] >> shift) & 0xff;
+
+            result |= (srcChannel + dstChannel - Div255(srcChannel * dstChannel)) << shift;
+        }
+
+        dst[curPixel] = result;
+    }
+}
+
+static inline uint32_t PremultiplyOne(uint32_t color) {
+    uint32_t alpha = color & 0xff;
+
+    return (Div255(((color >> 24) & 0xff) * alpha) << 24) + (Div255(((color >> 16) & 0xff) * alpha) << 16) +
+           (Div255(((color >> 8)  & 0xff) * alpha) << 8)  + alpha;
+}
+
+static void PremultiplyScalar(uint32_t* dst, const uint32_t* src, size_t count) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        dst[curPixel] = PremultiplyOne(src[curPixel]);
+    }
+}
+
+// Both directions of swizzle are byte reversal of every pixel
+static void SwizzleToScalar(uint8_t* dst, const uint32_t* src, size_t count, uint8_t alphaMask) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        uint32_t color = __builtin_bswap32(src[curPixel] | alphaMask);
+
+        std::memcpy(dst + curPixel * 4, &color, sizeof(color));
+    }
+}
+
+static void SwizzleFromScalar(uint32_t* dst, const uint8_t* src, size_t count) {
+    for (size_t curPixel = 0; curPixel < count; curPixel++) {
+        uint32_t color = 0;
+        std::memcpy(&color, src + curPixel * 4, sizeof(color));
+
+        dst[curPixel] = __builtin_bswap32(color);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// SSE2
+//-----------------------------------------------------------------------------
+
+#if defined(__SSE2__)
+
+static void FillSSE2(uint32_t* dst, size_t count, uint32_t color) {
+    const __m128i value = _mm_set1_epi32(int32_t(color));
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + curPixel), value);
+    }
+
+    FillScalar(dst + curPixel, count - curPixel, color);
+}
+
+static inline __m128i Div255SSE2(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Alpha is the low byte of pixel, so it is lane 0 of every 4 16-bit lanes
+static inline __m128i BroadcastAlphaSSE2(__m128i pixels16) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels16, 0x00), 0x00);
+}
+
+static void BlendSSE2(uint32_t* dst, const uint32_t* src, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        __m128i srcPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + curPixel));
+        __m128i dstPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + curPixel));
+
+        __m128i srcLo = _mm_unpacklo_epi8(srcPixels, zero);
+        __m128i srcHi = _mm_unpackhi_epi8(srcPixels, zero);
+
+        __m128i invLo = _mm_sub_epi16(full, BroadcastAlphaSSE2(srcLo));
+        __m128i invHi = _mm_sub_epi16(full, BroadcastAlphaSSE2(srcHi));
+
+        __m128i dstLo = Div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(dstPixels, zero), invLo));
+        __m128i dstHi = Div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(dstPixels, zero), invHi));
+
+        __m128i result = _mm_adds_epu8(_mm_packus_epi16(dstLo, dstHi), srcPixels);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + curPixel), result);
+    }
+
+    BlendScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+static void PremultiplySSE2(uint32_t* dst, const uint32_t* src, size_t count) {
+    const __m128i zero      = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(0xff);
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + curPixel));
+
+        __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+
+        lo = Div255SSE2(_mm_mullo_epi16(lo, BroadcastAlphaSSE2(lo)));
+        hi = Div255SSE2(_mm_mullo_epi16(hi, BroadcastAlphaSSE2(hi)));
+
+        __m128i result = _mm_packus_epi16(lo, hi);
+        result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, pixels));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + curPixel), result);
+    }
+
+    PremultiplyScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+static void ScaleSSE2(uint32_t* dst, size_t count, uint8_t factor) {
+    const __m128i zero       = _mm_setzero_si128();
+    const __m128i multiplier = _mm_set1_epi16(factor);
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + curPixel));
+
+        __m128i lo = Div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), multiplier));
+        __m128i hi = Div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), multiplier));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + curPixel), _mm_packus_epi16(lo, hi));
+    }
+
+    ScaleScalar(dst + curPixel, count - curPixel, factor);
+}
+
+// Every mask byte is repeated for 4 channels of its pixel, then it is the same blend as BlendSSE2
+static void BlendMaskedSSE2(uint32_t* dst, const uint8_t* mask, size_t count, uint32_t color) {
+    const __m128i zero    = _mm_setzero_si128();
+    const __m128i full    = _mm_set1_epi16(255);
+    const __m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32(int32_t(color)), zero);
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        int32_t maskBytes = 0;
+        std::memcpy(&maskBytes, mask + curPixel, sizeof(maskBytes));
+
+        if (!maskBytes) {
+            continue;
+        }
+
+        __m128i coverage = _mm_cvtsi32_si128(maskBytes);
+        coverage = _mm_unpacklo_epi8(coverage, coverage);
+        coverage = _mm_unpacklo_epi16(coverage, coverage);
+
+        __m128i srcLo = Div255SSE2(_mm_mullo_epi16(color16, _mm_unpacklo_epi8(coverage, zero)));
+        __m128i srcHi = Div255SSE2(_mm_mullo_epi16(color16, _mm_unpackhi_epi8(coverage, zero)));
+
+        __m128i invLo = _mm_sub_epi16(full, BroadcastAlphaSSE2(srcLo));
+        __m128i invHi = _mm_sub_epi16(full, BroadcastAlphaSSE2(srcHi));
+
+        __m128i dstPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + curPixel));
+
+        __m128i dstLo = Div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(dstPixels, zero), invLo));
+        __m128i dstHi = Div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(dstPixels, zero), invHi));
+
+        __m128i result = _mm_adds_epu8(_mm_packus_epi16(dstLo, dstHi), _mm_packus_epi16(srcLo, srcHi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + curPixel), result);
+    }
+
+    BlendMaskedScalar(dst + curPixel, mask + curPixel, count - curPixel, color);
+}
+
+static void AddSSE2(uint32_t* dst, const uint32_t* src, size_t count) {
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        __m128i srcPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + curPixel));
+        __m128i dstPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + curPixel));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + curPixel), _mm_adds_epu8(dstPixels, srcPixels));
+    }
+
+    AddScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+static inline __m128i ByteSwapSSE2(__m128i x) {
+    // SSE2 has no byte shuffle, so swap 16-bit halves and then bytes in them
+    x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+    return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static void SwizzleToSSE2(uint8_t* dst, const uint32_t* src, size_t count, uint8_t alphaMask) {
+    const __m128i mask = _mm_set1_epi32(alphaMask);
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        __m128i pixels = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + curPixel)), mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + curPixel * 4), ByteSwapSSE2(pixels));
+    }
+
+    SwizzleToScalar(dst + curPixel * 4, src + curPixel, count - curPixel, alphaMask);
+}
+
+static void SwizzleFromSSE2(uint32_t* dst, const uint8_t* src, size_t count) {
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + curPixel * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + curPixel), ByteSwapSSE2(pixels));
+    }
+
+    SwizzleFromScalar(dst + curPixel, src + curPixel * 4, count - curPixel);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// AVX2
+//-----------------------------------------------------------------------------
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_AVX2_KERNELS
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static void FillAVX2(uint32_t* dst, size_t count, uint32_t color) {
+    const __m256i value = _mm256_set1_epi32(int32_t(color));
+
+    size_t curPixel = 0;
+    for (; curPixel + 8 <= count; curPixel += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + curPixel), value);
+    }
+
+    FillScalar(dst + curPixel, count - curPixel, color);
+}
+
+AVX2_TARGET static inline __m256i Div255AVX2(__m256i x) {
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+AVX2_TARGET static inline __m256i BroadcastAlphaAVX2(__m256i pixels16) {
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels16, 0x00), 0x00);
+}
+
+AVX2_TARGET static void BlendAVX2(uint32_t* dst, const uint32_t* src, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i full = _mm256_set1_epi16(255);
+
+    size_t curPixel = 0;
+    for (; curPixel + 8 <= count; curPixel += 8) {
+        __m256i srcPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + curPixel));
+        __m256i dstPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + curPixel));
+
+        // unpack and pack both work inside 128-bit lanes, so pixel order is kept
+        __m256i srcLo = _mm256_unpacklo_epi8(srcPixels, zero);
+        __m256i srcHi = _mm256_unpackhi_epi8(srcPixels, zero);
+
+        __m256i invLo = _mm256_sub_epi16(full, BroadcastAlphaAVX2(srcLo));
+        __m256i invHi = _mm256_sub_epi16(full, BroadcastAlphaAVX2(srcHi));
+
+        __m256i dstLo = Div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(dstPixels, zero), invLo));
+        __m256i dstHi = Div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(dstPixels, zero), invHi));
+
+        __m256i result = _mm256_adds_epu8(_mm256_packus_epi16(dstLo, dstHi), srcPixels);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + curPixel), result);
+    }
+
+    BlendScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+AVX2_TARGET static void PremultiplyAVX2(uint32_t* dst, const uint32_t* src, size_t count) {
+    const __m256i zero      = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set1_epi32(0xff);
+
+    size_t curPixel = 0;
+    for (; curPixel + 8 <= count; curPixel += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + curPixel));
+
+        __m256i lo = _mm256_unpacklo_epi8(pixels, zero);
+        __m256i hi = _mm256_unpackhi_epi8(pixels, zero);
+
+        lo = Div255AVX2(_mm256_mullo_epi16(lo, BroadcastAlphaAVX2(lo)));
+        hi = Div255AVX2(_mm256_mullo_epi16(hi, BroadcastAlphaAVX2(hi)));
+
+        __m256i result = _mm256_packus_epi16(lo, hi);
+        result = _mm256_blendv_epi8(result, pixels, alphaMask);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + curPixel), result);
+    }
+
+    PremultiplyScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+AVX2_TARGET static void ScaleAVX2(uint32_t* dst, size_t count, uint8_t factor) {
+    const __m256i zero       = _mm256_setzero_si256();
+    const __m256i multiplier = _mm256_set1_epi16(factor);
+
+    size_t curPixel = 0;
+    for (; curPixel + 8 <= count; curPixel += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + curPixel));
+
+        __m256i lo = Div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), multiplier));
+        __m256i hi = Div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), multiplier));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + curPixel), _mm256_packus_epi16(lo, hi));
+    }
+
+    ScaleScalar(dst + curPixel, count - curPixel, factor);
+}
+
+AVX2_TARGET static void BlendMaskedAVX2(uint32_t* dst, const uint8_t* mask, size_t count, uint32_t color) {
+    const __m256i zero    = _mm256_setzero_si256();
+    const __m256i full    = _mm256_set1_epi16(255);
+    const __m256i color16 = _mm256_unpacklo_epi8(_mm256_set1_epi32(int32_t(color)), zero);
+
+    // Pixels 0-3 are in low lane, 4-7 in high one
+    const __m256i spread  = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                             4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+
+    size_t curPixel = 0;
+    for (; curPixel + 8 <= count; curPixel += 8) {
+        int64_t maskBytes = 0;
+        std::memcpy(&maskBytes, mask + curPixel, sizeof(maskBytes));
+
+        if (!maskBytes) {
+            continue;
+        }
+
+        __m256i coverage = _mm256_shuffle_epi8(_mm256_set1_epi64x(maskBytes), spread);
+
+        __m256i srcLo = Div255AVX2(_mm256_mullo_epi16(color16, _mm256_unpacklo_epi8(coverage, zero)));
+        __m256i srcHi = Div255AVX2(_mm256_mullo_epi16(color16, _mm256_unpackhi_epi8(coverage, zero)));
+
+        __m256i invLo = _mm256_sub_epi16(full, BroadcastAlphaAVX2(srcLo));
+        __m256i invHi = _mm256_sub_epi16(full, BroadcastAlphaAVX2(srcHi));
+
+        __m256i dstPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + curPixel));
+
+        __m256i dstLo = Div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(dstPixels, zero), invLo));
+        __m256i dstHi = Div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(dstPixels, zero), invHi));
+
+        __m256i result = _mm256_adds_epu8(_mm256_packus_epi16(dstLo, dstHi), _mm256_packus_epi16(srcLo, srcHi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + curPixel), result);
+    }
+
+    BlendMaskedScalar(dst + curPixel, mask + curPixel, count - curPixel, color);
+}
+
+AVX2_TARGET static void AddAVX2(uint32_t* dst, const uint32_t* src, size_t count) {
+    size_t curPixel = 0;
+    for (; curPixel + 8 <= count; curPixel += 8) {
+        __m256i srcPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + curPixel));
+        __m256i dstPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + curPixel));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + curPixel), _mm256_adds_epu8(dstPixels, srcPixels));
+    }
+
+    AddScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+AVX2_TARGET static inline __m256i ByteSwapAVX2(__m256i x) {
+    const __m256i order = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm256_shuffle_epi8(x, order);
+}
+
+AVX2_TARGET static void SwizzleToAVX2(uint8_t* dst, const uint32_t* src, size_t count, uint8_t alphaMask) {
+    const __m256i mask = _mm256_set1_epi32(alphaMask);
+
+    size_t curPixel = 0;
+    for (; curPixel + 8 <= count; curPixel += 8) {
+        __m256i pixels = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + curPixel)), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + curPixel * 4), ByteSwapAVX2(pixels));
+    }
+
+    SwizzleToScalar(dst + curPixel * 4, src + curPixel, count - curPixel, alphaMask);
+}
+
+AVX2_TARGET static void SwizzleFromAVX2(uint32_t* dst, const uint8_t* src, size_t count) {
+    size_t curPixel = 0;
+    for (; curPixel + 8 <= count; curPixel += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + curPixel * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + curPixel), ByteSwapAVX2(pixels));
+    }
+
+    SwizzleFromScalar(dst + curPixel, src + curPixel * 4, count - curPixel);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// NEON
+//-----------------------------------------------------------------------------
+
+#if defined(__ARM_NEON)
+
+static void FillNEON(uint32_t* dst, size_t count, uint32_t color) {
+    const uint32x4_t value = vdupq_n_u32(color);
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        vst1q_u32(dst + curPixel, value);
+    }
+
+    FillScalar(dst + curPixel, count - curPixel, color);
+}
+
+static inline uint8x8_t Div255NEON(uint16x8_t x) {
+    x = vaddq_u16(x, vdupq_n_u16(128));
+    return vshrn_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+}
+
+static inline uint8x16_t MulDiv255NEON(uint8x16_t channel, uint8x16_t factor) {
+    return vcombine_u8(Div255NEON(vmull_u8(vget_low_u8(channel),  vget_low_u8(factor))),
+                       Div255NEON(vmull_u8(vget_high_u8(channel), vget_high_u8(factor))));
+}
+
+// vld4 splits pixels into planes: val[0] - alpha, val[1] - blue, val[2] - green, val[3] - red
+static void BlendNEON(uint32_t* dst, const uint32_t* src, size_t count) {
+    size_t curPixel = 0;
+    for (; curPixel + 16 <= count; curPixel += 16) {
+        uint8x16x4_t srcPixels = vld4q_u8(reinterpret_cast<const uint8_t*>(src + curPixel));
+        uint8x16x4_t dstPixels = vld4q_u8(reinterpret_cast<const uint8_t*>(dst + curPixel));
+
+        uint8x16_t invAlpha = vmvnq_u8(srcPixels.val[0]);
+
+        for (int channel = 0; channel < 4; channel++) {
+            dstPixels.val[channel] = vqaddq_u8(srcPixels.val[channel], MulDiv255NEON(dstPixels.val[channel], invAlpha));
+        }
+
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + curPixel), dstPixels);
+    }
+
+    BlendScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+static void PremultiplyNEON(uint32_t* dst, const uint32_t* src, size_t count) {
+    size_t curPixel = 0;
+    for (; curPixel + 16 <= count; curPixel += 16) {
+        uint8x16x4_t pixels = vld4q_u8(reinterpret_cast<const uint8_t*>(src + curPixel));
+
+        for (int channel = 1; channel < 4; channel++) {
+            pixels.val[channel] = MulDiv255NEON(pixels.val[channel], pixels.val[0]);
+        }
+
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + curPixel), pixels);
+    }
+
+    PremultiplyScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+static void ScaleNEON(uint32_t* dst, size_t count, uint8_t factor) {
+    const uint8x16_t multiplier = vdupq_n_u8(factor);
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        uint8x16_t pixels = vreinterpretq_u8_u32(vld1q_u32(dst + curPixel));
+        vst1q_u32(dst + curPixel, vreinterpretq_u32_u8(MulDiv255NEON(pixels, multiplier)));
+    }
+
+    ScaleScalar(dst + curPixel, count - curPixel, factor);
+}
+
+static void AddNEON(uint32_t* dst, const uint32_t* src, size_t count) {
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        vst1q_u32(dst + curPixel, vreinterpretq_u32_u8(vqaddq_u8(vreinterpretq_u8_u32(vld1q_u32(dst + curPixel)),
+                                                                 vreinterpretq_u8_u32(vld1q_u32(src + curPixel)))));
+    }
+
+    AddScalar(dst + curPixel, src + curPixel, count - curPixel);
+}
+
+static void SwizzleToNEON(uint8_t* dst, const uint32_t* src, size_t count, uint8_t alphaMask) {
+    const uint32x4_t mask = vdupq_n_u32(alphaMask);
+
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        uint32x4_t pixels = vorrq_u32(vld1q_u32(src + curPixel), mask);
+        vst1q_u8(dst + curPixel * 4, vrev32q_u8(vreinterpretq_u8_u32(pixels)));
+    }
+
+    SwizzleToScalar(dst + curPixel * 4, src + curPixel, count - curPixel, alphaMask);
+}
+
+static void SwizzleFromNEON(uint32_t* dst, const uint8_t* src, size_t count) {
+    size_t curPixel = 0;
+    for (; curPixel + 4 <= count; curPixel += 4) {
+        vst1q_u32(dst + curPixel, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(src + curPixel * 4))));
+    }
+
+    SwizzleFromScalar(dst + curPixel, src + curPixel * 4, count - curPixel);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// Dispatch
+//-----------------------------------------------------------------------------
+
+struct KernelTable {
+    KernelSet set;
+    const char* name;
+
+    void (*fill)       (uint32_t* dst, size_t count, uint32_t color);
+    void (*blend)      (uint32_t* dst, const uint32_t* src, size_t count);
+    void (*premultiply)(uint32_t* dst, const uint32_t* src, size_t count);
+    void (*scale)      (uint32_t* dst, size_t count, uint8_t factor);
+    void (*add)        (uint32_t* dst, const uint32_t* src, size_t count);
+    void (*blendMasked)(uint32_t* dst, const uint8_t* mask, size_t count, uint32_t color);
+    void (*swizzleTo)  (uint8_t* dst, const uint32_t* src, size_t count, uint8_t alphaMask);
+    void (*swizzleFrom)(uint32_t* dst, const uint8_t* src, size_t count);
+};
+
+static KernelTable SelectKernels() {
+#if defined(HAS_AVX2_KERNELS)
+    if (__builtin_cpu_supports("avx2")) {
+        return {KernelSet::AVX2, "AVX2", FillAVX2, BlendAVX2, PremultiplyAVX2, ScaleAVX2, AddAVX2, BlendMaskedAVX2, SwizzleToAVX2, SwizzleFromAVX2};
+    }
+#endif
+
+#if defined(__SSE2__)
+    return {KernelSet::SSE2, "SSE2", FillSSE2, BlendSSE2, PremultiplySSE2, ScaleSSE2, AddSSE2, BlendMaskedSSE2, SwizzleToSSE2, SwizzleFromSSE2};
+#elif defined(__ARM_NEON)
+    return {KernelSet::NEON, "NEON", FillNEON, BlendNEON, PremultiplyNEON, ScaleNEON, AddNEON, BlendMaskedScalar, SwizzleToNEON, SwizzleFromNEON};
+#else
+    return {KernelSet::Scalar, "Scalar", FillScalar, BlendScalar, PremultiplyScalar, ScaleScalar, AddScalar, BlendMaskedScalar, SwizzleToScalar, SwizzleFromScalar};
+#endif
+}
+
+static const KernelTable& GetKernels() {
+    static const KernelTable kernels = SelectKernels();
+
+    return kernels;
+}
+
+KernelSet GetKernelSet() {
+    return GetKernels().set;
+}
+
+const char* GetKernelSetName() {
+    return GetKernels().name;
+}
+
+void FillPixels(uint32_t* dst, size_t count, uint32_t color) {
+    GetKernels().fill(dst, count, color);
+}
+
+void ClearPixels(uint32_t* dst, size_t count) {
+    GetKernels().fill(dst, count, 0);
+}
+
+void BlendPixels(uint32_t* dst, const uint32_t* src, size_t count) {
+    GetKernels().blend(dst, src, count);
+}
+
+void PremultiplyPixels(uint32_t* dst, const uint32_t* src, size_t count) {
+    GetKernels().premultiply(dst, src, count);
+}
+
+void ScalePixels(uint32_t* dst, size_t count, uint8_t factor) {
+    GetKernels().scale(dst, count, factor);
+}
+
+// Multiply and screen have no vector versions yet, they are rare modes of layers
+void BlendPixels(uint32_t* dst, const uint32_t* src, size_t count, BlendMode mode) {
+    switch (mode) {
+        case BlendMode::Normal:   GetKernels().blend(dst, src, count); break;
+        case BlendMode::Add:      GetKernels().add(dst, src, count);   break;
+        case BlendMode::Multiply: MultiplyScalar(dst, src, count);     break;
+        case BlendMode::Screen:   ScreenScalar(dst, src, count);       break;
+
+        default:
+            break;
+    }
+}
+
+void BlendMaskedPixels(uint32_t* dst, const uint8_t* mask, size_t count, uint32_t color) {
+    GetKernels().blendMasked(dst, mask, count, color);
+}
+
+void SwizzleToRGBA8(uint8_t* dst, const uint32_t* src, size_t count, uint8_t alphaMask) {
+    GetKernels().swizzleTo(dst, src, count, alphaMask);
+}
+
+void SwizzleFromRGBA8(uint32_t* dst, const uint8_t* src, size_t count) {
+    GetKernels().swizzleFrom(dst, src, count);
+}
+
+void booba::fillPixels(uint32_t* dst, uint32_t count, uint32_t color) {
+    FillPixels(dst, count, color);
+}
+
+void booba::blendPixels(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    BlendPixels(dst, src, count);
+}
+
+void booba::premultiplyPixels(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    PremultiplyPixels(dst, src, count);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Pixel kernels used by Image and given to plugins through tools.hpp.
+// All of them work with booba colors 0xRRGGBBAA. Best of scalar/SSE2/AVX2/NEON is chosen on first call.
+
+// Blend modes of layers
+enum class BlendMode : uint8_t {
+    Normal,
+    Multiply,
+    Screen,
+    Add,
+};
+
+const uint32_t BlendModesAmount = 4;
+
+enum class KernelSet {
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON,
+};
+
+KernelSet GetKernelSet();
+const char* GetKernelSetName();
+
+void FillPixels(uint32_t* dst, size_t count, uint32_t color);
+void ClearPixels(uint32_t* dst, size_t count);
+
+// Porter-Duff "over" for premultiplied colors: dst = src + dst * (1 - src.alpha)
+void BlendPixels(uint32_t* dst, const uint32_t* src, size_t count);
+
+// Premultiplied src is blended onto dst with mode, Normal is the same as BlendPixels above
+void BlendPixels(uint32_t* dst, const uint32_t* src, size_t count, BlendMode mode);
+
+// Premultiplied color scaled by coverage mask[i] / 255 is blended over dst[i], brush stamps use it
+void BlendMaskedPixels(uint32_t* dst, const uint8_t* mask, size_t count, uint32_t color);
+
+// All channels of premultiplied colors are multiplied by factor / 255, i.e. opacity is applied
+void ScalePixels(uint32_t* dst, size_t count, uint8_t factor);
+
+// Multiplies color channels by alpha. dst and src can be the same buffer.
+void PremultiplyPixels(uint32_t* dst, const uint32_t* src, size_t count);
+
+// Booba colors to RGBA8 bytes in memory order, as SFML textures want them.
+// alphaMask is or'ed to alpha of every pixel, 0xff makes them all opaque.
+void SwizzleToRGBA8(uint8_t* dst, const uint32_t* src, size_t count, uint8_t alphaMask);
+
+// RGBA8 bytes in memory order to booba colors
+void SwizzleFromRGBA8(uint32_t* dst, const uint8_t* src, size_t count);
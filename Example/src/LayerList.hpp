@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Window.hpp"
+#include "LayerStack.hpp"
+#include "SetupBar.hpp"
+
+// Layers are shown as row of cells, the bottom layer is the left cell, the active one is highlighted.
+// Filled part of cell is opacity of layer colored by its blend mode, hidden layer cell is empty.
+const int64_t  LayerCellSize    = 12;
+const int64_t  LayerCellGap     = 3;
+const int64_t  LayerCellBorder  = 2;
+const uint32_t LayerCellColor   = 0x404040ff;
+const uint32_t LayerActiveColor = 0x9400d3ff;
+
+const uint32_t LayerModeColors[BlendModesAmount] = {0xffffffff, 0x6080c0ff, 0xffe060ff, 0xff8020ff};
+
+// Status line under cells tells why the last layer key did nothing
+const int64_t  LayerStatusHeight = 20;
+
+// Layers of canvas and status of layer keys. Canvas refreshes the list after every change of layers.
+class LayerList : public Window {
+    private:
+        const LayerStack* layers_;
+
+        SetupLabel* status_;
+
+    public:
+        LayerList(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const LayerStack* layers) :
+        Window(x, y, width, height),
+        layers_(layers),
+        status_(new SetupLabel(0, uint32_t(LayerCellSize + 2 * LayerCellGap), width, uint32_t(LayerStatusHeight), ""))
+        {
+            widgetColor_ = SetupPanelColor;
+
+            *this += status_;
+        }
+
+        LayerList(const LayerList& list)            = delete;
+        LayerList& operator=(const LayerList& list) = delete;
+
+        // Layers are redrawn, status from previous key is cleared
+        void Refresh() {
+            status_->SetText("");
+
+            SetChanged();
+        }
+
+        void ShowStatus(const char* text) {
+            status_->SetText(text);
+        }
+
+        virtual void ReDraw() override {
+            Window::ReDraw();
+
+            int64_t fillSize = LayerCellSize - 2 * LayerCellBorder;
+
+            for (uint32_t layerIdx = 0; layerIdx < layers_->GetLayersAmount(); layerIdx++) {
+                const Layer& layer = layers_->GetLayerInfo(layerIdx);
+
+                int64_t cellX = LayerCellGap + int64_t(layerIdx) * (LayerCellSize + LayerCellGap);
+
+                Rectangle cell({LayerCellSize, LayerCellSize, cellX, LayerCellGap});
+                cell.Draw(widgetContainer_, (layerIdx == layers_->GetActiveIdx()) ? LayerActiveColor : LayerCellColor);
+
+                int64_t fillHeight = fillSize * layer.opacity / 255;
+
+                if (!layer.isVisible || !fillHeight) {
+                    continue;
+                }
+
+                Rectangle fill({fillSize, fillHeight, cellX + LayerCellBorder, LayerCellGap + LayerCellSize - LayerCellBorder - fillHeight});
+                fill.Draw(widgetContainer_, LayerModeColors[uint32_t(layer.mode)]);
+            }
+        }
+};
@@ -0,0 +1,223 @@
+#include "LayerStack.hpp"
+
+#include <cstring>
+
+LayerStack::LayerStack(uint32_t width, uint32_t height) :
+layers_(),
+active_(0),
+width_(width),
+height_(height),
+composite_(width, height),
+below_(size_t(width) * height, 0),
+tileStates_(),
+tilesInRow_((width + CompositeTileSize - 1) / CompositeTileSize),
+tilesInColumn_((height + CompositeTileSize - 1) / CompositeTileSize),
+rowBuffer_(CompositeTileSize)
+{
+    layers_.reserve(MaxLayers);
+    layers_.push_back({std::make_unique<Image>(width, height), BlendMode::Normal, 255, true});
+
+    tileStates_.assign(size_t(tilesInRow_) * tilesInColumn_, CompositeStale | BelowStale);
+}
+
+void LayerStack::MarkStale(const PixelRect& rect, uint8_t state) {
+    PixelRect clipped = rect.Intersected({0, 0, width_, height_});
+
+    if (clipped.IsEmpty()) {
+        return;
+    }
+
+    // Tiles are composed whole, but only stale rects of them really change, so only they are uploaded
+    composite_.MarkDirty(clipped);
+
+    for (uint32_t tileY = clipped.y / CompositeTileSize; tileY * CompositeTileSize < clipped.Bottom(); tileY++) {
+        for (uint32_t tileX = clipped.x / CompositeTileSize; tileX * CompositeTileSize < clipped.Right(); tileX++) {
+            tileStates_[size_t(tileY) * tilesInRow_ + tileX] |= state;
+        }
+    }
+}
+
+void LayerStack::MarkLayerStale(uint32_t layerIdx) {
+    MarkStale({0, 0, width_, height_}, uint8_t(CompositeStale | ((layerIdx < active_) ? BelowStale : 0)));
+}
+
+Image* LayerStack::AddLayer() {
+    if (layers_.size() >= MaxLayers) {
+        return nullptr;
+    }
+
+    active_++;
+    layers_.insert(layers_.begin() + active_, {std::make_unique<Image>(width_, height_), BlendMode::Normal, 255, true});
+
+    // Previous active layer is below now
+    MarkStale({0, 0, width_, height_}, CompositeStale | BelowStale);
+
+    return layers_[active_].image.get();
+}
+
+bool LayerStack::RemoveLayer(uint32_t layerIdx) {
+    if (!layerIdx || (layerIdx >= layers_.size())) {
+        return false;
+    }
+
+    layers_.erase(layers_.begin() + layerIdx);
+
+    if (active_ >= layerIdx) {
+        active_--;
+    }
+
+    MarkStale({0, 0, width_, height_}, CompositeStale | BelowStale);
+    return true;
+}
+
+void LayerStack::RemoveUpperLayers() {
+    layers_.resize(1);
+    active_ = 0;
+
+    MarkStale({0, 0, width_, height_}, CompositeStale | BelowStale);
+}
+
+void LayerStack::Flatten() {
+    const Image& composite = Update();
+    Image& background = *layers_[0].image;
+
+    for (uint32_t curY = 0; curY < height_; curY++) {
+        std::memcpy(background.GetPixels() + size_t(curY) * background.GetStride(),
+                    composite.GetPixels()  + size_t(curY) * composite.GetStride(), size_t(width_) * sizeof(uint32_t));
+    }
+
+    layers_[0].mode      = BlendMode::Normal;
+    layers_[0].opacity   = 255;
+    layers_[0].isVisible = true;
+
+    RemoveUpperLayers();
+}
+
+void LayerStack::Resize(uint32_t width, uint32_t height) {
+    layers_.resize(1);
+    active_ = 0;
+
+    layers_[0].image->Create(width, height);
+    layers_[0].mode      = BlendMode::Normal;
+    layers_[0].opacity   = 255;
+    layers_[0].isVisible = true;
+
+    width_  = width;
+    height_ = height;
+
+    composite_.Create(width, height);
+    below_.assign(size_t(width) * height, 0);
+
+    tilesInRow_    = (width  + CompositeTileSize - 1) / CompositeTileSize;
+    tilesInColumn_ = (height + CompositeTileSize - 1) / CompositeTileSize;
+    tileStates_.assign(size_t(tilesInRow_) * tilesInColumn_, CompositeStale | BelowStale);
+}
+
+void LayerStack::SetActive(uint32_t layerIdx) {
+    if ((layerIdx >= layers_.size()) || (layerIdx == active_)) {
+        return;
+    }
+
+    active_ = layerIdx;
+
+    MarkStale({0, 0, width_, height_}, CompositeStale | BelowStale);
+}
+
+void LayerStack::SetOpacity(uint32_t layerIdx, uint8_t opacity) {
+    if (layers_[layerIdx].opacity != opacity) {
+        layers_[layerIdx].opacity = opacity;
+        MarkLayerStale(layerIdx);
+    }
+}
+
+void LayerStack::SetMode(uint32_t layerIdx, BlendMode mode) {
+    if (layers_[layerIdx].mode != mode) {
+        layers_[layerIdx].mode = mode;
+        MarkLayerStale(layerIdx);
+    }
+}
+
+void LayerStack::SetVisible(uint32_t layerIdx, bool isVisible) {
+    if (layers_[layerIdx].isVisible != isVisible) {
+        layers_[layerIdx].isVisible = isVisible;
+        MarkLayerStale(layerIdx);
+    }
+}
+
+// Only translucent layers are copied, opaque ones are blended from their own rows
+void LayerStack::BlendLayerRow(uint32_t* dst, uint32_t layerIdx, uint32_t x, uint32_t y, uint32_t count) {
+    const Layer& layer = layers_[layerIdx];
+
+    if (!layer.isVisible || !layer.opacity) {
+        return;
+    }
+
+    const uint32_t* src = layer.image->GetPixels() + size_t(y) * layer.image->GetStride() + x;
+
+    if (layer.opacity != 255) {
+        std::memcpy(rowBuffer_.data(), src, size_t(count) * sizeof(uint32_t));
+        ScalePixels(rowBuffer_.data(), count, layer.opacity);
+
+        src = rowBuffer_.data();
+    }
+
+    BlendPixels(dst, src, count, layer.mode);
+}
+
+void LayerStack::ComposeTile(uint32_t tileX, uint32_t tileY, uint8_t state) {
+    PixelRect rect = PixelRect({tileX * CompositeTileSize, tileY * CompositeTileSize, CompositeTileSize, CompositeTileSize})
+                     .Intersected({0, 0, width_, height_});
+
+    uint32_t* compositePixels = composite_.GetPixels();
+    uint32_t  compositeStride = composite_.GetStride();
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++) {
+        uint32_t* belowRow = below_.data() + size_t(curY) * width_ + rect.x;
+
+        if (state & BelowStale) {
+            ClearPixels(belowRow, rect.width);
+
+            for (uint32_t layerIdx = 0; layerIdx < active_; layerIdx++) {
+                BlendLayerRow(belowRow, layerIdx, rect.x, curY, rect.width);
+            }
+        }
+
+        uint32_t* dstRow = compositePixels + size_t(curY) * compositeStride + rect.x;
+        std::memcpy(dstRow, belowRow, size_t(rect.width) * sizeof(uint32_t));
+
+        for (uint32_t layerIdx = active_; layerIdx < layers_.size(); layerIdx++) {
+            BlendLayerRow(dstRow, layerIdx, rect.x, curY, rect.width);
+        }
+    }
+}
+
+Image& LayerStack::Update() {
+    for (uint32_t layerIdx = 0; layerIdx < layers_.size(); layerIdx++) {
+        Image& image = *layers_[layerIdx].image;
+
+        if (!image.IsDirty()) {
+            continue;
+        }
+
+        uint8_t state = uint8_t(CompositeStale | ((layerIdx < active_) ? BelowStale : 0));
+
+        for (auto& curRect : image.GetDirty().GetRects()) {
+            MarkStale(curRect, state);
+        }
+
+        image.ClearDirty();
+    }
+
+    for (uint32_t tileY = 0; tileY < tilesInColumn_; tileY++) {
+        for (uint32_t tileX = 0; tileX < tilesInRow_; tileX++) {
+            uint8_t& state = tileStates_[size_t(tileY) * tilesInRow_ + tileX];
+
+            if (state) {
+                ComposeTile(tileX, tileY, state);
+                state = 0;
+            }
+        }
+    }
+
+    return composite_;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Primitives.hpp"
+#include "Kernels.hpp"
+
+const uint32_t CompositeTileSize = 64;
+const uint32_t MaxLayers         = 16;
+
+const char* const BlendModeNames[BlendModesAmount] = {
+    "normal",
+    "multiply",
+    "screen",
+    "add",
+};
+
+struct Layer {
+    std::unique_ptr<Image> image = nullptr;
+
+    BlendMode mode  = BlendMode::Normal;
+    uint8_t opacity = 0xff;
+    bool isVisible  = 1;
+};
+
+// Layers of canvas from bottom to top and their flattened composite, which is what canvas shows.
+// Layers are premultiplied like every Image, so their rows are blended into composite straight from their buffers.
+// Composite is recomputed only in tiles where some layer changed.
+// Layers under active one are flattened separately, so strokes on active layer blend only it and layers above.
+class LayerStack {
+    private:
+        enum TileState : uint8_t {
+            CompositeStale = 1,
+            BelowStale     = 2,
+        };
+
+        std::vector<Layer> layers_;
+        uint32_t active_;
+
+        uint32_t width_;
+        uint32_t height_;
+
+        Image composite_;
+        // Flattened layers under active one, row stride is width_
+        std::vector<uint32_t> below_;
+
+        std::vector<uint8_t> tileStates_;
+        uint32_t tilesInRow_;
+        uint32_t tilesInColumn_;
+
+        std::vector<uint32_t> rowBuffer_;
+
+        void MarkStale(const PixelRect& rect, uint8_t state);
+        void MarkLayerStale(uint32_t layerIdx);
+
+        void BlendLayerRow(uint32_t* dst, uint32_t layerIdx, uint32_t x, uint32_t y, uint32_t count);
+        void ComposeTile(uint32_t tileX, uint32_t tileY, uint8_t state);
+
+    public:
+        LayerStack(uint32_t width, uint32_t height);
+
+        LayerStack(const LayerStack& stack)            = delete;
+        LayerStack& operator=(const LayerStack& stack) = delete;
+
+        uint32_t GetWidth() const {
+            return width_;
+        }
+
+        uint32_t GetHeight() const {
+            return height_;
+        }
+
+        uint32_t GetLayersAmount() const {
+            return uint32_t(layers_.size());
+        }
+
+        uint32_t GetActiveIdx() const {
+            return active_;
+        }
+
+        Image& GetActive() {
+            return *layers_[active_].image;
+        }
+
+        Image& GetLayer(uint32_t layerIdx) {
+            return *layers_[layerIdx].image;
+        }
+
+        const Layer& GetLayerInfo(uint32_t layerIdx) const {
+            return layers_[layerIdx];
+        }
+
+        // New transparent layer is put above active one and becomes active. Returns nullptr if there are too many.
+        Image* AddLayer();
+
+        // Bottom layer can't be removed
+        bool RemoveLayer(uint32_t layerIdx);
+
+        // Only background is left, it becomes active
+        void RemoveUpperLayers();
+
+        // Composite is written into background, which becomes the only layer with normal mode
+        void Flatten();
+
+        // Only background is left, it is cleared. Images stay the same objects, so their handlers are kept.
+        void Resize(uint32_t width, uint32_t height);
+
+        // Composite is equal to background
+        bool IsFlat() const {
+            const Layer& background = layers_[0];
+
+            return (layers_.size() == 1) && (background.mode == BlendMode::Normal) && (background.opacity == 255) && background.isVisible;
+        }
+
+        void SetActive(uint32_t layerIdx);
+
+        void SetOpacity(uint32_t layerIdx, uint8_t opacity);
+        void SetMode(uint32_t layerIdx, BlendMode mode);
+        void SetVisible(uint32_t layerIdx, bool isVisible);
+
+        // Takes changes of layers, their dirty regions are cleared, and brings composite up to date.
+        // Dirty region of composite gets recomputed tiles.
+        Image& Update();
+
+        const Image& GetComposite() const {
+            return composite_;
+        }
+};
@@ -3,27 +3,134 @@
 // Definition of extern var from tools.hpp
 booba::ApplicationContext* booba::APPCONTEXT = nullptr;
 
-int main() {
-    RealWindow mainWindow(1600, 900);
+// Frame budget of replay which runs as fast as possible, scheduler never sleeps with it
+const uint32_t FastReplayFps = 100000;
+
+// Usage: Graph.out [--fps N] [--vsync] [--record log] [--replay log [--fast]] [document [width height]]
+// Document is tiled document, its sizes are needed only if it has to be created.
+// With --vsync frames wait for screen instead of target fps.
+int main(int argc, char** argv) {
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    bool isFastReplay = false;
+
+    uint32_t targetFps = DefaultTargetFps;
+    bool isVsync = false;
+
+    std::vector<const char*> positional;
+
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        if (!strcmp(argv[argIdx], "--record") && (argIdx + 1 < argc)) {
+            recordPath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--replay") && (argIdx + 1 < argc)) {
+            replayPath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--fast")) {
+            isFastReplay = true;
+        }
+        else if (!strcmp(argv[argIdx], "--fps") && (argIdx + 1 < argc)) {
+            uint32_t fps = uint32_t(strtoul(argv[++argIdx], nullptr, 10));
+
+            if (fps) {
+                targetFps = fps;
+            }
+            else {
+                fprintf(stderr, "Wrong fps %s, %u is used\n", argv[argIdx], DefaultTargetFps);
+            }
+        }
+        else if (!strcmp(argv[argIdx], "--vsync")) {
+            isVsync = true;
+        }
+        else {
+            positional.push_back(argv[argIdx]);
+        }
+    }
+
+    RealWindow mainWindow(MainWindowWidth, MainWindowHeight);
 
     // Initialization of appcontext
     booba::APPCONTEXT = new booba::ApplicationContext(); 
 
-    // Red is a standart color of min example
-    booba::APPCONTEXT->fgColor = 0xFF000000;
+    // Red is a standart color of min example, it is opaque so it is seen on upper layers too
+    booba::APPCONTEXT->fgColor = 0xFF0000FF;
 
     ToolPalette* toolPalette = new ToolPalette(10, 20);
     mainWindow += toolPalette;
-    mainWindow += new Canvas(80, 20, 1500, 800, toolPalette);
+    Canvas* canvas = new Canvas(MainCanvasX, MainCanvasY, MainCanvasWidth, MainCanvasHeight, toolPalette);
+    mainWindow += canvas;
+
+    SetupBar* setupBar = new SetupBar(SetupBarX, MainCanvasY, SetupBarWidth, MainCanvasHeight);
+    setupBar->SetHandler<MethodCaller<Canvas, booba::Event>>(canvas, &Canvas::ApplySetupEvent);
+    mainWindow += setupBar;
+
+    LayerList* layerList = new LayerList(SetupBarX, LayerListY, SetupBarWidth, LayerListHeight, &canvas->layers_);
+    canvas->SetLayerList(layerList);
+    mainWindow += layerList;
+
+    if (!positional.empty()) {
+        uint32_t docWidth  = (positional.size() > 2) ? uint32_t(strtoul(positional[1], nullptr, 10)) : 0;
+        uint32_t docHeight = (positional.size() > 2) ? uint32_t(strtoul(positional[2], nullptr, 10)) : 0;
+
+        if (!canvas->OpenDocument(positional[0], docWidth, docHeight)) {
+            fprintf(stderr, "Unable to open document %s\n", positional[0]);
+        }
+    }
+
+    FrameScheduler scheduler(targetFps, isVsync);
+    mainWindow.SetVerticalSync(isVsync);
+
+    ProfilerOverlay* profilerOverlay = new ProfilerOverlay(MainCanvasX, MainCanvasY + MainCanvasHeight + 5, MainCanvasWidth, 70, scheduler.GetBudgetMs());
+    mainWindow += profilerOverlay;
+
+    EventRecorder recorder;
+    EventReplayer replayer;
+
+    if (recordPath && recorder.Open(recordPath)) {
+        mainWindow.SetRecorder(&recorder);
+    }
+
+    if (replayPath && replayer.Open(replayPath)) {
+        mainWindow.SetReplayer(&replayer, !isFastReplay);
+
+        if (isFastReplay) {
+            scheduler.SetTargetFps(FastReplayFps);
+        }
+    }
 
     while (mainWindow.IsOpen()) {
+        canvas->ReloadPlugins();
+
+        // Editor sleeps while nothing is changing. While plugins are watched, it wakes up every reload delay,
+        // so changed plugin is reloaded without any window event.
+        bool isWaiting = mainWindow.IsIdle() && !PluginManager::GetInstance().HasPendingReload() && !mainWindow.IsReplaying();
+
+        // Frame starts when the event comes, so idle time isn't taken for frame time
+        if (isWaiting) {
+            mainWindow.WaitEvent(PluginManager::GetInstance().IsWatching() ? PluginReloadDelayMs : -1);
+        }
+
+        scheduler.BeginFrame();
+
         mainWindow.Clear();
 
-        mainWindow.PollEvent();
+        // Editor closes when replay is over
+        if (!mainWindow.PollEvent()) {
+            break;
+        }
 
         mainWindow.Display();
+
+        scheduler.EndFrame();
+        Profiler::GetInstance().EndFrame();
     }
 
+    FrameStats stats = scheduler.GetStats();
+    fprintf(stderr, "Frames: %lu, avg %.2lf ms, max %.2lf ms, over %.2lf ms budget: %u of last %u\n",
+            stats.framesTotal, stats.avgMs, stats.maxMs, scheduler.GetBudgetMs(), stats.overBudget, FrameStatsWindow);
+
+    Profiler::GetInstance().PrintReport(stderr);
+
     delete booba::APPCONTEXT;
 }
 
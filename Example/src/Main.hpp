@@ -6,10 +6,31 @@
 #include <unistd.h>
 
 #include <array>
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include "Widget.hpp"
 #include "Window.hpp"
 #include "Button.hpp"
 
 #include "Tools.hpp"
+#include "FrameScheduler.hpp"
+#include "ProfilerOverlay.hpp"
+
+// Layout of main window, bench maps recorded events to canvas with it
+const uint32_t MainCanvasX      = 80;
+const uint32_t MainCanvasY      = 20;
+const uint32_t MainCanvasWidth  = 1500;
+const uint32_t MainCanvasHeight = 800;
+
+// Setup widgets of active tool are to the right of canvas
+const uint32_t SetupBarX        = MainCanvasX + MainCanvasWidth + 10;
+const uint32_t SetupBarWidth    = 250;
+
+// Layers are listed under setup bar
+const uint32_t LayerListY       = MainCanvasY + MainCanvasHeight + 5;
+const uint32_t LayerListHeight  = 70;
+
+const uint32_t MainWindowWidth  = SetupBarX + SetupBarWidth + 10;
+const uint32_t MainWindowHeight = 900;
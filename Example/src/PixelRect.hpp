@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+struct PixelRect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+
+    uint32_t Right() const {
+        return x + width;
+    }
+
+    uint32_t Bottom() const {
+        return y + height;
+    }
+
+    bool IsEmpty() const {
+        return (width == 0) || (height == 0);
+    }
+
+    bool Contains(const PixelRect& rect) const {
+        return (rect.x >= x) && (rect.y >= y) && (rect.Right() <= Right()) && (rect.Bottom() <= Bottom());
+    }
+
+    // Touching rects are also counted, so neighbouring pixels of one stroke merge together
+    bool Touches(const PixelRect& rect) const {
+        return (rect.x <= Right()) && (x <= rect.Right()) && (rect.y <= Bottom()) && (y <= rect.Bottom());
+    }
+
+    PixelRect United(const PixelRect& rect) const {
+        uint32_t newX = std::min(x, rect.x);
+        uint32_t newY = std::min(y, rect.y);
+
+        return {newX, newY, std::max(Right(), rect.Right()) - newX, std::max(Bottom(), rect.Bottom()) - newY};
+    }
+
+    PixelRect Intersected(const PixelRect& rect) const {
+        uint32_t newX = std::max(x, rect.x);
+        uint32_t newY = std::max(y, rect.y);
+
+        uint32_t newRight  = std::min(Right(),  rect.Right());
+        uint32_t newBottom = std::min(Bottom(), rect.Bottom());
+
+        if ((newRight <= newX) || (newBottom <= newY)) {
+            return {newX, newY, 0, 0};
+        }
+
+        return {newX, newY, newRight - newX, newBottom - newY};
+    }
+};
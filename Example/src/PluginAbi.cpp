@@ -0,0 +1,73 @@
+#include "PluginAbi.hpp"
+
+#include <cstring>
+
+booba::Event ConvertToPluginEvent(const Event& event) {
+    booba::Event stEvent;
+    std::memset(&stEvent, 0, sizeof(stEvent));
+
+    stEvent.type = booba::EventType::NoEvent;
+
+    switch (event.type_) {
+        case EventType::MouseMoved:
+            stEvent.type = booba::EventType::MouseMoved;
+
+            stEvent.Oleg.motion.x     = event.Oleg_.motion.x;
+            stEvent.Oleg.motion.y     = event.Oleg_.motion.y;
+            stEvent.Oleg.motion.rel_x = event.Oleg_.motion.rel_x;
+            stEvent.Oleg.motion.rel_y = event.Oleg_.motion.rel_y;
+            break;
+
+        case EventType::MousePressed:
+        case EventType::MouseReleased:
+            stEvent.type = (event.type_ == EventType::MousePressed) ? booba::EventType::MousePressed : booba::EventType::MouseReleased;
+
+            stEvent.Oleg.mbedata.x      = event.Oleg_.mbedata.x;
+            stEvent.Oleg.mbedata.y      = event.Oleg_.mbedata.y;
+            stEvent.Oleg.mbedata.button = (event.Oleg_.mbedata.button == MouseButton::Right) ? booba::MouseButton::Right : booba::MouseButton::Left;
+            stEvent.Oleg.mbedata.shift  = event.Oleg_.mbedata.shift;
+            stEvent.Oleg.mbedata.alt    = event.Oleg_.mbedata.alt;
+            stEvent.Oleg.mbedata.ctrl   = event.Oleg_.mbedata.ctrl;
+            break;
+
+        case EventType::ButtonClicked:
+            stEvent.type = booba::EventType::ButtonClicked;
+
+            stEvent.Oleg.bcedata.id = event.Oleg_.bcedata.id;
+            break;
+
+        case EventType::ScrollbarMoved:
+            stEvent.type = booba::EventType::ScrollbarMoved;
+
+            stEvent.Oleg.smedata.id    = event.Oleg_.smedata.id;
+            stEvent.Oleg.smedata.value = event.Oleg_.smedata.value;
+            break;
+
+        case EventType::CanvasMPressed:
+        case EventType::CanvasMReleased:
+        case EventType::CanvasMMoved:
+            stEvent.type = booba::EventType(uint32_t(event.type_));
+
+            stEvent.Oleg.cedata.id = event.Oleg_.cedata.id;
+            stEvent.Oleg.cedata.x  = event.Oleg_.cedata.x;
+            stEvent.Oleg.cedata.y  = event.Oleg_.cedata.y;
+            break;
+
+        case EventType::StrokeMoved:
+            stEvent.type = booba::EventType::StrokeMoved;
+
+            stEvent.Oleg.stedata.points = reinterpret_cast<const booba::Point*>(event.Oleg_.stedata.points);
+            stEvent.Oleg.stedata.count  = event.Oleg_.stedata.count;
+            break;
+
+        // Plugins don't get these, they stay NoEvent
+        case EventType::NoEvent:
+        case EventType::KeyPressed:
+        case EventType::Closed:
+        case EventType::MouseWheeled:
+        default:
+            break;
+    }
+
+    return stEvent;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../pluginsrc/tools.hpp"
+
+#include "CordsPair.hpp"
+#include "Event.hpp"
+
+const uint32_t LegacyAbiVersion = 1;
+
+const uint64_t KnownAbiCapabilities = booba::AbiRawBuffer | booba::AbiBatchedEvents | booba::AbiTileParallel | booba::AbiAsync;
+
+// What module reported by booba::reportAbi, modules which didn't report are legacy
+struct PluginAbi {
+    uint32_t version;
+    uint64_t capabilities;
+
+    bool Has(uint64_t capability) const {
+        return (capabilities & capability) == capability;
+    }
+
+    bool operator==(const PluginAbi& abi) const {
+        return (version == abi.version) && (capabilities == abi.capabilities);
+    }
+
+    bool operator!=(const PluginAbi& abi) const {
+        return !(*this == abi);
+    }
+};
+
+const PluginAbi LegacyPluginAbi = {LegacyAbiVersion, 0};
+
+// Tools of host are built with the same header
+const PluginAbi HostPluginAbi   = {booba::AbiVersion, KnownAbiCapabilities};
+
+// Path points are given to plugin as they are
+static_assert(sizeof(CordsPair) == sizeof(booba::Point), "CordsPair and booba::Point must have the same layout");
+static_assert(offsetof(CordsPair, x) == offsetof(booba::Point, x), "CordsPair and booba::Point must have the same layout");
+static_assert(offsetof(CordsPair, y) == offsetof(booba::Point, y), "CordsPair and booba::Point must have the same layout");
+
+// Event is copied field by field, so host Event may have other layout and events plugins don't know.
+// Such events become NoEvent.
+booba::Event ConvertToPluginEvent(const Event& event);
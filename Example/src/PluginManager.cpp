@@ -0,0 +1,570 @@
+#include "PluginManager.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include <dlfcn.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "Tools.hpp"
+
+PluginManager::PluginManager() :
+plugins_(),
+capturing_(nullptr),
+dirPath_(),
+manifestPath_(),
+watchFd_(-1),
+changedPaths_(),
+lastChange_(),
+prefetch_(),
+openMutex_(),
+openCondition_(),
+isStopping_(0)
+{}
+
+PluginManager::~PluginManager() {
+    isStopping_ = 1;
+
+    if (prefetch_.joinable()) {
+        prefetch_.join();
+    }
+
+    if (watchFd_ >= 0) {
+        close(watchFd_);
+    }
+}
+
+void PluginManager::LoadAll(const std::string& dirPath) {
+    std::error_code error;
+
+    std::vector<std::filesystem::path> paths;
+
+    for (const auto& curFile : std::filesystem::directory_iterator(dirPath, error)) {
+        std::string fileName = curFile.path().filename().string();
+
+        bool isPlugin = (fileName.size() > sizeof(PluginSuffix) - 1) &&
+                        (fileName.compare(fileName.size() - (sizeof(PluginSuffix) - 1), std::string::npos, PluginSuffix) == 0);
+
+        if (curFile.is_regular_file(error) && isPlugin) {
+            paths.push_back(curFile.path());
+        }
+    }
+
+    if (error) {
+        fprintf(stderr, "Unable to read plugins directory %s: %s\n", dirPath.c_str(), error.message().c_str());
+    }
+
+    // Order of tools in palette shouldn't depend on directory order
+    std::sort(paths.begin(), paths.end());
+
+    for (auto& curPath : paths) {
+        auto newPlugin = std::make_unique<Plugin>();
+
+        newPlugin->path  = curPath.string();
+        newPlugin->mtime = int64_t(std::filesystem::last_write_time(curPath, error).time_since_epoch().count());
+        newPlugin->size  = uint64_t(std::filesystem::file_size(curPath, error));
+
+        newPlugin->state         = LoadState::Queued;
+        newPlugin->handle        = nullptr;
+        newPlugin->isInitialized = 0;
+        newPlugin->isCached      = 0;
+        newPlugin->abi           = LegacyPluginAbi;
+
+        plugins_.push_back(std::move(newPlugin));
+    }
+
+    dirPath_      = dirPath;
+    manifestPath_ = (std::filesystem::path(dirPath) / PluginManifestName).string();
+    ReadManifest();
+
+    bool isManifestChanged = 0;
+
+    for (auto& curPlugin : plugins_) {
+        if (curPlugin->isCached) {
+            for (auto& curInfo : curPlugin->manifest) {
+                curPlugin->proxies.push_back(new LazyTool(curInfo));
+            }
+        }
+        else {
+            Initialize(*curPlugin);
+
+            curPlugin->manifest.clear();
+            for (auto& curTool : curPlugin->tools) {
+                curPlugin->manifest.push_back(curTool.info);
+            }
+
+            isManifestChanged = 1;
+        }
+
+        Register(*curPlugin);
+    }
+
+    if (isManifestChanged) {
+        WriteManifest();
+    }
+
+    prefetch_ = std::thread(&PluginManager::PrefetchLoop, this);
+
+    StartWatching();
+}
+
+void PluginManager::Register(Plugin& plugin) {
+    ToolManager& toolManager = ToolManager::GetInstance();
+
+    if (plugin.isCached) {
+        for (auto& curProxy : plugin.proxies) {
+            if (curProxy->GetInfo().kind == PluginToolKind::TileFilter) {
+                toolManager.AddTileFilter(curProxy, plugin.abi);
+            }
+            else if (curProxy->GetInfo().kind == PluginToolKind::Filter) {
+                toolManager.AddFilter(curProxy, plugin.abi);
+            }
+            else {
+                toolManager.AddTool(curProxy, plugin.abi);
+            }
+        }
+
+        return;
+    }
+
+    for (auto& curTool : plugin.tools) {
+        if (curTool.filter) {
+            toolManager.AddTileFilter(curTool.filter, plugin.abi);
+        }
+        else if (curTool.info.kind == PluginToolKind::Filter) {
+            toolManager.AddFilter(curTool.tool, plugin.abi);
+        }
+        else {
+            toolManager.AddTool(curTool.tool, plugin.abi);
+        }
+    }
+}
+
+void PluginManager::OnAddTool(booba::Tool* tool, booba::Filter* filter, PluginToolKind kind) {
+    if (!capturing_) {
+        if (filter) {
+            ToolManager::GetInstance().AddTileFilter(filter);
+        }
+        else if (kind == PluginToolKind::Filter) {
+            ToolManager::GetInstance().AddFilter(tool);
+        }
+        else {
+            ToolManager::GetInstance().AddTool(tool);
+        }
+
+        return;
+    }
+
+    const char* texture = tool->getTexture();
+
+    capturing_->tools.push_back({tool, filter, {kind, texture ? texture : ""}});
+}
+
+// Event of other size means module was built with other copy of tools.hpp, so it gets only fields of version 1.
+// Capabilities of newer header which host doesn't know are dropped.
+void PluginManager::OnReportAbi(uint32_t version, uint32_t eventSize, uint64_t capabilities) {
+    if (!capturing_) {
+        fprintf(stderr, "reportAbi is called outside of init_module, ignored\n");
+        return;
+    }
+
+    if (version < booba::AbiVersion) {
+        capturing_->abi = LegacyPluginAbi;
+        return;
+    }
+
+    if (eventSize != sizeof(booba::Event)) {
+        fprintf(stderr, "Plugin %s has event of %u bytes instead of %zu, it is loaded as legacy one\n",
+                capturing_->path.c_str(), eventSize, sizeof(booba::Event));
+
+        capturing_->abi = LegacyPluginAbi;
+        return;
+    }
+
+    if (capabilities & ~KnownAbiCapabilities) {
+        fprintf(stderr, "Plugin %s asks for unknown capabilities %#lx, they are ignored\n",
+                capturing_->path.c_str(), capabilities & ~KnownAbiCapabilities);
+    }
+
+    capturing_->abi = {std::min(version, booba::AbiVersion), capabilities & KnownAbiCapabilities};
+}
+
+void PluginManager::Prepare(booba::Tool* tool) {
+    for (auto& curPlugin : plugins_) {
+        if (curPlugin->isInitialized) {
+            continue;
+        }
+
+        for (auto& curProxy : curPlugin->proxies) {
+            if (static_cast<booba::Tool*>(curProxy) == tool) {
+                Initialize(*curPlugin);
+                return;
+            }
+        }
+    }
+}
+
+std::string PluginManager::GetPluginName(const booba::Tool* tool) const {
+    for (auto& curPlugin : plugins_) {
+        bool isOwner = std::any_of(curPlugin->tools.begin(), curPlugin->tools.end(), [tool](const LoadedTool& loaded) {
+            return (loaded.tool == tool) || (static_cast<booba::Tool*>(loaded.filter) == tool);
+        });
+
+        isOwner = isOwner || std::any_of(curPlugin->proxies.begin(), curPlugin->proxies.end(), [tool](const LazyTool* proxy) {
+            return static_cast<const booba::Tool*>(proxy) == tool;
+        });
+
+        if (isOwner) {
+            return std::filesystem::path(curPlugin->path).filename().string();
+        }
+    }
+
+    return {};
+}
+
+// Library is opened once, by background thread or by main one, if it needs plugin earlier
+void* PluginManager::Open(Plugin& plugin) {
+    LoadState expected = LoadState::Queued;
+
+    if (plugin.state.compare_exchange_strong(expected, LoadState::Opening)) {
+        void* handle = dlopen(plugin.path.c_str(), RTLD_LAZY);
+
+        if (!handle) {
+            fprintf(stderr, "Unable to open plugin: %s\n", dlerror());
+        }
+
+        std::lock_guard<std::mutex> lock(openMutex_);
+
+        plugin.handle = handle;
+        plugin.state  = LoadState::Opened;
+
+        openCondition_.notify_all();
+
+        return handle;
+    }
+
+    std::unique_lock<std::mutex> lock(openMutex_);
+    openCondition_.wait(lock, [&plugin]() { return plugin.state == LoadState::Opened; });
+
+    return plugin.handle;
+}
+
+void PluginManager::PrefetchLoop() {
+    for (auto& curPlugin : plugins_) {
+        if (isStopping_) {
+            return;
+        }
+
+        if (curPlugin->state == LoadState::Queued) {
+            Open(*curPlugin);
+        }
+    }
+}
+
+bool PluginManager::Initialize(Plugin& plugin) {
+    if (plugin.isInitialized) {
+        return true;
+    }
+
+    plugin.isInitialized = 1;
+
+    void* handle = Open(plugin);
+
+    if (!handle) {
+        return false;
+    }
+
+    void (*initFunc)()     = nullptr;
+    *((void**)(&initFunc)) = dlsym(handle, "init_module");
+
+    if (!initFunc) {
+        fprintf(stderr, "Plugin %s has no init_module\n", plugin.path.c_str());
+        return false;
+    }
+
+    plugin.abi = LegacyPluginAbi;
+
+    capturing_ = &plugin;
+    (*initFunc)();
+    capturing_ = nullptr;
+
+    if (!plugin.isCached) {
+        return true;
+    }
+
+    // Proxies were registered before plugin could report its ABI
+    for (auto& curProxy : plugin.proxies) {
+        ToolManager::GetInstance().SetToolAbi(curProxy, plugin.abi);
+    }
+
+    // Stale manifest is rewritten at once and plugin is reloaded as changed one, so proxies are replaced by its real tools
+    if (plugin.tools.size() != plugin.proxies.size()) {
+        fprintf(stderr, "Plugin %s doesn't match manifest, it is reloaded\n", plugin.path.c_str());
+
+        plugin.manifest.clear();
+        for (auto& curTool : plugin.tools) {
+            plugin.manifest.push_back(curTool.info);
+        }
+
+        WriteManifest();
+
+        if (std::find(changedPaths_.begin(), changedPaths_.end(), plugin.path) == changedPaths_.end()) {
+            changedPaths_.push_back(plugin.path);
+        }
+
+        lastChange_ = std::chrono::steady_clock::now() - std::chrono::milliseconds(PluginReloadDelayMs);
+    }
+
+    for (size_t toolIdx = 0; toolIdx < std::min(plugin.tools.size(), plugin.proxies.size()); toolIdx++) {
+        plugin.proxies[toolIdx]->SetTool(plugin.tools[toolIdx].tool, plugin.tools[toolIdx].filter);
+    }
+
+    return true;
+}
+
+// Format: header "aboba-manifest <version>", then for every plugin
+// "plugin <mtime> <size> <toolsAmount> <path>" followed by "tool <kind> <texture>" lines
+void PluginManager::ReadManifest() {
+    std::ifstream file(manifestPath_);
+
+    std::string tag;
+    uint32_t version = 0;
+
+    if (!(file >> tag >> version) || (tag != "aboba-manifest") || (version != PluginManifestVersion)) {
+        return;
+    }
+
+    while (file >> tag) {
+        int64_t  mtime  = 0;
+        uint64_t size   = 0;
+        uint32_t amount = 0;
+
+        std::string path;
+
+        if ((tag != "plugin") || !(file >> mtime >> size >> amount) || !std::getline(file >> std::ws, path)) {
+            return;
+        }
+
+        std::vector<PluginToolInfo> tools;
+
+        for (uint32_t toolIdx = 0; toolIdx < amount; toolIdx++) {
+            uint32_t kind = 0;
+            std::string texture;
+
+            if (!(file >> tag >> kind) || (tag != "tool")) {
+                return;
+            }
+
+            file.get();
+            std::getline(file, texture);
+
+            tools.push_back({PluginToolKind(kind), texture});
+        }
+
+        for (auto& curPlugin : plugins_) {
+            if ((curPlugin->path == path) && (curPlugin->mtime == mtime) && (curPlugin->size == size)) {
+                curPlugin->manifest = std::move(tools);
+                curPlugin->isCached = 1;
+
+                break;
+            }
+        }
+    }
+}
+
+void PluginManager::WriteManifest() const {
+    std::ofstream file(manifestPath_, std::ios::trunc);
+
+    if (!file) {
+        return;
+    }
+
+    file << "aboba-manifest " << PluginManifestVersion << '\n';
+
+    for (auto& curPlugin : plugins_) {
+        file << "plugin " << curPlugin->mtime << ' ' << curPlugin->size << ' ' << curPlugin->manifest.size() << ' ' << curPlugin->path << '\n';
+
+        for (auto& curInfo : curPlugin->manifest) {
+            file << "tool " << uint32_t(curInfo.kind) << ' ' << curInfo.texture << '\n';
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Hot reload
+//-----------------------------------------------------------------------------
+
+static bool IsPluginName(const char* name) {
+    std::string fileName = name;
+
+    return (fileName.size() > sizeof(PluginSuffix) - 1) &&
+           (fileName.compare(fileName.size() - (sizeof(PluginSuffix) - 1), std::string::npos, PluginSuffix) == 0);
+}
+
+void PluginManager::StartWatching() {
+    watchFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (watchFd_ < 0) {
+        return;
+    }
+
+    if (inotify_add_watch(watchFd_, dirPath_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+        fprintf(stderr, "Unable to watch plugins directory %s\n", dirPath_.c_str());
+
+        close(watchFd_);
+        watchFd_ = -1;
+    }
+}
+
+void PluginManager::ReadChanges() {
+    if (watchFd_ < 0) {
+        return;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+
+    while (true) {
+        ssize_t readSize = read(watchFd_, buffer, sizeof(buffer));
+
+        if (readSize <= 0) {
+            return;
+        }
+
+        for (ssize_t offset = 0; offset < readSize; ) {
+            const inotify_event* curEvent = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += ssize_t(sizeof(inotify_event) + curEvent->len);
+
+            if ((curEvent->len == 0) || !IsPluginName(curEvent->name)) {
+                continue;
+            }
+
+            std::string path = (std::filesystem::path(dirPath_) / curEvent->name).string();
+
+            if (std::find(changedPaths_.begin(), changedPaths_.end(), path) == changedPaths_.end()) {
+                changedPaths_.push_back(path);
+            }
+
+            lastChange_ = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+bool PluginManager::HasPendingReload() {
+    ReadChanges();
+
+    return !changedPaths_.empty();
+}
+
+bool PluginManager::IsReloadReady() {
+    if (!HasPendingReload()) {
+        return false;
+    }
+
+    return (std::chrono::steady_clock::now() - lastChange_) >= std::chrono::milliseconds(PluginReloadDelayMs);
+}
+
+void PluginManager::Unload(Plugin& plugin, std::vector<booba::Tool*>& removedTools) {
+    ToolManager& toolManager = ToolManager::GetInstance();
+
+    if (plugin.isCached) {
+        for (auto& curProxy : plugin.proxies) {
+            toolManager.RemoveTool(curProxy);
+            removedTools.push_back(curProxy);
+        }
+    }
+    else {
+        for (auto& curTool : plugin.tools) {
+            toolManager.RemoveTool(curTool.tool);
+            removedTools.push_back(curTool.tool);
+        }
+    }
+
+    // Destructors of tools are in library, so they are deleted before it is closed
+    for (auto& curTool : plugin.tools) {
+        delete curTool.tool;
+    }
+
+    for (auto& curProxy : plugin.proxies) {
+        delete curProxy;
+    }
+
+    plugin.tools.clear();
+    plugin.proxies.clear();
+
+    if (plugin.handle) {
+        dlclose(plugin.handle);
+    }
+
+    plugin.handle        = nullptr;
+    plugin.state         = LoadState::Queued;
+    plugin.isInitialized = 0;
+    plugin.isCached      = 0;
+}
+
+uint64_t PluginManager::ReloadChanged(std::vector<booba::Tool*>& removedTools) {
+    // Prefetch walks plugins_, it is finished before the list is changed
+    if (prefetch_.joinable()) {
+        prefetch_.join();
+    }
+
+    std::error_code error;
+    uint64_t addedAmount = 0;
+
+    for (auto& curPath : changedPaths_) {
+        auto found = std::find_if(plugins_.begin(), plugins_.end(), [&curPath](const std::unique_ptr<Plugin>& plugin) {
+            return plugin->path == curPath;
+        });
+
+        if (found != plugins_.end()) {
+            Unload(**found, removedTools);
+        }
+
+        if (!std::filesystem::is_regular_file(curPath, error)) {
+            if (found != plugins_.end()) {
+                plugins_.erase(found);
+            }
+
+            continue;
+        }
+
+        Plugin* plugin = nullptr;
+
+        if (found != plugins_.end()) {
+            plugin = found->get();
+        }
+        else {
+            plugins_.push_back(std::make_unique<Plugin>());
+            plugin = plugins_.back().get();
+
+            plugin->path          = curPath;
+            plugin->state         = LoadState::Queued;
+            plugin->handle        = nullptr;
+            plugin->isInitialized = 0;
+            plugin->isCached      = 0;
+            plugin->abi           = LegacyPluginAbi;
+        }
+
+        plugin->mtime = int64_t(std::filesystem::last_write_time(curPath, error).time_since_epoch().count());
+        plugin->size  = uint64_t(std::filesystem::file_size(curPath, error));
+
+        Initialize(*plugin);
+
+        plugin->manifest.clear();
+        for (auto& curTool : plugin->tools) {
+            plugin->manifest.push_back(curTool.info);
+        }
+
+        Register(*plugin);
+        addedAmount += plugin->tools.size();
+
+        fprintf(stderr, "Plugin %s reloaded, %lu tools\n", curPath.c_str(), plugin->tools.size());
+    }
+
+    changedPaths_.clear();
+    WriteManifest();
+
+    return addedAmount;
+}
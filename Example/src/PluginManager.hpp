@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../pluginsrc/tools.hpp"
+
+#include "PluginAbi.hpp"
+
+const char PluginSuffix[]       = ".aboba.so";
+const char PluginManifestName[] = "manifest.cache";
+
+// Version 2 added kind of addFilter filters
+const uint32_t PluginManifestVersion = 2;
+
+// Compiler writes library in several steps, so plugin is reloaded only after it stays unchanged for a while
+const int64_t PluginReloadDelayMs = 200;
+
+enum class PluginToolKind {
+    Tool       = 0,
+    TileFilter = 1,
+    Filter     = 2,
+};
+
+// What is known about tool without loading its plugin
+struct PluginToolInfo {
+    PluginToolKind kind;
+    std::string texture;
+};
+
+class PluginManager;
+
+// Stands in palette for tool of plugin which isn't initialized yet. Plugin is initialized when tool is selected.
+class LazyTool : public booba::Filter {
+    private:
+        PluginToolInfo info_;
+
+        booba::Tool*   tool_;
+        booba::Filter* filter_;
+
+    public:
+        LazyTool(const PluginToolInfo& info) :
+        info_(info),
+        tool_(nullptr), filter_(nullptr)
+        {}
+
+        LazyTool(const LazyTool& tool)            = delete;
+        LazyTool& operator=(const LazyTool& tool) = delete;
+
+        virtual ~LazyTool() override {}
+
+        void SetTool(booba::Tool* tool, booba::Filter* filter) {
+            tool_   = tool;
+            filter_ = filter;
+        }
+
+        bool IsResolved() const {
+            return tool_;
+        }
+
+        const PluginToolInfo& GetInfo() const {
+            return info_;
+        }
+
+        virtual void apply(booba::Image* image, const booba::Event* event) override {
+            if (tool_) {
+                tool_->apply(image, event);
+            }
+        }
+
+        virtual void applyTile(booba::Image* src, booba::Image* dst, uint32_t x, uint32_t y, uint32_t w, uint32_t h) override {
+            if (filter_) {
+                filter_->applyTile(src, dst, x, y, w, h);
+            }
+        }
+
+        virtual const char* getTexture() override {
+            return info_.texture.c_str();
+        }
+
+        virtual void buildSetupWidget() override {
+            if (tool_) {
+                tool_->buildSetupWidget();
+            }
+        }
+
+        virtual bool supportsAsync() override {
+            return tool_ && tool_->supportsAsync();
+        }
+};
+
+// Loads plugins of directory. Plugins which are in manifest cache with the same mtime and size get
+// LazyTool proxies at once, their libraries are opened by background thread and initialized on first use.
+// Other plugins are loaded at start and added to manifest.
+class PluginManager {
+    private:
+        enum class LoadState {
+            Queued,
+            Opening,
+            Opened,
+        };
+
+        struct LoadedTool {
+            booba::Tool*   tool;
+            booba::Filter* filter;
+            PluginToolInfo info;
+        };
+
+        struct Plugin {
+            std::string path = {};
+            int64_t  mtime   = 0;
+            uint64_t size    = 0;
+
+            std::atomic<LoadState> state = {LoadState::Queued};
+            void* handle = nullptr;
+
+            bool isInitialized = 0;
+            bool isCached      = 0;
+
+            // Legacy until init_module reports other one
+            PluginAbi abi = LegacyPluginAbi;
+
+            std::vector<PluginToolInfo> manifest = {};
+            std::vector<LoadedTool> tools        = {};
+            std::vector<LazyTool*>  proxies      = {};
+        };
+
+        std::vector<std::unique_ptr<Plugin>> plugins_;
+
+        // Plugin which init_module is running, its tools are collected instead of registered
+        Plugin* capturing_;
+
+        std::string dirPath_;
+        std::string manifestPath_;
+
+        // inotify descriptor watching plugins directory, -1 if watching isn't available
+        int watchFd_;
+        std::vector<std::string> changedPaths_;
+        std::chrono::steady_clock::time_point lastChange_;
+
+        std::thread prefetch_;
+        std::mutex openMutex_;
+        std::condition_variable openCondition_;
+        std::atomic<bool> isStopping_;
+
+        PluginManager();
+
+        void ReadManifest();
+        void WriteManifest() const;
+
+        void  PrefetchLoop();
+        void* Open(Plugin& plugin);
+        bool  Initialize(Plugin& plugin);
+
+        void Register(Plugin& plugin);
+        void Unload(Plugin& plugin, std::vector<booba::Tool*>& removedTools);
+
+        void StartWatching();
+        void ReadChanges();
+
+    public:
+        PluginManager(const PluginManager& manager)            = delete;
+        PluginManager& operator=(const PluginManager& manager) = delete;
+
+        ~PluginManager();
+
+        static PluginManager& GetInstance() {
+            static PluginManager instance;
+
+            return instance;
+        }
+
+        void LoadAll(const std::string& dirPath);
+
+        // Called by booba::addTool, addFilter and addTileFilter
+        void OnAddTool(booba::Tool* tool, booba::Filter* filter, PluginToolKind kind);
+
+        // Called by booba::reportAbi, only during init_module
+        void OnReportAbi(uint32_t version, uint32_t eventSize, uint64_t capabilities);
+
+        // Initializes plugin of proxy, if tool is one
+        void Prepare(booba::Tool* tool);
+
+        bool IsWatching() const {
+            return watchFd_ >= 0;
+        }
+
+        // Plugins which files were changed since last reload
+        bool HasPendingReload();
+        bool IsReloadReady();
+
+        // Unregisters and deletes tools of changed plugins, closes and loads them again.
+        // New tools are added to the end of ToolManager, returns their amount
+        uint64_t ReloadChanged(std::vector<booba::Tool*>& removedTools);
+
+        // File name of plugin which added tool, empty for tools of host
+        std::string GetPluginName(const booba::Tool* tool) const;
+
+        uint64_t GetPluginsAmount() const {
+            return plugins_.size();
+        }
+};
@@ -1,3 +1,248 @@
 #include "Primitives.hpp"
 
+#include <cstdlib>
+#include <cstring>
+
+#include "Kernels.hpp"
+#include "Profiler.hpp"
+
 booba::Image::~Image() {}
+booba::Tool::~Tool()   {}
+
+Image::~Image() {
+    std::free(pixels_);
+}
+
+void Image::Allocate(uint32_t width, uint32_t height) {
+    std::free(pixels_);
+
+    width_  = width;
+    height_ = height;
+    stride_ = (width + FramebufferRowAlign - 1) / FramebufferRowAlign * FramebufferRowAlign;
+
+    size_t bytesAmount = std::max(size_t(stride_) * height_ * sizeof(uint32_t), size_t(FramebufferAlignment));
+    pixels_ = static_cast<uint32_t*>(std::aligned_alloc(FramebufferAlignment, bytesAmount));
+
+    assert(pixels_);
+
+    texture_.reset();
+
+    // Everything is new, views of it have to take the whole image again
+    dirty_.Clear();
+    MarkDirty();
+}
+
+void Image::Create(uint32_t width, uint32_t height, const uint8_t* pixels) {
+    Allocate(width, height);
+
+    for (uint32_t curY = 0; curY < height_; curY++) {
+        uint32_t* row = pixels_ + size_t(curY) * stride_;
+
+        SwizzleFromRGBA8(row, pixels + size_t(curY) * width_ * 4, width_);
+        PremultiplyPixels(row, row, width_);
+    }
+}
+
+void Image::Create(uint32_t width, uint32_t height, const MyColor& color) {
+    Allocate(width, height);
+
+    FillPixels(pixels_, size_t(stride_) * height_, color.GetPremultiplied());
+}
+
+bool Image::LoadFromFile(const sf::String& imageName) {
+    sf::Image loadedImage = {};
+
+    if (!loadedImage.loadFromFile(imageName)) {
+        return false;
+    }
+
+    Create(loadedImage.getSize().x, loadedImage.getSize().y, loadedImage.getPixelsPtr());
+
+    return true;
+}
+
+void Image::Clear() {
+    BeforeWrite({0, 0, width_, height_});
+
+    // Padding is cleared too, so the whole buffer is one sequential fill
+    ClearPixels(pixels_, size_t(stride_) * height_);
+
+    MarkDirty();
+}
+
+void Image::UploadDirty() {
+    ScopedTimer timer(ProfilePhase::Upload);
+
+    if (!texture_) {
+        texture_ = std::make_unique<sf::Texture>();
+        texture_->create(width_, height_);
+
+        dirty_.Clear();
+
+        MarkDirty();
+    }
+
+    for (auto& curRect : dirty_.GetRects()) {
+        uploadBuffer_.resize(size_t(curRect.width) * curRect.height * 4);
+
+        for (uint32_t curY = 0; curY < curRect.height; curY++) {
+            SwizzleToRGBA8(uploadBuffer_.data() + size_t(curY) * curRect.width * 4,
+                           pixels_ + (size_t(curRect.y) + curY) * stride_ + curRect.x, curRect.width, UploadAlphaMask);
+        }
+
+        texture_->update(uploadBuffer_.data(), curRect.width, curRect.height, curRect.x, curRect.y);
+    }
+
+    dirty_.Clear();
+}
+
+booba::PixelBuffer Image::lock(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool write) {
+    if (isLocked_ || (x >= width_) || (y >= height_)) {
+        return {nullptr, 0, 0, 0, 0, 0};
+    }
+
+    lockedRect_ = PixelRect({x, y, w, h}).Intersected({0, 0, width_, height_});
+
+    if (write) {
+        BeforeWrite(lockedRect_);
+    }
+
+    isLocked_         = 1;
+    isLockedForWrite_ = write;
+
+    return {pixels_ + size_t(lockedRect_.y) * stride_ + lockedRect_.x, lockedRect_.width, lockedRect_.height, stride_, lockedRect_.x, lockedRect_.y};
+}
+
+void Image::unlock() {
+    if (!isLocked_) {
+        return;
+    }
+
+    isLocked_ = 0;
+
+    if (isLockedForWrite_) {
+        MarkDirty(lockedRect_);
+    }
+}
+
+PixelRect Image::ClipRect(int32_t x, int32_t y, uint32_t w, uint32_t h) const {
+    int64_t left   = std::max(int64_t(x), int64_t(0));
+    int64_t top    = std::max(int64_t(y), int64_t(0));
+    int64_t right  = std::min(int64_t(x) + w, int64_t(width_));
+    int64_t bottom = std::min(int64_t(y) + h, int64_t(height_));
+
+    if ((right <= left) || (bottom <= top)) {
+        return {0, 0, 0, 0};
+    }
+
+    return {uint32_t(left), uint32_t(top), uint32_t(right - left), uint32_t(bottom - top)};
+}
+
+void Image::fillRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) {
+    PixelRect rect = ClipRect(x, y, w, h);
+
+    if (rect.IsEmpty()) {
+        return;
+    }
+
+    BeforeWrite(rect);
+
+    uint32_t premultiplied = MyColor(color).GetPremultiplied();
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++) {
+        FillPixels(pixels_ + size_t(curY) * stride_ + rect.x, rect.width, premultiplied);
+    }
+
+    MarkDirty(rect);
+}
+
+void Image::putSpan(int32_t x, int32_t y, uint32_t w, const uint32_t* colors) {
+    blit(x, y, w, 1, colors, w);
+}
+
+void Image::blit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) {
+    PixelRect rect = ClipRect(x, y, w, h);
+
+    if (rect.IsEmpty()) {
+        return;
+    }
+
+    BeforeWrite(rect);
+
+    const uint32_t* srcRow = pixels + (int64_t(rect.y) - y) * stride + (int64_t(rect.x) - x);
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++, srcRow += stride) {
+        PremultiplyPixels(pixels_ + size_t(curY) * stride_ + rect.x, srcRow, rect.width);
+    }
+
+    MarkDirty(rect);
+}
+
+void Image::BlitPremultiplied(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) {
+    PixelRect rect = ClipRect(x, y, w, h);
+
+    if (rect.IsEmpty()) {
+        return;
+    }
+
+    BeforeWrite(rect);
+
+    const uint32_t* srcRow = pixels + (int64_t(rect.y) - y) * stride + (int64_t(rect.x) - x);
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++, srcRow += stride) {
+        std::memcpy(pixels_ + size_t(curY) * stride_ + rect.x, srcRow, size_t(rect.width) * sizeof(uint32_t));
+    }
+
+    MarkDirty(rect);
+}
+
+void Image::blendRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) {
+    MyColor straight = color;
+
+    if (!straight.alpha_) {
+        return;
+    }
+
+    if (straight.alpha_ == 0xff) {
+        fillRect(x, y, w, h, color);
+        return;
+    }
+
+    PixelRect rect = ClipRect(x, y, w, h);
+
+    if (rect.IsEmpty()) {
+        return;
+    }
+
+    BeforeWrite(rect);
+
+    blendBuffer_.resize(rect.width);
+    FillPixels(blendBuffer_.data(), rect.width, straight.GetPremultiplied());
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++) {
+        BlendPixels(pixels_ + size_t(curY) * stride_ + rect.x, blendBuffer_.data(), rect.width);
+    }
+
+    MarkDirty(rect);
+}
+
+void Image::blendBlit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) {
+    PixelRect rect = ClipRect(x, y, w, h);
+
+    if (rect.IsEmpty()) {
+        return;
+    }
+
+    BeforeWrite(rect);
+
+    blendBuffer_.resize(rect.width);
+
+    const uint32_t* srcRow = pixels + (int64_t(rect.y) - y) * stride + (int64_t(rect.x) - x);
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++, srcRow += stride) {
+        PremultiplyPixels(blendBuffer_.data(), srcRow, rect.width);
+        BlendPixels(pixels_ + size_t(curY) * stride_ + rect.x, blendBuffer_.data(), rect.width);
+    }
+
+    MarkDirty(rect);
+}
@@ -1,12 +1,19 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <array>
 #include <cstdint>
+#include <cassert>
+#include <memory>
+#include <vector>
 
 #include "../pluginsrc/tools.hpp"
 
 #include "CordsPair.hpp"
 #include "Color.hpp"
+#include "DirtyRegion.hpp"
+#include "Event.hpp"
+#include "Surface.hpp"
 
 const double TextScalar = 0.75;
 
@@ -20,33 +27,121 @@ class Rectangle {
 
         float rotation_ = 0;
 
-        void Draw(sf::RenderTexture& widgetContainer, sf::Texture* texture) {
-            sf::Vector2f sizesVec = {float(width_), float(height_)};
-            sf::RectangleShape rect(sizesVec);
+        sf::FloatRect GetRect() const {
+            return {float(x_), float(y_), float(width_), float(height_)};
+        }
+
+        void Draw(Surface& widgetContainer, sf::Texture* texture) {
+            sf::Vector2u textureSize = texture ? texture->getSize() : sf::Vector2u();
+
+            widgetContainer.drawQuad(GetRect(), sf::Color::White, texture, {0, 0, int32_t(textureSize.x), int32_t(textureSize.y)});
+        }
+
+        // Part of texture is stretched over rectangle, used for atlas textures
+        void Draw(Surface& widgetContainer, const sf::Texture* texture, const sf::IntRect& textureRect) {
+            widgetContainer.drawQuad(GetRect(), sf::Color::White, texture, textureRect);
+        }
+
+        void Draw(Surface& widgetContainer, const MyColor& color) {
+            widgetContainer.drawQuad(GetRect(), {color.red_, color.green_, color.blue_, color.alpha_});
+        }
+};
 
-            rect.setPosition({float(x_), float(y_)});
+// Rows of framebuffer start at this boundary, so SIMD kernels can use aligned loads
+const uint32_t FramebufferAlignment = 64;
+const uint32_t FramebufferRowAlign  = FramebufferAlignment / sizeof(uint32_t);
 
-            rect.setTexture(texture);
+// Canvas is shown over black, premultiplied pixels with opaque alpha are exactly that
+const uint8_t UploadAlphaMask = 0xff;
 
-            widgetContainer.draw(rect);
-            widgetContainer.display();
+// Several references of legacy access can be alive at once, e.g. in image(x, y) = image(x + 1, y)
+const uint32_t LegacyPixelsAmount = 4;
+
+// Modules of legacy ABI get straight colors by reference from operator(). Reference points to straight copy
+// of pixel, changed copies are premultiplied back when their slot is reused and on Flush.
+class LegacyPixels {
+    private:
+        struct Slot {
+            uint32_t* pixel;
+
+            uint32_t color;
+            uint32_t loaded;
+        };
+
+        std::array<Slot, LegacyPixelsAmount> slots_;
+        uint32_t next_;
+
+        static void FlushSlot(Slot& slot) {
+            if (slot.pixel && (slot.color != slot.loaded)) {
+                *slot.pixel = MyColor(slot.color).GetPremultiplied();
+            }
+
+            slot.pixel = nullptr;
         }
 
-        void Draw(sf::RenderTexture& widgetContainer, const MyColor& color) {
-            sf::Vector2f sizesVec = {float(width_), float(height_)};
-            sf::RectangleShape rect(sizesVec);
+    public:
+        LegacyPixels() :
+        slots_(),
+        next_(0)
+        {}
+
+        uint32_t& Access(uint32_t* pixel) {
+            Slot& slot = slots_[next_];
+            next_ = (next_ + 1) % LegacyPixelsAmount;
 
-            rect.setPosition({float(x_), float(y_)});
-            rect.setFillColor({color.red_, color.green_, color.blue_});
+            FlushSlot(slot);
 
-            widgetContainer.draw(rect);
-            widgetContainer.display();
+            slot.pixel  = pixel;
+            slot.color  = MyColor::FromPremultiplied(*pixel);
+            slot.loaded = slot.color;
+
+            return slot.color;
+        }
+
+        void Flush() {
+            for (auto& curSlot : slots_) {
+                FlushSlot(curSlot);
+            }
         }
 };
 
 class Image : public booba::Image {
     private:
-        sf::Image realImage_ = {};
+        // Pixels in booba format 0xRRGGBBAA premultiplied by alpha, row y starts at pixels_ + y * stride_
+        uint32_t* pixels_ = nullptr;
+        uint32_t  stride_ = 0;
+
+        // Persistent GPU copy of pixels_, only dirty parts of it are converted and uploaded on Draw.
+        // It is created on the first Draw, so images which are never drawn need no graphics context.
+        std::unique_ptr<sf::Texture> texture_ = nullptr;
+
+        DirtyRegion dirty_ = {};
+        std::vector<sf::Uint8> uploadBuffer_ = {};
+
+        // Premultiplied source row of blendRect and blendBlit
+        std::vector<uint32_t> blendBuffer_ = {};
+
+        PixelRect lockedRect_ = {0, 0, 0, 0};
+
+        bool isLocked_         = 0;
+        bool isLockedForWrite_ = 0;
+
+        // Modules of legacy ABI use operator() without lock, then every such pixel is saved and marked dirty.
+        // They expect straight colors, so they get them through legacyPixels_.
+        bool isLegacyAccess_   = 0;
+        mutable LegacyPixels legacyPixels_ = {};
+
+        // Called before pixels of rect are changed, so their old values can be saved
+        InlineHandler<PixelRect> writeHandler_ = {};
+
+        void BeforeWrite(const PixelRect& rect) {
+            writeHandler_.Call(rect);
+        }
+
+        void Allocate(uint32_t width, uint32_t height);
+        void UploadDirty();
+
+        PixelRect ClipRect(int32_t x, int32_t y, uint32_t w, uint32_t h) const;
 
     public:
         uint32_t width_  = 0;
@@ -58,84 +153,143 @@ class Image : public booba::Image {
             return height_;
         }
 
-        virtual uint32_t getX() override {
+        virtual uint32_t getW() override {
             return width_;
         }
 
+        // Straight copies of legacy access may be changed, so they are put back before pixels are used otherwise
         virtual uint32_t getPixel(int32_t x, int32_t y) override {
+            legacyPixels_.Flush();
+
             return GetPixel(x, y);
         }
 
         virtual void putPixel(uint32_t x, uint32_t y, uint32_t color) override {
+            legacyPixels_.Flush();
+
             SetPixel(x, y, color);
         }
 
-        virtual uint32_t& operator()(uint32_t, uint32_t) override {
-            return width_;
+        virtual uint32_t& operator()(uint32_t x, uint32_t y) override {
+            if (!isLocked_ && isLegacyAccess_) {
+                assert((x < width_) && (y < height_));
+
+                BeforeWrite({x, y, 1, 1});
+                MarkDirty({x, y, 1, 1});
+
+                return legacyPixels_.Access(pixels_ + size_t(y) * stride_ + x);
+            }
+
+            assert(isLocked_ && lockedRect_.Contains({x, y, 1, 1}));
+
+            return pixels_[size_t(y) * stride_ + x];
         }
 
-        virtual const uint32_t& operator()(uint32_t, uint32_t) const override {
-            return height_;
+        virtual const uint32_t& operator()(uint32_t x, uint32_t y) const override {
+            if (!isLocked_) {
+                assert(isLegacyAccess_ && (x < width_) && (y < height_));
+
+                return legacyPixels_.Access(pixels_ + size_t(y) * stride_ + x);
+            }
+
+            assert(lockedRect_.Contains({x, y, 1, 1}));
+
+            return pixels_[size_t(y) * stride_ + x];
         }
 
+        virtual booba::PixelBuffer lock(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool write) override;
+        virtual void unlock() override;
+
+        virtual void fillRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) override;
+        virtual void putSpan(int32_t x, int32_t y, uint32_t w, const uint32_t* colors) override;
+        virtual void blit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) override;
+
+        virtual void blendRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) override;
+        virtual void blendBlit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) override;
+
+        // Host copies of pixels are premultiplied already, so they are copied as is
+        void BlitPremultiplied(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride);
+
         void SetPixel(uint32_t width, uint32_t height, const MyColor& color = 0) {
-            realImage_.setPixel(width, height, {color.red_, color.green_, color.blue_});
+            BeforeWrite({width, height, 1, 1});
+            pixels_[size_t(height) * stride_ + width] = color.GetPremultiplied();
+
+            MarkDirty({width, height, 1, 1});
         }
 
-        uint32_t GetPixel(uint32_t width, uint32_t height) {
-            return (uint32_t(realImage_.getPixel(width, height).r) << 24) + (uint32_t(realImage_.getPixel(width, height).g) << 16) + (uint32_t(realImage_.getPixel(width, height).b) << 8);
+        // Straight color, pixels in buffer are premultiplied
+        uint32_t GetPixel(uint32_t width, uint32_t height) const {
+            return MyColor::FromPremultiplied(pixels_[size_t(height) * stride_ + width]);
         }
 
-        bool LoadFromFile(const sf::String& imageName) {
-            return realImage_.loadFromFile(imageName);
-        }   
+        uint32_t* GetPixels() {
+            return pixels_;
+        }
 
-        Image(uint32_t width, uint32_t height, const MyColor& color = 0) {
-            width_  = width;
-            height_ = height;
+        const uint32_t* GetPixels() const {
+            return pixels_;
+        }
 
-            realImage_.create(width, height, {color.red_, color.green_, color.blue_});
+        uint32_t GetStride() const {
+            return stride_;
         }
-        
-        void Create(uint32_t width, uint32_t height, const uint8_t* pixels) {
-            width_  = width;
-            height_ = height;
 
-            realImage_.create(width, height, pixels);
+        void MarkDirty(const PixelRect& rect) {
+            dirty_.Add(rect.Intersected({0, 0, width_, height_}));
         }
-        
-        void Create(uint32_t width, uint32_t height, const MyColor& color = 0) {
-            width_  = width;
-            height_ = height;
 
-            realImage_.create(width, height, {color.red_, color.green_, color.blue_});
+        void MarkDirty() {
+            MarkDirty({0, 0, width_, height_});
         }
 
-        void Clear() {
-            for (uint32_t curX = 0; curX < width_; curX++) {
-                for (uint32_t curY = 0; curY < height_; curY++) {
-                    realImage_.setPixel(curX, curY, {0, 0, 0});
-                }
-            }
+        bool IsDirty() const {
+            return !dirty_.IsEmpty();
+        }
+
+        const DirtyRegion& GetDirty() const {
+            return dirty_;
         }
 
-        void Draw(sf::RenderTexture& container, const CordsPair& x0y0, const CordsPair& xyVirt, const uint32_t width, const uint32_t height) const {
-            sf::Vector2f sizesVec = {float(width), float(height)};
+        // Forgets changes without uploading them, for images which are never drawn
+        void ClearDirty() {
+            dirty_.Clear();
+        }
+
+        void SetLegacyAccess(bool isLegacyAccess) {
+            legacyPixels_.Flush();
+
+            isLegacyAccess_ = isLegacyAccess;
+        }
 
-            sf::RectangleShape rectangle(sizesVec);
-            rectangle.setPosition({float(x0y0.x), float(x0y0.y)});
+        template <class THandler, class... TArgs>
+        void SetWriteHandler(TArgs&&... args) {
+            writeHandler_.template Emplace<THandler>(std::forward<TArgs>(args)...);
+        }
+
+        bool LoadFromFile(const sf::String& imageName);
+
+        Image(uint32_t width, uint32_t height, const MyColor& color = 0) {
+            Create(width, height, color);
+        }
+
+        Image(const Image& image)            = delete;
+        Image& operator=(const Image& image) = delete;
+
+        ~Image();
+        
+        void Create(uint32_t width, uint32_t height, const uint8_t* pixels);
+        void Create(uint32_t width, uint32_t height, const MyColor& color = 0);
 
-            sf::Texture curTexture = {};
+        void Clear();
 
-            sf::IntRect area = {sf::Vector2i(xyVirt.x, xyVirt.y), sf::Vector2i(width, height)};
-            
-            curTexture.loadFromImage(realImage_, area);
+        void Draw(Surface& container, const CordsPair& x0y0, const CordsPair& xyVirt, const uint32_t width, const uint32_t height) {
+            UploadDirty();
 
-            rectangle.setTexture(&curTexture);
+            sf::RenderStates states;
+            states.transform.translate(float(x0y0.x), float(x0y0.y)).rotate(float((rotation_ / M_PI) * 180.0));
 
-            rectangle.setRotation(float((rotation_ / M_PI) * 180.0));
+            sf::IntRect area = {sf::Vector2i(xyVirt.x, xyVirt.y), sf::Vector2i(int32_t(width), int32_t(height))};
 
-            container.draw(rectangle);
-            container.display();
+            container.drawQuad({0, 0, float(width), float(height)}, sf::Color::White, texture_.get(), area, states);
         }
 };
@@ -0,0 +1,328 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+#include "Allocations.hpp"
+
+static double ToMs(uint64_t nanoseconds) {
+    return double(nanoseconds) / 1e6;
+}
+
+// Plugin names are file names, they may have anything JSON doesn't allow
+static void WriteJsonString(FILE* file, const std::string& str) {
+    fputc('"', file);
+
+    for (auto& curChar : str) {
+        if ((curChar == '"') || (curChar == '\\')) {
+            fputc('\\', file);
+            fputc(curChar, file);
+        }
+        else if (uint8_t(curChar) < 0x20) {
+            fprintf(file, "\\u%04x", uint32_t(curChar));
+        }
+        else {
+            fputc(curChar, file);
+        }
+    }
+
+    fputc('"', file);
+}
+
+Profiler::Profiler() :
+isEnabled_(1),
+mutex_(),
+threadBuffers_(),
+curFrame_(),
+frames_(),
+framesTotal_(0),
+frameAllocations_(),
+lastAllocations_(GetAllocationsTotal()),
+tools_(),
+toolIndices_(),
+spans_(MaxTraceSpans),
+spansTotal_(0),
+startTime_(ProfileClock::now())
+{}
+
+// Only registered tools are counted, so worker threads never ask PluginManager for names
+int32_t Profiler::GetToolIdx(const void* tool) const {
+    auto found = toolIndices_.find(tool);
+
+    return (found != toolIndices_.end()) ? found->second : -1;
+}
+
+void Profiler::RegisterTool(const void* tool, const std::string& pluginName) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    tools_.push_back({pluginName.empty() ? "host" : pluginName, 0, 0, 0});
+    toolIndices_[tool] = int32_t(tools_.size() - 1);
+}
+
+// Buffer is created on the first span of thread and lives as long as profiler, index of thread is its order
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer() {
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+
+    if (!threadBuffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        threadBuffers_.push_back(std::make_unique<ThreadBuffer>(uint32_t(threadBuffers_.size())));
+        threadBuffer = threadBuffers_.back().get();
+    }
+
+    return *threadBuffer;
+}
+
+void Profiler::BeginSpan() {
+    GetThreadBuffer().openTimers.push_back(0);
+}
+
+void Profiler::Record(ProfilePhase phase, const void* tool, ProfileClock::time_point start, ProfileClock::time_point end) {
+    uint64_t duration = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+    ThreadBuffer& buffer = GetThreadBuffer();
+
+    uint64_t nestedNs = 0;
+
+    if (!buffer.openTimers.empty()) {
+        nestedNs = buffer.openTimers.back();
+        buffer.openTimers.pop_back();
+    }
+
+    if (!buffer.openTimers.empty()) {
+        buffer.openTimers.back() += duration;
+    }
+
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+
+    buffer.selfNs[uint32_t(phase)] += duration - std::min(nestedNs, duration);
+
+    // Tool takes the whole time of its apply
+    if (tool) {
+        auto found = std::find_if(buffer.tools.begin(), buffer.tools.end(), [tool](const ThreadTool& threadTool) {
+            return threadTool.tool == tool;
+        });
+
+        if (found == buffer.tools.end()) {
+            buffer.tools.push_back({tool, 0, 0, 0});
+            found = buffer.tools.end() - 1;
+        }
+
+        found->calls++;
+        found->totalNs += duration;
+        found->maxNs    = std::max(found->maxNs, duration);
+    }
+
+    if (buffer.spans.size() < MaxThreadSpans) {
+        buffer.spans.push_back({tool, {phase, -1, buffer.threadIdx, start, end - start}});
+    }
+}
+
+// Tools which aren't registered, or are forgotten already, are counted only in phases
+void Profiler::MergeThreads() {
+    for (auto& curBuffer : threadBuffers_) {
+        std::lock_guard<std::mutex> lock(curBuffer->mutex);
+
+        for (uint32_t phaseIdx = 0; phaseIdx < ProfilePhasesAmount; phaseIdx++) {
+            curFrame_[phaseIdx] += curBuffer->selfNs[phaseIdx];
+            curBuffer->selfNs[phaseIdx] = 0;
+        }
+
+        for (auto& curTool : curBuffer->tools) {
+            int32_t toolIdx = GetToolIdx(curTool.tool);
+
+            if (toolIdx >= 0) {
+                ToolProfile& toolProfile = tools_[size_t(toolIdx)];
+
+                toolProfile.calls   += curTool.calls;
+                toolProfile.totalNs += curTool.totalNs;
+                toolProfile.maxNs    = std::max(toolProfile.maxNs, curTool.maxNs);
+            }
+
+            curTool.calls   = 0;
+            curTool.totalNs = 0;
+            curTool.maxNs   = 0;
+        }
+
+        for (auto& curSpan : curBuffer->spans) {
+            curSpan.span.toolIdx = curSpan.tool ? GetToolIdx(curSpan.tool) : -1;
+
+            spans_[spansTotal_ % MaxTraceSpans] = curSpan.span;
+            spansTotal_++;
+        }
+
+        curBuffer->spans.clear();
+    }
+}
+
+// Spans of tool are merged while its pointer still means it
+void Profiler::ForgetTool(const void* tool) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    MergeThreads();
+
+    for (auto& curBuffer : threadBuffers_) {
+        std::lock_guard<std::mutex> bufferLock(curBuffer->mutex);
+
+        curBuffer->tools.erase(std::remove_if(curBuffer->tools.begin(), curBuffer->tools.end(), [tool](const ThreadTool& threadTool) {
+            return threadTool.tool == tool;
+        }), curBuffer->tools.end());
+    }
+
+    toolIndices_.erase(tool);
+}
+
+void Profiler::EndFrame() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    MergeThreads();
+
+    uint64_t framesTotal = framesTotal_.load(std::memory_order_relaxed);
+
+    for (uint32_t phaseIdx = 0; phaseIdx < ProfilePhasesAmount; phaseIdx++) {
+        frames_[phaseIdx][framesTotal % ProfileFramesWindow] = curFrame_[phaseIdx];
+        curFrame_[phaseIdx] = 0;
+    }
+
+    uint64_t allocations = GetAllocationsTotal();
+
+    frameAllocations_[framesTotal % ProfileFramesWindow] = allocations - lastAllocations_;
+    lastAllocations_ = allocations;
+
+    framesTotal_.store(framesTotal + 1, std::memory_order_relaxed);
+}
+
+void Profiler::GetWindow(ProfileWindow& window) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    uint64_t framesTotal = framesTotal_.load(std::memory_order_relaxed);
+
+    window = {};
+    window.framesAmount = std::min(framesTotal, uint64_t(ProfileFramesWindow));
+
+    for (uint64_t framesAgo = 0; framesAgo < window.framesAmount; framesAgo++) {
+        uint64_t frameIdx = (framesTotal - 1 - framesAgo) % ProfileFramesWindow;
+
+        for (uint32_t phaseIdx = 0; phaseIdx < ProfilePhasesAmount; phaseIdx++) {
+            window.frameMs[phaseIdx][framesAgo] = ToMs(frames_[phaseIdx][frameIdx]);
+        }
+
+        window.allocations[framesAgo] = frameAllocations_[frameIdx];
+    }
+}
+
+ProfileReport Profiler::GetReport() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    ProfileReport report = {};
+    uint64_t framesAmount = std::min(framesTotal_.load(std::memory_order_relaxed), uint64_t(ProfileFramesWindow));
+
+    for (uint32_t phaseIdx = 0; phaseIdx < ProfilePhasesAmount; phaseIdx++) {
+        uint64_t totalNs = 0;
+        uint64_t maxNs   = 0;
+
+        for (uint64_t frameIdx = 0; frameIdx < framesAmount; frameIdx++) {
+            totalNs += frames_[phaseIdx][frameIdx];
+            maxNs    = std::max(maxNs, frames_[phaseIdx][frameIdx]);
+        }
+
+        report.avgMs[phaseIdx] = framesAmount ? ToMs(totalNs) / double(framesAmount) : 0;
+        report.maxMs[phaseIdx] = ToMs(maxNs);
+    }
+
+    uint64_t totalAllocations = 0;
+
+    for (uint64_t frameIdx = 0; frameIdx < framesAmount; frameIdx++) {
+        totalAllocations       += frameAllocations_[frameIdx];
+        report.maxAllocations   = std::max(report.maxAllocations, frameAllocations_[frameIdx]);
+        report.allocatingFrames += frameAllocations_[frameIdx] ? 1 : 0;
+    }
+
+    report.avgAllocations = framesAmount ? double(totalAllocations) / double(framesAmount) : 0;
+    report.framesAmount   = framesAmount;
+
+    return report;
+}
+
+void Profiler::PrintReport(FILE* file) {
+    ProfileReport report = GetReport();
+
+    for (uint32_t phaseIdx = 0; phaseIdx < ProfilePhasesAmount; phaseIdx++) {
+        fprintf(file, "%-14s avg %.3lf ms, max %.3lf ms per frame\n", ProfilePhaseNames[phaseIdx], report.avgMs[phaseIdx], report.maxMs[phaseIdx]);
+    }
+
+    fprintf(file, "%-14s avg %.2lf, max %lu per frame, %lu of last %lu frames allocate\n", "Allocations",
+            report.avgAllocations, report.maxAllocations, report.allocatingFrames, report.framesAmount);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Tools of one plugin are summed, plugins are printed in order of first use
+    std::vector<ToolProfile> plugins;
+
+    for (auto& curTool : tools_) {
+        auto found = std::find_if(plugins.begin(), plugins.end(), [&](const ToolProfile& plugin) {
+            return plugin.plugin == curTool.plugin;
+        });
+
+        if (found == plugins.end()) {
+            plugins.push_back(curTool);
+            continue;
+        }
+
+        found->calls   += curTool.calls;
+        found->totalNs += curTool.totalNs;
+        found->maxNs    = std::max(found->maxNs, curTool.maxNs);
+    }
+
+    for (auto& curPlugin : plugins) {
+        fprintf(file, "Plugin %s: %lu calls, total %.3lf ms, avg %.3lf ms, max %.3lf ms\n", curPlugin.plugin.c_str(), curPlugin.calls,
+                ToMs(curPlugin.totalNs), ToMs(curPlugin.totalNs) / double(std::max(curPlugin.calls, uint64_t(1))), ToMs(curPlugin.maxNs));
+    }
+}
+
+// Spans are written as complete events of Chrome trace format, chrome://tracing and Perfetto open it
+bool Profiler::ExportChromeTrace(const char* path) {
+    std::vector<Span> spans;
+    std::vector<std::string> toolNames;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint64_t firstSpan = (spansTotal_ > MaxTraceSpans) ? (spansTotal_ - MaxTraceSpans) : 0;
+
+        for (uint64_t spanIdx = firstSpan; spanIdx < spansTotal_; spanIdx++) {
+            spans.push_back(spans_[spanIdx % MaxTraceSpans]);
+        }
+
+        for (auto& curTool : tools_) {
+            toolNames.push_back(curTool.plugin);
+        }
+    }
+
+    FILE* file = fopen(path, "w");
+
+    if (!file) {
+        fprintf(stderr, "Unable to write trace %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    for (size_t spanIdx = 0; spanIdx < spans.size(); spanIdx++) {
+        const Span& curSpan = spans[spanIdx];
+
+        double startUs    = std::chrono::duration<double, std::micro>(curSpan.start - startTime_).count();
+        double durationUs = std::chrono::duration<double, std::micro>(curSpan.duration).count();
+
+        fprintf(file, "{\"name\":");
+        WriteJsonString(file, (curSpan.toolIdx >= 0) ? toolNames[curSpan.toolIdx] : ProfilePhaseNames[uint32_t(curSpan.phase)]);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3lf,\"dur\":%.3lf,\"pid\":1,\"tid\":%u}%s\n",
+                ProfilePhaseNames[uint32_t(curSpan.phase)], startUs, durationUs, curSpan.threadIdx, (spanIdx + 1 < spans.size()) ? "," : "");
+    }
+
+    fprintf(file, "]}\n");
+
+    bool isWritten = !ferror(file);
+    fclose(file);
+
+    return isWritten;
+}
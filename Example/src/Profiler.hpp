@@ -0,0 +1,226 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using ProfileClock = std::chrono::steady_clock;
+
+enum class ProfilePhase {
+    Events       = 0,
+    ReDraw       = 1,
+    PlaceTexture = 2,
+    Upload       = 3,
+    ToolApply    = 4,
+
+    Count,
+};
+
+const uint32_t ProfilePhasesAmount = uint32_t(ProfilePhase::Count);
+const char* const ProfilePhaseNames[ProfilePhasesAmount] = {"Events", "ReDraw", "PlaceTexture", "Upload", "ToolApply"};
+
+const uint32_t ProfileFramesWindow = 120;
+// Spans of the last frames which are exported to trace, older ones are overwritten
+const uint32_t MaxTraceSpans = 1 << 16;
+// Spans one thread keeps until frame ends, later ones of the frame are counted but not traced
+const uint32_t MaxThreadSpans = 1 << 12;
+// Depth of nested timers one thread reserves, deeper ones still work, but allocate
+const uint32_t MaxTimersDepth = 32;
+
+const char DefaultTracePath[] = "profile.trace.json";
+
+// Time of one tool, tools of one plugin are summed in report
+struct ToolProfile {
+    std::string plugin;
+
+    uint64_t calls;
+    uint64_t totalNs;
+    uint64_t maxNs;
+};
+
+// The last frames, index in arrays is how many frames ago frame was
+struct ProfileWindow {
+    std::array<std::array<double, ProfileFramesWindow>, ProfilePhasesAmount> frameMs;
+    std::array<uint64_t, ProfileFramesWindow> allocations;
+
+    uint64_t framesAmount;
+};
+
+struct ProfileReport {
+    // Milliseconds, averaged over frames window
+    std::array<double, ProfilePhasesAmount> avgMs;
+    std::array<double, ProfilePhasesAmount> maxMs;
+
+    // Heap allocations per frame over the same window
+    double   avgAllocations;
+    uint64_t maxAllocations;
+    uint64_t allocatingFrames;
+    uint64_t framesAmount;
+};
+
+// Collects time of hot phases, per frame and per tool. Spans can be recorded from any thread.
+// Every thread records into its own buffer, buffers are merged at the end of frame, so timers don't contend.
+// Frame time of phase is self time of its spans, time of nested spans is counted in their own phases.
+class Profiler {
+    private:
+        struct Span {
+            ProfilePhase phase = ProfilePhase::Events;
+            // Index in tools_ for ToolApply, -1 for others
+            int32_t toolIdx    = -1;
+            uint32_t threadIdx = 0;
+
+            ProfileClock::time_point start = {};
+            ProfileClock::duration duration = {};
+        };
+
+        // Tool is resolved to index on merge, so recording thread never touches shared maps
+        struct ThreadSpan {
+            const void* tool;
+            Span span;
+        };
+
+        struct ThreadTool {
+            const void* tool;
+
+            uint64_t calls;
+            uint64_t totalNs;
+            uint64_t maxNs;
+        };
+
+        struct ThreadBuffer {
+            // Taken by its thread for every span and by merge once a frame, so it is almost never waited for
+            std::mutex mutex;
+            uint32_t threadIdx;
+
+            std::array<uint64_t, ProfilePhasesAmount> selfNs;
+            std::vector<ThreadTool> tools;
+            std::vector<ThreadSpan> spans;
+
+            // Time of nested spans of every open timer, only the thread itself touches it
+            std::vector<uint64_t> openTimers;
+
+            explicit ThreadBuffer(uint32_t idx) :
+            mutex(),
+            threadIdx(idx),
+            selfNs(),
+            tools(),
+            spans(),
+            openTimers()
+            {
+                spans.reserve(MaxThreadSpans);
+                openTimers.reserve(MaxTimersDepth);
+            }
+        };
+
+        std::atomic<bool> isEnabled_;
+
+        std::mutex mutex_;
+
+        std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers_;
+
+        std::array<uint64_t, ProfilePhasesAmount> curFrame_;
+        std::array<std::array<uint64_t, ProfileFramesWindow>, ProfilePhasesAmount> frames_;
+        std::atomic<uint64_t> framesTotal_;
+
+        std::array<uint64_t, ProfileFramesWindow> frameAllocations_;
+        uint64_t lastAllocations_;
+
+        // deque keeps indices of spans valid, removed tools stay in report
+        std::deque<ToolProfile> tools_;
+        std::unordered_map<const void*, int32_t> toolIndices_;
+
+        std::vector<Span> spans_;
+        uint64_t spansTotal_;
+
+        ProfileClock::time_point startTime_;
+
+        Profiler();
+
+        ThreadBuffer& GetThreadBuffer();
+
+        int32_t GetToolIdx(const void* tool) const;
+
+        // mutex_ has to be held
+        void MergeThreads();
+
+    public:
+        Profiler(const Profiler& profiler)            = delete;
+        Profiler& operator=(const Profiler& profiler) = delete;
+
+        static Profiler& GetInstance() {
+            static Profiler instance;
+
+            return instance;
+        }
+
+        bool IsEnabled() const {
+            return isEnabled_.load(std::memory_order_relaxed);
+        }
+
+        void SetEnabled(bool isEnabled) {
+            isEnabled_.store(isEnabled, std::memory_order_relaxed);
+        }
+
+        // Every BeginSpan is closed by Record on the same thread
+        void BeginSpan();
+        void Record(ProfilePhase phase, const void* tool, ProfileClock::time_point start, ProfileClock::time_point end);
+
+        // Called on main thread when tool is added, name of plugin is empty for tools of host
+        void RegisterTool(const void* tool, const std::string& pluginName);
+
+        // Tool is going to be deleted, its pointer may be reused by another one
+        void ForgetTool(const void* tool);
+
+        void EndFrame();
+
+        uint64_t GetFramesTotal() const {
+            return framesTotal_.load(std::memory_order_relaxed);
+        }
+
+        void GetWindow(ProfileWindow& window);
+
+        ProfileReport GetReport();
+        void PrintReport(FILE* file);
+
+        bool ExportChromeTrace(const char* path);
+};
+
+// Time from construction to destruction is added to phase
+class ScopedTimer {
+    private:
+        ProfilePhase phase_;
+        const void* tool_;
+
+        bool isActive_;
+        ProfileClock::time_point start_;
+
+    public:
+        ScopedTimer(ProfilePhase phase, const void* tool = nullptr) :
+        phase_(phase),
+        tool_(tool),
+        isActive_(Profiler::GetInstance().IsEnabled()),
+        start_()
+        {
+            if (isActive_) {
+                Profiler::GetInstance().BeginSpan();
+                start_ = ProfileClock::now();
+            }
+        }
+
+        ScopedTimer(const ScopedTimer& timer)            = delete;
+        ScopedTimer& operator=(const ScopedTimer& timer) = delete;
+
+        ~ScopedTimer() {
+            if (isActive_) {
+                Profiler::GetInstance().Record(phase_, tool_, start_, ProfileClock::now());
+            }
+        }
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Window.hpp"
+#include "Profiler.hpp"
+
+const uint32_t ProfilerBackgroundColor = 0x202020ff;
+const uint32_t ProfilerOverBudgetColor = 0xff0000ff;
+const uint32_t ProfilerAllocationColor = 0xffffffff;
+const int64_t  ProfilerAllocationTick  = 2;
+
+const uint32_t ProfilerPhaseColors[ProfilePhasesAmount] = {
+    0x4080ffff,
+    0x40c040ff,
+    0xc0c040ff,
+    0xff8040ff,
+    0xc040ffff,
+};
+
+// Row of bars for every phase, one bar for each of the last frames, the newest is on the right.
+// Full row height is frame budget, phase which took more is drawn red. Frames which allocated on heap
+// have a tick over their column. F12 exports trace.
+class ProfilerOverlay : public Window {
+    private:
+        double budgetMs_;
+        uint64_t drawnFrame_;
+
+        // Copied from profiler once per redraw
+        ProfileWindow window_;
+
+    public:
+        ProfilerOverlay(uint32_t x, uint32_t y, uint32_t width, uint32_t height, double budgetMs) :
+        Window(x, y, width, height),
+        budgetMs_(budgetMs),
+        drawnFrame_(0),
+        window_()
+        {
+            widgetColor_ = ProfilerBackgroundColor;
+        }
+
+        virtual void ReDraw() override {
+            Window::ReDraw();
+
+            Profiler& profiler = Profiler::GetInstance();
+            profiler.GetWindow(window_);
+
+            int64_t rowHeight = GetHeight() / ProfilePhasesAmount;
+            int64_t barWidth  = std::max(GetWidth() / int64_t(ProfileFramesWindow), int64_t(1));
+
+            for (uint32_t phaseIdx = 0; phaseIdx < ProfilePhasesAmount; phaseIdx++) {
+                for (uint32_t framesAgo = 0; framesAgo < ProfileFramesWindow; framesAgo++) {
+                    double frameMs = window_.frameMs[phaseIdx][framesAgo];
+                    int64_t barHeight = std::min(int64_t(double(rowHeight) * frameMs / budgetMs_), rowHeight);
+
+                    if (barHeight <= 0) {
+                        continue;
+                    }
+
+                    Rectangle bar({barWidth - 1, barHeight, GetWidth() - barWidth * (framesAgo + 1), rowHeight * (phaseIdx + 1) - barHeight});
+                    bar.Draw(widgetContainer_, (frameMs > budgetMs_) ? ProfilerOverBudgetColor : ProfilerPhaseColors[phaseIdx]);
+                }
+            }
+
+            for (uint32_t framesAgo = 0; framesAgo < ProfileFramesWindow; framesAgo++) {
+                if (window_.allocations[framesAgo]) {
+                    Rectangle tick({barWidth - 1, ProfilerAllocationTick, GetWidth() - barWidth * (framesAgo + 1), 0});
+                    tick.Draw(widgetContainer_, ProfilerAllocationColor);
+                }
+            }
+
+            drawnFrame_ = profiler.GetFramesTotal();
+        }
+
+        // Overlay is refreshed only in frames which redraw main window anyway,
+        // so changed flag isn't propagated and overlay never keeps editor awake itself
+        virtual void OnTick(const Event& curEvent) override {
+            if (Profiler::GetInstance().GetFramesTotal() != drawnFrame_) {
+                isChanged_ = 1;
+            }
+
+            Window::OnTick(curEvent);
+        }
+
+        virtual void OnKeyboard(const Event& curEvent) override {
+            Window::OnKeyboard(curEvent);
+
+            if (curEvent.Oleg_.kpedata.code == Key::F12) {
+                if (Profiler::GetInstance().ExportChromeTrace(DefaultTracePath)) {
+                    fprintf(stderr, "Trace is written to %s\n", DefaultTracePath);
+                }
+            }
+        }
+};
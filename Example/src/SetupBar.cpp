@@ -0,0 +1,473 @@
+#include "SetupBar.hpp"
+
+#include <cstdio>
+
+const char* const SetupFontPaths[] = {
+    "./Fonts/Font.ttf",
+    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+};
+
+SetupBar* SetupBar::instance_ = nullptr;
+
+// Font is looked for once, without it widgets are drawn without text
+static const sf::Font* GetSetupFont() {
+    static sf::Font font;
+    static int32_t  isLoaded = -1;
+
+    if (isLoaded < 0) {
+        isLoaded = 0;
+
+        for (auto& curPath : SetupFontPaths) {
+            if (font.loadFromFile(curPath)) {
+                isLoaded = 1;
+                break;
+            }
+        }
+
+        if (!isLoaded) {
+            fprintf(stderr, "Unable to load font, setup widgets are drawn without text\n");
+        }
+    }
+
+    return isLoaded ? &font : nullptr;
+}
+
+static void DrawText(Surface& container, const std::string& text, int64_t height, const MyColor& color) {
+    const sf::Font* font = GetSetupFont();
+
+    if (!font || text.empty()) {
+        return;
+    }
+
+    sf::Text sfText(text, *font, uint32_t(double(height) * TextScalar));
+    sfText.setPosition({float(XTextShift), float(YTextShift)});
+    sfText.setFillColor({color.red_, color.green_, color.blue_, color.alpha_});
+
+    container.draw(sfText);
+}
+
+uint64_t booba::createButton(int32_t x, int32_t y, uint32_t w, uint32_t h, const char* text) {
+    SetupBar* bar = SetupBar::GetInstance();
+
+    return bar ? bar->AddButton(x, y, w, h, text) : 0;
+}
+
+uint64_t booba::createLabel(int32_t x, int32_t y, uint32_t w, uint32_t h, const char* text) {
+    SetupBar* bar = SetupBar::GetInstance();
+
+    return bar ? bar->AddLabel(x, y, w, h, text) : 0;
+}
+
+uint64_t booba::createScrollbar(int32_t x, int32_t y, uint32_t w, uint32_t h, int32_t maxValue, int32_t startValue) {
+    SetupBar* bar = SetupBar::GetInstance();
+
+    return bar ? bar->AddScrollbar(x, y, w, h, maxValue, startValue) : 0;
+}
+
+uint64_t booba::createCanvas(int32_t x, int32_t y, int32_t w, int32_t h) {
+    SetupBar* bar = SetupBar::GetInstance();
+
+    return bar ? bar->AddCanvas(x, y, w, h) : 0;
+}
+
+void booba::putPixel(uint64_t canvas, int32_t x, int32_t y, uint32_t color) {
+    SetupBar* bar = SetupBar::GetInstance();
+    ToolCanvas* toolCanvas = bar ? bar->GetCanvas(canvas) : nullptr;
+
+    if (toolCanvas) {
+        toolCanvas->PutPixel(x, y, color);
+    }
+}
+
+void booba::putSprite(uint64_t canvas, int32_t x, int32_t y, uint32_t w, uint32_t h, const char* texture) {
+    SetupBar* bar = SetupBar::GetInstance();
+    ToolCanvas* toolCanvas = bar ? bar->GetCanvas(canvas) : nullptr;
+
+    if (toolCanvas) {
+        toolCanvas->PutSprite(x, y, w, h, texture);
+    }
+}
+
+SetupLabel::SetupLabel(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const char* text) :
+Window(x, y, width, height),
+text_(text ? text : ""),
+textColor_(SetupTextColor)
+{
+    widgetColor_ = SetupPanelColor;
+}
+
+void SetupLabel::SetText(const char* text) {
+    text_ = text ? text : "";
+
+    SetChanged();
+}
+
+void SetupLabel::ReDraw() {
+    Window::ReDraw();
+
+    DrawText(widgetContainer_, text_, GetHeight(), textColor_);
+}
+
+SetupButton::SetupButton(SetupBar* bar, uint64_t id, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const char* text) :
+Button(x, y, width, height),
+bar_(bar), id_(id),
+text_(text ? text : "")
+{
+    SetHandler<MethodCaller<SetupButton, CordsPair>>(this, &SetupButton::Click);
+}
+
+void SetupButton::Click(const CordsPair& cords) {
+    if (!IsClicked(cords)) {
+        return;
+    }
+
+    booba::Event event = {};
+    event.type = booba::EventType::ButtonClicked;
+    event.Oleg.bcedata.id = id_;
+
+    bar_->PostEvent(event);
+}
+
+void SetupButton::ReDraw() {
+    Button::ReDraw();
+
+    DrawText(widgetContainer_, text_, GetHeight(), SetupButtonTextColor);
+}
+
+SetupScrollbar::SetupScrollbar(SetupBar* bar, uint64_t id, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                               int32_t maxValue, int32_t startValue) :
+Window(x, y, width, height),
+bar_(bar), id_(id),
+maxValue_(std::max(maxValue, 0)),
+value_(std::clamp(startValue, 0, std::max(maxValue, 0))),
+isDragging_(0)
+{
+    widgetColor_ = SetupTrackColor;
+}
+
+// Event is sent only when value really changes, so slow previews aren't redrawn for every pixel of drag
+void SetupScrollbar::MoveTo(const CordsPair& cords) {
+    CordsPair localCords = ConvertRealXY(cords);
+
+    int64_t length = std::max(IsVertical() ? GetHeight() : GetWidth(), int64_t(1));
+    int64_t pos    = IsVertical() ? localCords.y : localCords.x;
+
+    int32_t newValue = int32_t(std::clamp(pos * maxValue_ / length, int64_t(0), int64_t(maxValue_)));
+
+    if (newValue == value_) {
+        return;
+    }
+
+    value_ = newValue;
+    SetChanged();
+
+    booba::Event event = {};
+    event.type = booba::EventType::ScrollbarMoved;
+    event.Oleg.smedata.id    = id_;
+    event.Oleg.smedata.value = value_;
+
+    bar_->PostEvent(event);
+}
+
+void SetupScrollbar::OnClick(const Event& curEvent) {
+    Window::OnClick(curEvent);
+
+    CordsPair cords = {curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y};
+
+    if ((curEvent.Oleg_.mbedata.button == MouseButton::Left) && IsClicked(cords)) {
+        isDragging_ = 1;
+        MoveTo(cords);
+    }
+}
+
+void SetupScrollbar::OnMove(const Event& curEvent) {
+    Window::OnMove(curEvent);
+
+    if (isDragging_) {
+        MoveTo({curEvent.Oleg_.motion.x, curEvent.Oleg_.motion.y});
+    }
+}
+
+void SetupScrollbar::OnRelease(const Event& curEvent) {
+    Window::OnRelease(curEvent);
+
+    isDragging_ = 0;
+}
+
+void SetupScrollbar::ReDraw() {
+    Window::ReDraw();
+
+    int64_t length = IsVertical() ? GetHeight() : GetWidth();
+    int64_t thumb  = maxValue_ ? (length - ScrollbarThumbSize) * value_ / maxValue_ : 0;
+
+    if (IsVertical()) {
+        Rectangle({GetWidth(), ScrollbarThumbSize, 0, thumb}).Draw(widgetContainer_, SetupThumbColor);
+    }
+    else {
+        Rectangle({ScrollbarThumbSize, GetHeight(), thumb, 0}).Draw(widgetContainer_, SetupThumbColor);
+    }
+}
+
+ToolCanvas::ToolCanvas(SetupBar* bar, uint64_t id, uint32_t x, uint32_t y, uint32_t width, uint32_t height) :
+Window(x, y, width, height),
+bar_(bar), id_(id),
+image_(width, height),
+sprites_(),
+hasPendingSprites_(0),
+isPressed_(0)
+{
+    sprites_.reserve(MaxCanvasSprites);
+}
+
+// Parents are marked only once per frame, tools put thousands of pixels between frames
+void ToolCanvas::PutPixel(int32_t x, int32_t y, uint32_t color) {
+    if ((x < 0) || (y < 0) || (uint32_t(x) >= image_.width_) || (uint32_t(y) >= image_.height_)) {
+        return;
+    }
+
+    image_.SetPixel(uint32_t(x), uint32_t(y), color);
+
+    if (!IsChanged()) {
+        SetChanged();
+    }
+}
+
+void ToolCanvas::PutSprite(int32_t x, int32_t y, uint32_t w, uint32_t h, const char* texture) {
+    IconHandle icon = IconCache::GetInstance().Request(texture);
+
+    if (icon == InvalidIcon) {
+        return;
+    }
+
+    auto found = std::find_if(sprites_.begin(), sprites_.end(), [x, y, w, h](const CanvasSprite& sprite) {
+        return (sprite.x == x) && (sprite.y == y) && (sprite.w == w) && (sprite.h == h);
+    });
+
+    if (found != sprites_.end()) {
+        found->icon = icon;
+    }
+    else {
+        if (sprites_.size() >= MaxCanvasSprites) {
+            sprites_.erase(sprites_.begin());
+        }
+
+        sprites_.push_back({icon, x, y, w, h});
+    }
+
+    hasPendingSprites_ = 1;
+    SetChanged();
+}
+
+void ToolCanvas::Post(booba::EventType type, const CordsPair& cords) {
+    CordsPair localCords = ConvertRealXY(cords);
+
+    booba::Event event = {};
+    event.type = type;
+    event.Oleg.cedata.id = id_;
+    event.Oleg.cedata.x  = localCords.x;
+    event.Oleg.cedata.y  = localCords.y;
+
+    bar_->PostEvent(event);
+}
+
+void ToolCanvas::OnClick(const Event& curEvent) {
+    Window::OnClick(curEvent);
+
+    CordsPair cords = {curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y};
+
+    if ((curEvent.Oleg_.mbedata.button == MouseButton::Left) && IsClicked(cords)) {
+        isPressed_ = 1;
+        Post(booba::EventType::CanvasMPressed, cords);
+    }
+}
+
+void ToolCanvas::OnMove(const Event& curEvent) {
+    Window::OnMove(curEvent);
+
+    CordsPair cords = {curEvent.Oleg_.motion.x, curEvent.Oleg_.motion.y};
+
+    if (isPressed_ || IsClicked(cords)) {
+        Post(booba::EventType::CanvasMMoved, cords);
+    }
+}
+
+void ToolCanvas::OnRelease(const Event& curEvent) {
+    Window::OnRelease(curEvent);
+
+    if (isPressed_) {
+        isPressed_ = 0;
+        Post(booba::EventType::CanvasMReleased, {curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y});
+    }
+}
+
+// Until sprites are decoded canvas stays changed, as ToolButton does with its icon
+void ToolCanvas::OnTick(const Event& curEvent) {
+    if (hasPendingSprites_) {
+        hasPendingSprites_ = 0;
+
+        for (auto& curSprite : sprites_) {
+            if (!IconCache::GetInstance().IsReady(curSprite.icon)) {
+                hasPendingSprites_ = 1;
+            }
+        }
+
+        SetChanged();
+    }
+
+    Window::OnTick(curEvent);
+}
+
+void ToolCanvas::ReDraw() {
+    image_.Draw(widgetContainer_, {0, 0}, {0, 0}, uint32_t(GetWidth()), uint32_t(GetHeight()));
+
+    IconCache& iconCache = IconCache::GetInstance();
+    sf::IntRect atlasRect;
+
+    for (auto& curSprite : sprites_) {
+        if (iconCache.GetRect(curSprite.icon, atlasRect)) {
+            Rectangle spriteRect({int64_t(curSprite.w), int64_t(curSprite.h), curSprite.x, curSprite.y});
+            spriteRect.Draw(widgetContainer_, &iconCache.GetTexture(), atlasRect);
+        }
+    }
+}
+
+SetupBar::SetupBar(uint32_t x, uint32_t y, uint32_t width, uint32_t height) :
+Window(x, y, width, height),
+panels_(),
+canvases_(),
+building_(nullptr),
+shown_(nullptr),
+nextId_(1),
+handler_()
+{
+    widgetColor_ = SetupPanelColor;
+
+    instance_ = this;
+}
+
+// Shown panel is a child, it is taken back, so only panels_ delete it
+SetupBar::~SetupBar() {
+    Hide();
+
+    if (instance_ == this) {
+        instance_ = nullptr;
+    }
+}
+
+void SetupBar::Hide() {
+    if (shown_) {
+        *this -= shown_;
+        shown_ = nullptr;
+
+        SetChanged();
+    }
+}
+
+void SetupBar::ShowTool(booba::Tool* tool) {
+    Hide();
+
+    if (!tool) {
+        return;
+    }
+
+    auto found = panels_.find(tool);
+
+    if (found == panels_.end()) {
+        Panel& panel = panels_[tool];
+
+        panel.window = std::make_unique<Window>(0, 0, uint32_t(GetWidth()), uint32_t(GetHeight()));
+
+        building_ = &panel;
+        tool->buildSetupWidget();
+        building_ = nullptr;
+
+        found = panels_.find(tool);
+    }
+
+    shown_ = found->second.window.get();
+    *this += shown_;
+
+    SetChanged();
+}
+
+void SetupBar::ForgetTool(booba::Tool* tool) {
+    auto found = panels_.find(tool);
+
+    if (found == panels_.end()) {
+        return;
+    }
+
+    if (shown_ == found->second.window.get()) {
+        Hide();
+    }
+
+    for (auto& curId : found->second.canvasIds) {
+        canvases_.erase(curId);
+    }
+
+    panels_.erase(found);
+}
+
+bool SetupBar::CanPlace(int32_t x, int32_t y, int64_t w, int64_t h, const char* funcName) const {
+    if (!building_) {
+        fprintf(stderr, "%s can be called only from buildSetupWidget\n", funcName);
+        return false;
+    }
+
+    if ((x < 0) || (y < 0) || (w <= 0) || (h <= 0) || (x + w > GetWidth()) || (y + h > GetHeight())) {
+        fprintf(stderr, "%s: widget %lldx%lld at (%d, %d) doesn't fit into %lldx%lld toolbar\n", funcName,
+                (long long)w, (long long)h, x, y, (long long)GetWidth(), (long long)GetHeight());
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t SetupBar::Place(Widget* widget) {
+    *building_->window += widget;
+
+    return nextId_++;
+}
+
+uint64_t SetupBar::AddButton(int32_t x, int32_t y, uint32_t w, uint32_t h, const char* text) {
+    if (!CanPlace(x, y, w, h, "createButton")) {
+        return 0;
+    }
+
+    return Place(new SetupButton(this, nextId_, uint32_t(x), uint32_t(y), w, h, text));
+}
+
+uint64_t SetupBar::AddLabel(int32_t x, int32_t y, uint32_t w, uint32_t h, const char* text) {
+    if (!CanPlace(x, y, w, h, "createLabel")) {
+        return 0;
+    }
+
+    return Place(new SetupLabel(uint32_t(x), uint32_t(y), w, h, text));
+}
+
+uint64_t SetupBar::AddScrollbar(int32_t x, int32_t y, uint32_t w, uint32_t h, int32_t maxValue, int32_t startValue) {
+    if (!CanPlace(x, y, w, h, "createScrollbar")) {
+        return 0;
+    }
+
+    return Place(new SetupScrollbar(this, nextId_, uint32_t(x), uint32_t(y), w, h, maxValue, startValue));
+}
+
+uint64_t SetupBar::AddCanvas(int32_t x, int32_t y, int32_t w, int32_t h) {
+    if (!CanPlace(x, y, w, h, "createCanvas")) {
+        return 0;
+    }
+
+    ToolCanvas* canvas = new ToolCanvas(this, nextId_, uint32_t(x), uint32_t(y), uint32_t(w), uint32_t(h));
+
+    canvases_[nextId_] = canvas;
+    building_->canvasIds.push_back(nextId_);
+
+    return Place(canvas);
+}
+
+ToolCanvas* SetupBar::GetCanvas(uint64_t id) {
+    auto found = canvases_.find(id);
+
+    return (found != canvases_.end()) ? found->second : nullptr;
+}
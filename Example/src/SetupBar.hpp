@@ -0,0 +1,186 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../pluginsrc/tools.hpp"
+
+#include "Window.hpp"
+#include "Button.hpp"
+#include "IconCache.hpp"
+
+const uint32_t SetupPanelColor       = 0xd0d0d0ff;
+const uint32_t SetupTextColor        = 0x000000ff;
+const uint32_t SetupButtonTextColor  = 0xffffffff;
+const uint32_t SetupTrackColor       = 0x404040ff;
+const uint32_t SetupThumbColor       = 0x9400d3ff;
+
+const int64_t  ScrollbarThumbSize    = 8;
+
+// Sprite put at the same rect replaces previous one, the oldest sprites are dropped after that amount
+const uint32_t MaxCanvasSprites      = 64;
+
+class SetupBar;
+
+class SetupLabel : public Window {
+    protected:
+        std::string text_;
+        uint32_t textColor_;
+
+    public:
+        SetupLabel(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const char* text);
+
+        void SetText(const char* text);
+
+        virtual void ReDraw() override;
+};
+
+class SetupButton : public Button {
+    private:
+        SetupBar* bar_;
+        uint64_t  id_;
+
+        std::string text_;
+
+    public:
+        SetupButton(SetupBar* bar, uint64_t id, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const char* text);
+
+        SetupButton(const SetupButton& button)            = delete;
+        SetupButton& operator=(const SetupButton& button) = delete;
+
+        void Click(const CordsPair& cords);
+
+        virtual void ReDraw() override;
+};
+
+// Horizontal if it is wider than high, value goes from 0 to maxValue along it
+class SetupScrollbar : public Window {
+    private:
+        SetupBar* bar_;
+        uint64_t  id_;
+
+        int32_t maxValue_;
+        int32_t value_;
+
+        bool isDragging_;
+
+        bool IsVertical() const {
+            return GetHeight() > GetWidth();
+        }
+
+        void MoveTo(const CordsPair& cords);
+
+    public:
+        SetupScrollbar(SetupBar* bar, uint64_t id, uint32_t x, uint32_t y, uint32_t width, uint32_t height, int32_t maxValue, int32_t startValue);
+
+        SetupScrollbar(const SetupScrollbar& scrollbar)            = delete;
+        SetupScrollbar& operator=(const SetupScrollbar& scrollbar) = delete;
+
+        virtual void OnClick  (const Event& curEvent) override;
+        virtual void OnMove   (const Event& curEvent) override;
+        virtual void OnRelease(const Event& curEvent) override;
+
+        virtual void ReDraw() override;
+};
+
+// Pixels put by tool are kept in image and uploaded once per frame, when canvas is redrawn.
+// Sprites come from icon atlas and are drawn over pixels.
+class ToolCanvas : public Window {
+    private:
+        struct CanvasSprite {
+            IconHandle icon;
+            int32_t x, y;
+            uint32_t w, h;
+        };
+
+        SetupBar* bar_;
+        uint64_t  id_;
+
+        Image image_;
+        std::vector<CanvasSprite> sprites_;
+        bool hasPendingSprites_;
+
+        bool isPressed_;
+
+        void Post(booba::EventType type, const CordsPair& cords);
+
+    public:
+        ToolCanvas(SetupBar* bar, uint64_t id, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+        ToolCanvas(const ToolCanvas& canvas)            = delete;
+        ToolCanvas& operator=(const ToolCanvas& canvas) = delete;
+
+        void PutPixel(int32_t x, int32_t y, uint32_t color);
+        void PutSprite(int32_t x, int32_t y, uint32_t w, uint32_t h, const char* texture);
+
+        virtual void OnClick  (const Event& curEvent) override;
+        virtual void OnMove   (const Event& curEvent) override;
+        virtual void OnRelease(const Event& curEvent) override;
+        virtual void OnTick   (const Event& curEvent) override;
+
+        virtual void ReDraw() override;
+};
+
+// Shows setup widgets of active tool. Panel of tool is built by its buildSetupWidget when tool is selected
+// for the first time, booba::create* functions add widgets to it only then. Events of widgets are given to handler,
+// which applies them to active tool.
+class SetupBar : public Window {
+    private:
+        struct Panel {
+            std::unique_ptr<Window> window  = nullptr;
+            std::vector<uint64_t> canvasIds = {};
+        };
+
+        static SetupBar* instance_;
+
+        std::unordered_map<booba::Tool*, Panel> panels_;
+        std::unordered_map<uint64_t, ToolCanvas*> canvases_;
+
+        Panel*  building_;
+        Window* shown_;
+
+        uint64_t nextId_;
+
+        InlineHandler<booba::Event> handler_;
+
+        bool CanPlace(int32_t x, int32_t y, int64_t w, int64_t h, const char* funcName) const;
+        uint64_t Place(Widget* widget);
+
+        void Hide();
+
+    public:
+        SetupBar(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+        ~SetupBar();
+
+        SetupBar(const SetupBar& bar)            = delete;
+        SetupBar& operator=(const SetupBar& bar) = delete;
+
+        // The only bar of app, nullptr if there is none, e.g. in bench
+        static SetupBar* GetInstance() {
+            return instance_;
+        }
+
+        template <class THandler, class... TArgs>
+        void SetHandler(TArgs&&... args) {
+            handler_.template Emplace<THandler>(std::forward<TArgs>(args)...);
+        }
+
+        void PostEvent(const booba::Event& event) {
+            handler_.Call(event);
+        }
+
+        // Tool may be nullptr, then bar is empty
+        void ShowTool(booba::Tool* tool);
+
+        // Called before tool is deleted, its widgets are deleted too
+        void ForgetTool(booba::Tool* tool);
+
+        uint64_t AddButton   (int32_t x, int32_t y, uint32_t w, uint32_t h, const char* text);
+        uint64_t AddLabel    (int32_t x, int32_t y, uint32_t w, uint32_t h, const char* text);
+        uint64_t AddScrollbar(int32_t x, int32_t y, uint32_t w, uint32_t h, int32_t maxValue, int32_t startValue);
+        uint64_t AddCanvas   (int32_t x, int32_t y, int32_t w, int32_t h);
+
+        ToolCanvas* GetCanvas(uint64_t id);
+};
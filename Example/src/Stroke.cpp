@@ -0,0 +1,55 @@
+#include "Stroke.hpp"
+
+#include <cmath>
+
+StrokeSampler::StrokeSampler(float spacing) :
+points_(),
+spacing_(spacing),
+lastX_(0), lastY_(0),
+travelled_(0),
+isActive_(0)
+{
+    points_.reserve(DefaultStrokeCapacity);
+}
+
+void StrokeSampler::Begin(const CordsPair& start) {
+    points_.clear();
+
+    lastX_ = float(start.x);
+    lastY_ = float(start.y);
+
+    travelled_ = 0;
+    isActive_  = 1;
+}
+
+void StrokeSampler::AddSample(const CordsPair& sample) {
+    if (!isActive_) {
+        return;
+    }
+
+    float dx = float(sample.x) - lastX_;
+    float dy = float(sample.y) - lastY_;
+
+    float length = std::hypot(dx, dy);
+
+    if (!(length > 0)) {
+        return;
+    }
+
+    float dist = spacing_ - travelled_;
+
+    for (; dist <= length; dist += spacing_) {
+        float t = dist / length;
+
+        points_.push_back({int32_t(std::lround(lastX_ + dx * t)), int32_t(std::lround(lastY_ + dy * t))});
+    }
+
+    travelled_ = length - (dist - spacing_);
+
+    lastX_ = float(sample.x);
+    lastY_ = float(sample.y);
+}
+
+void StrokeSampler::End() {
+    isActive_ = 0;
+}
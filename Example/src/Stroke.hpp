@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include "CordsPair.hpp"
+
+// Distance between neighbour points of stroke path, in image pixels
+const float DefaultStrokeSpacing = 2.f;
+
+const size_t DefaultStrokeCapacity = 1024;
+
+// Resamples raw mouse positions of stroke into points with fixed spacing.
+// Distance left after the last point is carried to next samples, so spacing doesn't depend on event rate.
+class StrokeSampler {
+    private:
+        std::vector<CordsPair> points_;
+
+        float spacing_;
+
+        float lastX_;
+        float lastY_;
+
+        // Distance from the last emitted point to the last sample
+        float travelled_;
+
+        bool isActive_;
+
+    public:
+        StrokeSampler(float spacing = DefaultStrokeSpacing);
+
+        void Begin(const CordsPair& start);
+        void AddSample(const CordsPair& sample);
+        void End();
+
+        void ClearPoints() {
+            points_.clear();
+        }
+
+        const std::vector<CordsPair>& GetPoints() const {
+            return points_;
+        }
+
+        bool IsActive() const {
+            return isActive_;
+        }
+
+        void SetSpacing(float spacing) {
+            spacing_ = spacing;
+        }
+};
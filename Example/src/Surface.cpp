@@ -0,0 +1,311 @@
+#include "Surface.hpp"
+
+#include <algorithm>
+
+static uint32_t RoundUp(uint32_t value, uint32_t granule) {
+    return (value + granule - 1) / granule * granule;
+}
+
+// Dedicated textures are allocated with reserve, so growing widgets reuse them
+static uint32_t RoundTextureSide(uint32_t side) {
+    if (side >= 1024) {
+        return RoundUp(side, 256);
+    }
+
+    uint32_t rounded = 64;
+    while (rounded < side) {
+        rounded *= 2;
+    }
+
+    return rounded;
+}
+
+//-----------------------------------------------------------------------------
+// Surface
+//-----------------------------------------------------------------------------
+
+Surface::Surface() :
+target_(nullptr),
+area_(),
+width_(0), height_(0),
+isShared_(0), canShare_(1),
+view_()
+{}
+
+Surface::~Surface() {
+    release();
+}
+
+void Surface::release() {
+    if (!target_) {
+        return;
+    }
+
+    if (isShared_) {
+        SurfacePool::GetInstance().FreeCell(target_, area_);
+    }
+    else {
+        SurfacePool::GetInstance().FreeTexture(target_);
+    }
+
+    target_   = nullptr;
+    isShared_ = 0;
+}
+
+bool Surface::create(uint32_t width, uint32_t height) {
+    // Dedicated texture is kept while new sizes fit into it
+    if (target_ && !isShared_ && (target_->getSize().x >= width) && (target_->getSize().y >= height)) {
+        width_  = width;
+        height_ = height;
+
+        UpdateView();
+        return true;
+    }
+
+    release();
+
+    width_  = width;
+    height_ = height;
+
+    if ((width_ == 0) || (height_ == 0)) {
+        return false;
+    }
+
+    Acquire();
+
+    return target_;
+}
+
+void Surface::Acquire() {
+    SurfacePool& pool = SurfacePool::GetInstance();
+
+    if (canShare_ && (width_ <= MaxAtlasSurfaceSide) && (height_ <= MaxAtlasSurfaceSide)) {
+        target_   = pool.AllocateCell(width_, height_, area_);
+        isShared_ = target_;
+    }
+
+    if (!target_) {
+        target_   = pool.AllocateTexture(width_, height_);
+        isShared_ = 0;
+    }
+
+    UpdateView();
+}
+
+void Surface::makeDedicated() {
+    canShare_ = 0;
+
+    if (isShared_) {
+        release();
+        Acquire();
+    }
+}
+
+// View maps widget coordinates to its area and clips everything outside of it
+void Surface::UpdateView() {
+    if (isShared_) {
+        area_.width  = int32_t(width_);
+        area_.height = int32_t(height_);
+    }
+    else {
+        area_ = {0, 0, int32_t(width_), int32_t(height_)};
+    }
+
+    if (!target_) {
+        return;
+    }
+
+    float targetWidth  = float(target_->getSize().x);
+    float targetHeight = float(target_->getSize().y);
+
+    view_.reset({0, 0, float(width_), float(height_)});
+    view_.setViewport({float(area_.left) / targetWidth, float(area_.top) / targetHeight, float(width_) / targetWidth, float(height_) / targetHeight});
+}
+
+void Surface::clear(const sf::Color& color) {
+    if (!target_) {
+        return;
+    }
+
+    if (!isShared_) {
+        target_->clear(color);
+        return;
+    }
+
+    // Clear of target would wipe neighbours, so only own area is overwritten
+    drawQuad({0, 0, float(width_), float(height_)}, color, nullptr, {}, sf::RenderStates(sf::BlendNone));
+}
+
+void Surface::draw(const sf::Drawable& drawable, const sf::RenderStates& states) {
+    if (!target_) {
+        return;
+    }
+
+    target_->setView(view_);
+    target_->draw(drawable, states);
+}
+
+void Surface::draw(const sf::Vertex* vertices, size_t count, sf::PrimitiveType type, const sf::RenderStates& states) {
+    if (!target_) {
+        return;
+    }
+
+    target_->setView(view_);
+    target_->draw(vertices, count, type, states);
+}
+
+void Surface::drawQuad(const sf::FloatRect& rect, const sf::Color& color, const sf::Texture* texture,
+                       const sf::IntRect& textureRect, const sf::RenderStates& states) {
+    float right  = rect.left + rect.width;
+    float bottom = rect.top  + rect.height;
+
+    float texLeft   = float(textureRect.left);
+    float texTop    = float(textureRect.top);
+    float texRight  = float(textureRect.left + textureRect.width);
+    float texBottom = float(textureRect.top  + textureRect.height);
+
+    sf::Vertex quad[4] = {
+        sf::Vertex({rect.left, rect.top}, color, {texLeft,  texTop}),
+        sf::Vertex({right,     rect.top}, color, {texRight, texTop}),
+        sf::Vertex({rect.left, bottom},   color, {texLeft,  texBottom}),
+        sf::Vertex({right,     bottom},   color, {texRight, texBottom})
+    };
+
+    sf::RenderStates quadStates = states;
+    quadStates.texture = texture;
+
+    draw(quad, 4, sf::TriangleStrip, quadStates);
+}
+
+void Surface::display() {
+    if (target_) {
+        target_->display();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// SurfacePool
+//-----------------------------------------------------------------------------
+
+SurfacePool::SurfacePool() :
+pages_(),
+freeCells_(),
+freeTextures_(),
+usedTextures_()
+{}
+
+// Shelf packing: cells are put in rows, each row is as high as the first cell in it
+bool SurfacePool::AllocateInPage(Page& page, uint32_t width, uint32_t height, sf::IntRect& area) {
+    for (auto& curShelf : page.shelves) {
+        if ((curShelf.height >= height) && (curShelf.height <= height * 2) && (curShelf.usedWidth + width <= AtlasPageSize)) {
+            area = {int32_t(curShelf.usedWidth), int32_t(curShelf.y), int32_t(width), int32_t(height)};
+            curShelf.usedWidth += width;
+
+            return true;
+        }
+    }
+
+    if (page.usedHeight + height > AtlasPageSize) {
+        return false;
+    }
+
+    page.shelves.push_back({page.usedHeight, height, width});
+    area = {0, int32_t(page.usedHeight), int32_t(width), int32_t(height)};
+
+    page.usedHeight += height;
+
+    return true;
+}
+
+sf::RenderTexture* SurfacePool::AllocateCell(uint32_t width, uint32_t height, sf::IntRect& area) {
+    uint32_t cellWidth  = RoundUp(width,  AtlasCellGranule);
+    uint32_t cellHeight = RoundUp(height, AtlasCellGranule);
+
+    for (auto it = freeCells_.begin(); it != freeCells_.end(); it++) {
+        if ((uint32_t(it->area.width) == cellWidth) && (uint32_t(it->area.height) == cellHeight)) {
+            sf::RenderTexture* page = it->page;
+            area = it->area;
+
+            freeCells_.erase(it);
+            return page;
+        }
+    }
+
+    for (auto& curPage : pages_) {
+        if (AllocateInPage(curPage, cellWidth, cellHeight, area)) {
+            return curPage.texture.get();
+        }
+    }
+
+    Page newPage = {std::make_unique<sf::RenderTexture>(), {}, 0};
+
+    if (!newPage.texture->create(AtlasPageSize, AtlasPageSize)) {
+        return nullptr;
+    }
+
+    pages_.push_back(std::move(newPage));
+
+    if (!AllocateInPage(pages_.back(), cellWidth, cellHeight, area)) {
+        return nullptr;
+    }
+
+    return pages_.back().texture.get();
+}
+
+void SurfacePool::FreeCell(sf::RenderTexture* page, const sf::IntRect& area) {
+    sf::IntRect cell = {area.left, area.top, int32_t(RoundUp(uint32_t(area.width),  AtlasCellGranule)),
+                                             int32_t(RoundUp(uint32_t(area.height), AtlasCellGranule))};
+
+    freeCells_.push_back({page, cell});
+}
+
+sf::RenderTexture* SurfacePool::AllocateTexture(uint32_t width, uint32_t height) {
+    // The smallest free texture which isn't much bigger than needed
+    auto bestIt = freeTextures_.end();
+
+    for (auto it = freeTextures_.begin(); it != freeTextures_.end(); it++) {
+        sf::Vector2u size = (*it)->getSize();
+
+        if ((size.x < width) || (size.y < height) || (uint64_t(size.x) * size.y > uint64_t(width) * height * 4)) {
+            continue;
+        }
+
+        if ((bestIt == freeTextures_.end()) || (uint64_t(size.x) * size.y < uint64_t((*bestIt)->getSize().x) * (*bestIt)->getSize().y)) {
+            bestIt = it;
+        }
+    }
+
+    if (bestIt != freeTextures_.end()) {
+        usedTextures_.push_back(std::move(*bestIt));
+        freeTextures_.erase(bestIt);
+
+        return usedTextures_.back().get();
+    }
+
+    auto newTexture = std::make_unique<sf::RenderTexture>();
+
+    uint32_t maxSide = sf::Texture::getMaximumSize();
+
+    if (!newTexture->create(std::min(RoundTextureSide(width), maxSide), std::min(RoundTextureSide(height), maxSide))) {
+        return nullptr;
+    }
+
+    usedTextures_.push_back(std::move(newTexture));
+
+    return usedTextures_.back().get();
+}
+
+void SurfacePool::FreeTexture(sf::RenderTexture* texture) {
+    for (auto it = usedTextures_.begin(); it != usedTextures_.end(); it++) {
+        if (it->get() != texture) {
+            continue;
+        }
+
+        if (freeTextures_.size() < MaxPooledTextures) {
+            freeTextures_.push_back(std::move(*it));
+        }
+
+        usedTextures_.erase(it);
+        return;
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <memory>
+#include <vector>
+
+const uint32_t AtlasPageSize      = 2048;
+const uint32_t MaxAtlasSurfaceSide = 256;
+const uint32_t AtlasCellGranule   = 16;
+
+// Released dedicated textures kept for reuse
+const uint32_t MaxPooledTextures  = 8;
+
+// Drawing area of widget. Small surfaces are parts of shared atlas pages, big ones have own pooled texture.
+// Interface repeats used part of sf::RenderTexture.
+class Surface {
+    private:
+        sf::RenderTexture* target_;
+        sf::IntRect area_;
+
+        uint32_t width_;
+        uint32_t height_;
+
+        bool isShared_;
+        bool canShare_;
+
+        sf::View view_;
+
+        void Acquire();
+        void UpdateView();
+
+    public:
+        Surface();
+        ~Surface();
+
+        Surface(const Surface& surface)            = delete;
+        Surface& operator=(const Surface& surface) = delete;
+
+        bool create(uint32_t width, uint32_t height);
+        void release();
+
+        // Surfaces which get children drawn into them can't lay in atlas, children may be in the same page
+        void makeDedicated();
+
+        void clear(const sf::Color& color = sf::Color(0, 0, 0, 255));
+        void draw(const sf::Drawable& drawable, const sf::RenderStates& states = sf::RenderStates::Default);
+        void draw(const sf::Vertex* vertices, size_t count, sf::PrimitiveType type, const sf::RenderStates& states = sf::RenderStates::Default);
+
+        // Rect filled with color, texture part is stretched over it if texture is given.
+        // Vertices are on stack, sf::RectangleShape would allocate them on every draw.
+        void drawQuad(const sf::FloatRect& rect, const sf::Color& color, const sf::Texture* texture = nullptr,
+                      const sf::IntRect& textureRect = {}, const sf::RenderStates& states = sf::RenderStates::Default);
+        void display();
+
+        const sf::Texture& getTexture() const {
+            return target_->getTexture();
+        }
+
+        const sf::IntRect& getTextureRect() const {
+            return area_;
+        }
+
+        bool isCreated() const {
+            return target_;
+        }
+
+        bool isShared() const {
+            return isShared_;
+        }
+};
+
+class SurfacePool {
+    private:
+        struct Shelf {
+            uint32_t y;
+            uint32_t height;
+            uint32_t usedWidth;
+        };
+
+        struct Page {
+            std::unique_ptr<sf::RenderTexture> texture;
+            std::vector<Shelf> shelves;
+            uint32_t usedHeight;
+        };
+
+        struct FreeCell {
+            sf::RenderTexture* page;
+            sf::IntRect area;
+        };
+
+        std::vector<Page>     pages_;
+        std::vector<FreeCell> freeCells_;
+
+        std::vector<std::unique_ptr<sf::RenderTexture>> freeTextures_;
+        std::vector<std::unique_ptr<sf::RenderTexture>> usedTextures_;
+
+        SurfacePool();
+
+        bool AllocateInPage(Page& page, uint32_t width, uint32_t height, sf::IntRect& area);
+
+    public:
+        SurfacePool(const SurfacePool& pool)            = delete;
+        SurfacePool& operator=(const SurfacePool& pool) = delete;
+
+        static SurfacePool& GetInstance() {
+            static SurfacePool instance;
+
+            return instance;
+        }
+
+        sf::RenderTexture* AllocateCell(uint32_t width, uint32_t height, sf::IntRect& area);
+        void FreeCell(sf::RenderTexture* page, const sf::IntRect& area);
+
+        sf::RenderTexture* AllocateTexture(uint32_t width, uint32_t height);
+        void FreeTexture(sf::RenderTexture* texture);
+
+        uint64_t GetPagesAmount() const {
+            return pages_.size();
+        }
+
+        uint64_t GetTexturesAmount() const {
+            return usedTextures_.size() + freeTextures_.size();
+        }
+};
@@ -0,0 +1,473 @@
+#include "TileCache.hpp"
+
+#include <cmath>
+
+#include "Kernels.hpp"
+#include "Profiler.hpp"
+
+// Every channel of destination is rounded mean of 2x2 block, blocks at odd edges repeat the last pixel
+static void DownsampleRow(uint32_t* dst, const uint32_t* srcRow0, const uint32_t* srcRow1,
+                          uint32_t dstX, uint32_t count, uint32_t srcWidth) {
+    for (uint32_t curX = dstX; curX < dstX + count; curX++) {
+        uint32_t srcX0 = 2 * curX;
+        uint32_t srcX1 = std::min(srcX0 + 1, srcWidth - 1);
+
+        uint32_t block[4] = {srcRow0[srcX0], srcRow0[srcX1], srcRow1[srcX0], srcRow1[srcX1]};
+        uint32_t result = 0;
+
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            uint32_t sum = 2;
+
+            for (auto& curPixel : block) {
+                sum += (curPixel >> shift) & 0xff;
+            }
+
+            result |= (sum >> 2) << shift;
+        }
+
+        dst[curX] = result;
+    }
+}
+
+// Tile of document mip level is made of whole pieces
+static_assert(ViewTileSize == DocumentTileSize, "View tiles and document tiles have to be the same");
+
+TileCache::TileCache() :
+levels_(),
+tiles_(),
+document_(nullptr),
+originX_(0),
+originY_(0),
+pieces_(),
+pieceBytes_(0),
+pieceBuffers_(),
+uploadBuffer_(),
+evictBuffer_(),
+frame_(0)
+{}
+
+TileCache::~TileCache() {}
+
+uint32_t TileCache::GetLevelSize(uint32_t size, uint32_t level) {
+    for (uint32_t curLevel = 0; curLevel < level; curLevel++) {
+        size = std::max((size + 1) / 2, 1u);
+    }
+
+    return size;
+}
+
+void TileCache::SetDocument(const TiledDocument* document, uint32_t originX, uint32_t originY) {
+    originX_ = originX;
+    originY_ = originY;
+
+    if (document == document_) {
+        return;
+    }
+
+    document_ = document;
+
+    pieces_.clear();
+    pieceBytes_ = 0;
+
+    for (auto it = tiles_.begin(); it != tiles_.end();) {
+        it = (it->first >> 63) ? tiles_.erase(it) : std::next(it);
+    }
+}
+
+void TileCache::Reset(uint32_t width, uint32_t height) {
+    levels_.clear();
+    tiles_.clear();
+
+    for (uint32_t curLevel = 0; curLevel <= MaxViewMipLevel; curLevel++) {
+        levels_.push_back({width, height, {}, {}});
+
+        if (curLevel) {
+            levels_.back().pixels.resize(size_t(width) * height);
+            levels_.back().stale.Add({0, 0, width, height});
+        }
+
+        width  = std::max((width  + 1) / 2, 1u);
+        height = std::max((height + 1) / 2, 1u);
+    }
+}
+
+void TileCache::Invalidate(const PixelRect& rect) {
+    for (uint32_t curLevel = 0; curLevel <= MaxViewMipLevel; curLevel++) {
+        Level& level = levels_[curLevel];
+
+        uint32_t mask   = (1u << curLevel) - 1;
+        uint32_t left   = rect.x >> curLevel;
+        uint32_t top    = rect.y >> curLevel;
+        uint32_t right  = std::min((rect.Right()  + mask) >> curLevel, level.width);
+        uint32_t bottom = std::min((rect.Bottom() + mask) >> curLevel, level.height);
+
+        if ((right <= left) || (bottom <= top)) {
+            continue;
+        }
+
+        if (curLevel) {
+            level.stale.Add({left, top, right - left, bottom - top});
+        }
+
+        for (uint32_t tileY = top / ViewTileSize; tileY * ViewTileSize < bottom; tileY++) {
+            for (uint32_t tileX = left / ViewTileSize; tileX * ViewTileSize < right; tileX++) {
+                auto found = tiles_.find(GetTileKey(curLevel, tileX, tileY));
+
+                if (found == tiles_.end()) {
+                    continue;
+                }
+
+                if (curLevel) {
+                    found->second.isValid = 0;
+                }
+                else {
+                    found->second.dirty.Add(PixelRect({left, top, right - left, bottom - top})
+                                            .Intersected({tileX * ViewTileSize, tileY * ViewTileSize, ViewTileSize, ViewTileSize}));
+                }
+            }
+        }
+    }
+}
+
+void TileCache::Update(Image& image) {
+    if (levels_.empty() || (levels_[0].width != image.width_) || (levels_[0].height != image.height_)) {
+        Reset(image.width_, image.height_);
+    }
+
+    for (auto& curRect : image.GetDirty().GetRects()) {
+        Invalidate(curRect);
+    }
+
+    image.ClearDirty();
+}
+
+const uint32_t* TileCache::GetLevelPixels(uint32_t level, const Image& image, uint32_t& stride) const {
+    if (!level) {
+        stride = image.GetStride();
+        return image.GetPixels();
+    }
+
+    stride = levels_[level].width;
+    return levels_[level].pixels.data();
+}
+
+// Previous level has to be up to date
+void TileCache::BuildLevel(uint32_t level, const Image& image) {
+    Level& curLevel = levels_[level];
+
+    uint32_t srcStride = 0;
+    const uint32_t* srcPixels = GetLevelPixels(level - 1, image, srcStride);
+
+    uint32_t srcWidth  = levels_[level - 1].width;
+    uint32_t srcHeight = levels_[level - 1].height;
+
+    for (auto& curRect : curLevel.stale.GetRects()) {
+        for (uint32_t curY = curRect.y; curY < curRect.Bottom(); curY++) {
+            const uint32_t* srcRow0 = srcPixels + size_t(2 * curY) * srcStride;
+            const uint32_t* srcRow1 = srcPixels + size_t(std::min(2 * curY + 1, srcHeight - 1)) * srcStride;
+
+            DownsampleRow(curLevel.pixels.data() + size_t(curY) * curLevel.width, srcRow0, srcRow1, curRect.x, curRect.width, srcWidth);
+        }
+    }
+
+    curLevel.stale.Clear();
+}
+
+// Rect is in pixels of level and lies inside tile
+void TileCache::UploadRect(Tile& tile, uint32_t level, const PixelRect& rect, uint32_t tileX, uint32_t tileY, const Image& image) {
+    uint32_t stride = 0;
+    const uint32_t* pixels = GetLevelPixels(level, image, stride);
+
+    uploadBuffer_.resize(size_t(rect.width) * rect.height * 4);
+
+    for (uint32_t curY = 0; curY < rect.height; curY++) {
+        SwizzleToRGBA8(uploadBuffer_.data() + size_t(curY) * rect.width * 4,
+                       pixels + size_t(rect.y + curY) * stride + rect.x, rect.width, UploadAlphaMask);
+    }
+
+    tile.texture.update(uploadBuffer_.data(), rect.width, rect.height, rect.x - tileX * ViewTileSize, rect.y - tileY * ViewTileSize);
+}
+
+TileCache::Tile& TileCache::GetTile(uint32_t level, uint32_t tileX, uint32_t tileY, const Image& image) {
+    Tile& tile = tiles_[GetTileKey(level, tileX, tileY)];
+    tile.lastUsedFrame = frame_;
+
+    if (tile.isValid && tile.dirty.IsEmpty()) {
+        return tile;
+    }
+
+    ScopedTimer timer(ProfilePhase::Upload);
+
+    if (tile.isValid) {
+        for (auto& curRect : tile.dirty.GetRects()) {
+            UploadRect(tile, level, curRect, tileX, tileY, image);
+        }
+
+        tile.dirty.Clear();
+        return tile;
+    }
+
+    const Level& curLevel = levels_[level];
+
+    uint32_t x = tileX * ViewTileSize;
+    uint32_t y = tileY * ViewTileSize;
+    uint32_t width  = std::min(ViewTileSize, curLevel.width  - x);
+    uint32_t height = std::min(ViewTileSize, curLevel.height - y);
+
+    if ((tile.texture.getSize().x != width) || (tile.texture.getSize().y != height)) {
+        tile.texture.create(width, height);
+    }
+
+    UploadRect(tile, level, {x, y, width, height}, tileX, tileY, image);
+
+    tile.isValid = 1;
+    tile.dirty.Clear();
+
+    return tile;
+}
+
+// Tiles drawn in this frame are kept even if there are more of them than limit
+void TileCache::Evict() {
+    if (tiles_.size() <= MaxCachedTiles) {
+        return;
+    }
+
+    evictBuffer_.clear();
+
+    for (auto& curTile : tiles_) {
+        if (curTile.second.lastUsedFrame != frame_) {
+            evictBuffer_.push_back({curTile.second.lastUsedFrame, curTile.first});
+        }
+    }
+
+    std::sort(evictBuffer_.begin(), evictBuffer_.end());
+
+    for (auto it = evictBuffer_.begin(); (it != evictBuffer_.end()) && (tiles_.size() > MaxCachedTiles); it++) {
+        tiles_.erase(it->second);
+    }
+}
+
+// Piece is downscaled from the nearest level of it which is up to date, or from tile of document itself
+const TileCache::Piece& TileCache::GetPiece(uint32_t level, uint32_t tileX, uint32_t tileY) {
+    PixelRect rect = PixelRect({tileX * DocumentTileSize, tileY * DocumentTileSize, DocumentTileSize, DocumentTileSize})
+                     .Intersected({0, 0, document_->GetWidth(), document_->GetHeight()});
+    uint64_t version = document_->GetVersion(rect);
+
+    Piece& piece = pieces_[GetTileKey(level, tileX, tileY)];
+    piece.lastUsedFrame = frame_;
+
+    if (!piece.pixels.empty() && (piece.version == version)) {
+        return piece;
+    }
+
+    const uint32_t* srcPixels = nullptr;
+    uint32_t srcLevel  = 0;
+    uint32_t srcWidth  = rect.width;
+    uint32_t srcHeight = rect.height;
+
+    for (uint32_t curLevel = level - 1; curLevel > 0; curLevel--) {
+        auto found = pieces_.find(GetTileKey(curLevel, tileX, tileY));
+
+        if ((found != pieces_.end()) && !found->second.pixels.empty() && (found->second.version == version)) {
+            srcPixels = found->second.pixels.data();
+            srcLevel  = curLevel;
+            srcWidth  = found->second.width;
+            srcHeight = found->second.height;
+
+            break;
+        }
+    }
+
+    if (!srcPixels) {
+        pieceBuffers_[0].resize(size_t(rect.width) * rect.height);
+        document_->ReadRect(rect, pieceBuffers_[0].data(), rect.width);
+
+        srcPixels = pieceBuffers_[0].data();
+    }
+
+    pieceBytes_ -= piece.pixels.size() * sizeof(uint32_t);
+
+    for (uint32_t curLevel = srcLevel + 1; curLevel <= level; curLevel++) {
+        uint32_t width  = (srcWidth  + 1) / 2;
+        uint32_t height = (srcHeight + 1) / 2;
+
+        // Intermediate levels alternate between buffers, source of the first one may be in buffer 0
+        std::vector<uint32_t>& dst = (curLevel == level) ? piece.pixels : pieceBuffers_[(curLevel - srcLevel) % 2];
+        dst.resize(size_t(width) * height);
+
+        for (uint32_t curY = 0; curY < height; curY++) {
+            DownsampleRow(dst.data() + size_t(curY) * width, srcPixels + size_t(2 * curY) * srcWidth,
+                          srcPixels + size_t(std::min(2 * curY + 1, srcHeight - 1)) * srcWidth, 0, width, srcWidth);
+        }
+
+        srcPixels = dst.data();
+        srcWidth  = width;
+        srcHeight = height;
+    }
+
+    piece.width   = srcWidth;
+    piece.height  = srcHeight;
+    piece.version = version;
+
+    pieceBytes_ += piece.pixels.size() * sizeof(uint32_t);
+
+    return piece;
+}
+
+// Tile of document is built again whole when any tile of document under it was written
+TileCache::Tile& TileCache::GetDocumentTile(uint32_t level, uint32_t tileX, uint32_t tileY) {
+    uint32_t tileSpan = ViewTileSize << level;
+    uint64_t version  = document_->GetVersion({tileX * tileSpan, tileY * tileSpan, tileSpan, tileSpan});
+
+    Tile& tile = tiles_[GetDocumentTileKey(level, tileX, tileY)];
+    tile.lastUsedFrame = frame_;
+
+    if (tile.isValid && (tile.version == version)) {
+        return tile;
+    }
+
+    ScopedTimer timer(ProfilePhase::Upload);
+
+    uint32_t x = tileX * ViewTileSize;
+    uint32_t y = tileY * ViewTileSize;
+    uint32_t width  = std::min(ViewTileSize, GetLevelSize(document_->GetWidth(),  level) - x);
+    uint32_t height = std::min(ViewTileSize, GetLevelSize(document_->GetHeight(), level) - y);
+
+    if ((tile.texture.getSize().x != width) || (tile.texture.getSize().y != height)) {
+        tile.texture.create(width, height);
+    }
+
+    uploadBuffer_.resize(size_t(width) * height * 4);
+
+    uint32_t pieceSize = DocumentTileSize >> level;
+
+    for (uint32_t pieceY = 0; pieceY * pieceSize < height; pieceY++) {
+        for (uint32_t pieceX = 0; pieceX * pieceSize < width; pieceX++) {
+            const Piece& piece = GetPiece(level, (tileX << level) + pieceX, (tileY << level) + pieceY);
+
+            for (uint32_t curY = 0; curY < piece.height; curY++) {
+                SwizzleToRGBA8(uploadBuffer_.data() + (size_t(pieceY * pieceSize + curY) * width + pieceX * pieceSize) * 4,
+                               piece.pixels.data() + size_t(curY) * piece.width, piece.width, UploadAlphaMask);
+            }
+        }
+    }
+
+    tile.texture.update(uploadBuffer_.data(), width, height, 0, 0);
+
+    tile.isValid = 1;
+    tile.version = version;
+
+    return tile;
+}
+
+// Pieces used in this frame are kept even if they take more memory than limit
+void TileCache::EvictPieces() {
+    if (pieceBytes_ <= MaxCachedPieceBytes) {
+        return;
+    }
+
+    evictBuffer_.clear();
+
+    for (auto& curPiece : pieces_) {
+        if (curPiece.second.lastUsedFrame != frame_) {
+            evictBuffer_.push_back({curPiece.second.lastUsedFrame, curPiece.first});
+        }
+    }
+
+    std::sort(evictBuffer_.begin(), evictBuffer_.end());
+
+    for (auto it = evictBuffer_.begin(); (it != evictBuffer_.end()) && (pieceBytes_ > MaxCachedPieceBytes); it++) {
+        auto found = pieces_.find(it->second);
+
+        pieceBytes_ -= found->second.pixels.size() * sizeof(uint32_t);
+        pieces_.erase(found);
+    }
+}
+
+uint32_t TileCache::ChooseLevel(double zoom) {
+    uint32_t level = 0;
+
+    while ((level < MaxViewMipLevel) && (zoom * double(2u << level) <= 1.0)) {
+        level++;
+    }
+
+    return level;
+}
+
+// View is in pixels of level 0 of image or document which tile belongs to
+void TileCache::DrawTile(Surface& target, Tile& tile, int64_t tileX, int64_t tileY, uint32_t level, double viewX, double viewY, double zoom) {
+    double levelScale = double(1u << level);
+    double drawScale  = zoom * levelScale;
+
+    // Zoomed in pixels stay sharp, so they can be edited one by one
+    tile.texture.setSmooth(drawScale < 1.0);
+
+    sf::Sprite sprite(tile.texture);
+    sprite.setPosition({float((double(tileX * ViewTileSize) * levelScale - viewX) * zoom),
+                        float((double(tileY * ViewTileSize) * levelScale - viewY) * zoom)});
+    sprite.setScale({float(drawScale), float(drawScale)});
+
+    target.draw(sprite);
+}
+
+// View is in document pixels, tiles which lie inside image are skipped, image is drawn over them
+void TileCache::DrawDocument(Surface& target, const PixelRect& image, uint32_t level, double viewX, double viewY, double zoom,
+                             uint32_t width, uint32_t height) {
+    double levelScale = double(1u << level);
+    uint32_t tileSpan = ViewTileSize << level;
+
+    int64_t left   = std::max(int64_t(std::floor(viewX / levelScale)), int64_t(0));
+    int64_t top    = std::max(int64_t(std::floor(viewY / levelScale)), int64_t(0));
+    int64_t right  = std::min(int64_t(std::ceil((viewX + width  / zoom) / levelScale)), int64_t(GetLevelSize(document_->GetWidth(),  level)));
+    int64_t bottom = std::min(int64_t(std::ceil((viewY + height / zoom) / levelScale)), int64_t(GetLevelSize(document_->GetHeight(), level)));
+
+    for (int64_t tileY = top / ViewTileSize; tileY * ViewTileSize < bottom; tileY++) {
+        for (int64_t tileX = left / ViewTileSize; tileX * ViewTileSize < right; tileX++) {
+            PixelRect tileRect = PixelRect({uint32_t(tileX) * tileSpan, uint32_t(tileY) * tileSpan, tileSpan, tileSpan})
+                                 .Intersected({0, 0, document_->GetWidth(), document_->GetHeight()});
+
+            if (image.Contains(tileRect)) {
+                continue;
+            }
+
+            DrawTile(target, GetDocumentTile(level, uint32_t(tileX), uint32_t(tileY)), tileX, tileY, level, viewX, viewY, zoom);
+        }
+    }
+
+    EvictPieces();
+}
+
+void TileCache::Draw(Surface& target, const Image& image, double viewX, double viewY, double zoom, uint32_t width, uint32_t height) {
+    if (levels_.empty()) {
+        return;
+    }
+
+    frame_++;
+
+    uint32_t level = ChooseLevel(zoom);
+
+    for (uint32_t curLevel = 1; curLevel <= level; curLevel++) {
+        BuildLevel(curLevel, image);
+    }
+
+    if (document_ && level) {
+        DrawDocument(target, {originX_, originY_, image.width_, image.height_}, level, viewX + originX_, viewY + originY_, zoom, width, height);
+    }
+
+    const Level& curLevel = levels_[level];
+
+    double levelScale = double(1u << level);
+
+    int64_t left   = std::max(int64_t(std::floor(viewX / levelScale)), int64_t(0));
+    int64_t top    = std::max(int64_t(std::floor(viewY / levelScale)), int64_t(0));
+    int64_t right  = std::min(int64_t(std::ceil((viewX + width  / zoom) / levelScale)), int64_t(curLevel.width));
+    int64_t bottom = std::min(int64_t(std::ceil((viewY + height / zoom) / levelScale)), int64_t(curLevel.height));
+
+    for (int64_t tileY = top / ViewTileSize; tileY * ViewTileSize < bottom; tileY++) {
+        for (int64_t tileX = left / ViewTileSize; tileX * ViewTileSize < right; tileX++) {
+            DrawTile(target, GetTile(level, uint32_t(tileX), uint32_t(tileY), image), tileX, tileY, level, viewX, viewY, zoom);
+        }
+    }
+
+    Evict();
+}
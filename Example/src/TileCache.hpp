@@ -0,0 +1,120 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+#include "Primitives.hpp"
+#include "TiledDocument.hpp"
+
+const uint32_t ViewTileSize    = 256;
+// Level k is image downscaled 2^k times, so zooming out to 1/16 still draws about one screen of pixels
+const uint32_t MaxViewMipLevel = 4;
+// 256 tiles of 256x256 are 64 MB of video memory
+const uint32_t MaxCachedTiles  = 256;
+// Downscaled document tiles are kept on CPU, so changed one is downscaled again without others
+const size_t   MaxCachedPieceBytes = size_t(64) << 20;
+
+// GPU copy of image split into tiles with mip levels.
+// Mip levels are rebuilt on CPU from the previous level only where image changed and only when they are drawn.
+// Tiles are uploaded when they become visible, then only changed parts of them, least recently drawn ones are dropped.
+// If image is part of document, mip levels also show document around it. They are built from tiles of document,
+// every tile is downscaled when it is read for the first time and again after it is written.
+class TileCache {
+    private:
+        struct Level {
+            uint32_t width;
+            uint32_t height;
+
+            // Empty for level 0, it is image itself
+            std::vector<uint32_t> pixels;
+
+            // Changed parts which weren't downscaled into this level yet
+            DirtyRegion stale;
+        };
+
+        // Tile of level 0 keeps changed rects and uploads only them, tiles of mip levels are uploaded whole after rebuild
+        struct Tile {
+            sf::Texture texture    = {};
+            bool isValid           = 0;
+            DirtyRegion dirty      = {};
+            uint64_t lastUsedFrame = 0;
+            // Version of document which tile of document was built from
+            uint64_t version       = 0;
+        };
+
+        // Tile of document downscaled to mip level, tiles at right and bottom edges may be smaller
+        struct Piece {
+            std::vector<uint32_t> pixels = {};
+            uint32_t width               = 0;
+            uint32_t height              = 0;
+            uint64_t version             = 0;
+            uint64_t lastUsedFrame       = 0;
+        };
+
+        std::vector<Level> levels_;
+        std::unordered_map<uint64_t, Tile> tiles_;
+
+        // Image starts at point (originX_, originY_) of document
+        const TiledDocument* document_;
+        uint32_t originX_;
+        uint32_t originY_;
+
+        std::unordered_map<uint64_t, Piece> pieces_;
+        size_t pieceBytes_;
+        std::vector<uint32_t> pieceBuffers_[2];
+
+        std::vector<uint8_t> uploadBuffer_;
+        // Last used frame and key of tiles which can be evicted, kept between frames
+        std::vector<std::pair<uint64_t, uint64_t>> evictBuffer_;
+        uint64_t frame_;
+
+        static uint64_t GetTileKey(uint32_t level, uint32_t tileX, uint32_t tileY) {
+            return (uint64_t(level) << 48) | (uint64_t(tileY) << 24) | tileX;
+        }
+
+        // Tiles of document are in the same map as tiles of image, their level has the highest bit set
+        static uint64_t GetDocumentTileKey(uint32_t level, uint32_t tileX, uint32_t tileY) {
+            return GetTileKey(level, tileX, tileY) | (uint64_t(1) << 63);
+        }
+
+        static uint32_t GetLevelSize(uint32_t size, uint32_t level);
+
+        void Reset(uint32_t width, uint32_t height);
+        void Invalidate(const PixelRect& rect);
+
+        void BuildLevel(uint32_t level, const Image& image);
+        const uint32_t* GetLevelPixels(uint32_t level, const Image& image, uint32_t& stride) const;
+
+        void UploadRect(Tile& tile, uint32_t level, const PixelRect& rect, uint32_t tileX, uint32_t tileY, const Image& image);
+        Tile& GetTile(uint32_t level, uint32_t tileX, uint32_t tileY, const Image& image);
+        void Evict();
+
+        const Piece& GetPiece(uint32_t level, uint32_t tileX, uint32_t tileY);
+        Tile& GetDocumentTile(uint32_t level, uint32_t tileX, uint32_t tileY);
+        void EvictPieces();
+
+        void DrawDocument(Surface& target, const PixelRect& image, uint32_t level, double viewX, double viewY, double zoom,
+                          uint32_t width, uint32_t height);
+        static void DrawTile(Surface& target, Tile& tile, int64_t tileX, int64_t tileY, uint32_t level, double viewX, double viewY, double zoom);
+
+    public:
+        TileCache();
+        ~TileCache();
+
+        TileCache(const TileCache& cache)            = delete;
+        TileCache& operator=(const TileCache& cache) = delete;
+
+        // Image is part of document starting at its point (originX, originY), without document it is the whole picture
+        void SetDocument(const TiledDocument* document, uint32_t originX, uint32_t originY);
+
+        // Takes changes of image, dirty region of image is cleared
+        void Update(Image& image);
+
+        static uint32_t ChooseLevel(double zoom);
+
+        // Image point (viewX, viewY) is drawn at target origin, one image pixel takes zoom pixels of target.
+        // On mip levels document is drawn under image, view may leave image then.
+        void Draw(Surface& target, const Image& image, double viewX, double viewY, double zoom, uint32_t width, uint32_t height);
+};
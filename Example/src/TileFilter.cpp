@@ -0,0 +1,207 @@
+#include "TileFilter.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Kernels.hpp"
+#include "Profiler.hpp"
+
+//-----------------------------------------------------------------------------
+// TileImage
+//-----------------------------------------------------------------------------
+
+PixelRect TileImage::ClipRect(int32_t x, int32_t y, uint32_t w, uint32_t h) const {
+    int64_t left   = std::max(int64_t(x), int64_t(writable_.x));
+    int64_t top    = std::max(int64_t(y), int64_t(writable_.y));
+    int64_t right  = std::min(int64_t(x) + w, int64_t(writable_.Right()));
+    int64_t bottom = std::min(int64_t(y) + h, int64_t(writable_.Bottom()));
+
+    if ((right <= left) || (bottom <= top)) {
+        return {0, 0, 0, 0};
+    }
+
+    return {uint32_t(left), uint32_t(top), uint32_t(right - left), uint32_t(bottom - top)};
+}
+
+booba::PixelBuffer TileImage::lock(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool write) {
+    PixelRect rect = PixelRect({x, y, w, h}).Intersected({0, 0, width_, height_});
+
+    if (write) {
+        rect = rect.Intersected(writable_);
+    }
+
+    return {pixels_ + size_t(rect.y) * stride_ + rect.x, rect.width, rect.height, stride_, rect.x, rect.y};
+}
+
+void TileImage::fillRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) {
+    PixelRect rect = ClipRect(x, y, w, h);
+    uint32_t premultiplied = MyColor(color).GetPremultiplied();
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++) {
+        FillPixels(pixels_ + size_t(curY) * stride_ + rect.x, rect.width, premultiplied);
+    }
+}
+
+void TileImage::putSpan(int32_t x, int32_t y, uint32_t w, const uint32_t* colors) {
+    blit(x, y, w, 1, colors, w);
+}
+
+void TileImage::blit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) {
+    PixelRect rect = ClipRect(x, y, w, h);
+
+    if (rect.IsEmpty()) {
+        return;
+    }
+
+    const uint32_t* srcRow = pixels + (int64_t(rect.y) - y) * stride + (int64_t(rect.x) - x);
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++, srcRow += stride) {
+        PremultiplyPixels(pixels_ + size_t(curY) * stride_ + rect.x, srcRow, rect.width);
+    }
+}
+
+void TileImage::blendRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) {
+    PixelRect rect = ClipRect(x, y, w, h);
+    uint32_t premultiplied = MyColor(color).GetPremultiplied();
+
+    if (rect.IsEmpty() || !premultiplied) {
+        return;
+    }
+
+    blendBuffer_.resize(rect.width);
+    FillPixels(blendBuffer_.data(), rect.width, premultiplied);
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++) {
+        BlendPixels(pixels_ + size_t(curY) * stride_ + rect.x, blendBuffer_.data(), rect.width);
+    }
+}
+
+void TileImage::blendBlit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) {
+    PixelRect rect = ClipRect(x, y, w, h);
+
+    if (rect.IsEmpty()) {
+        return;
+    }
+
+    blendBuffer_.resize(rect.width);
+
+    const uint32_t* srcRow = pixels + (int64_t(rect.y) - y) * stride + (int64_t(rect.x) - x);
+
+    for (uint32_t curY = rect.y; curY < rect.Bottom(); curY++, srcRow += stride) {
+        PremultiplyPixels(blendBuffer_.data(), srcRow, rect.width);
+        BlendPixels(pixels_ + size_t(curY) * stride_ + rect.x, blendBuffer_.data(), rect.width);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// FilterJob
+//-----------------------------------------------------------------------------
+
+FilterJob::FilterJob(Image* target, booba::Filter* filter, bool isParallel) :
+filter_(filter),
+target_(target),
+wholeFilter_(nullptr),
+event_(),
+isLegacyAccess_(0),
+isParallel_(isParallel),
+width_(target->width_), height_(target->height_),
+source_(size_t(target->width_) * target->height_),
+result_(),
+tilesTotal_(0),
+tilesDone_(0),
+isCancelled_(0),
+doneMutex_(),
+doneCondition_()
+{
+    for (uint32_t curY = 0; curY < height_; curY++) {
+        std::memcpy(source_.data() + size_t(curY) * width_, target_->GetPixels() + size_t(curY) * target_->GetStride(), size_t(width_) * sizeof(uint32_t));
+    }
+
+    // Pixels not written by filter stay the same
+    result_ = source_;
+}
+
+FilterJob::FilterJob(Image* target, booba::Tool* wholeFilter, const booba::Event& event, bool isLegacyAccess) :
+FilterJob(target, nullptr, 0)
+{
+    wholeFilter_    = wholeFilter;
+    event_          = event;
+    isLegacyAccess_ = isLegacyAccess;
+}
+
+FilterJob::~FilterJob() {
+    Cancel();
+    Wait();
+}
+
+void FilterJob::Start() {
+    JobSystem& jobSystem = JobSystem::GetInstance();
+
+    std::vector<PixelRect> tiles;
+
+    if (wholeFilter_) {
+        tiles.push_back({0, 0, width_, height_});
+    }
+    else {
+        for (uint32_t tileY = 0; tileY < height_; tileY += FilterTileSize) {
+            for (uint32_t tileX = 0; tileX < width_; tileX += FilterTileSize) {
+                tiles.push_back({tileX, tileY, std::min(FilterTileSize, width_ - tileX), std::min(FilterTileSize, height_ - tileY)});
+            }
+        }
+    }
+
+    tilesTotal_ = uint32_t(tiles.size());
+
+    if (!isParallel_) {
+        jobSystem.Submit([this, tiles]() {
+            for (auto& curTile : tiles) {
+                ProcessTile(curTile);
+            }
+        });
+
+        return;
+    }
+
+    for (auto& curTile : tiles) {
+        jobSystem.Submit([this, curTile]() { ProcessTile(curTile); });
+    }
+}
+
+void FilterJob::ProcessTile(const PixelRect& rect) {
+    if (!isCancelled_) {
+        TileImage src(source_.data(), width_, height_, width_, {0, 0, 0, 0});
+        TileImage dst(result_.data(), width_, height_, width_, rect);
+
+        if (wholeFilter_) {
+            ScopedTimer timer(ProfilePhase::ToolApply, wholeFilter_);
+
+            dst.SetLegacyAccess(isLegacyAccess_);
+            wholeFilter_->apply(&dst, &event_);
+            dst.SetLegacyAccess(0);
+        }
+        else {
+            ScopedTimer timer(ProfilePhase::ToolApply, filter_);
+            filter_->applyTile(&src, &dst, rect.x, rect.y, rect.width, rect.height);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(doneMutex_);
+
+    if (++tilesDone_ == tilesTotal_) {
+        doneCondition_.notify_all();
+    }
+}
+
+void FilterJob::Wait() {
+    std::unique_lock<std::mutex> lock(doneMutex_);
+
+    doneCondition_.wait(lock, [this]() { return IsDone(); });
+}
+
+void FilterJob::Commit() {
+    Wait();
+
+    if (!isCancelled_) {
+        target_->BlitPremultiplied(0, 0, width_, height_, result_.data(), width_);
+    }
+}
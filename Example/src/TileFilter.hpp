@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "../pluginsrc/tools.hpp"
+
+#include "JobSystem.hpp"
+#include "Primitives.hpp"
+
+const uint32_t FilterTileSize = 256;
+
+// Image over pixels of filter job. Can be read everywhere, but written only inside writable rect,
+// so tiles processed by different threads never touch the same pixels.
+class TileImage : public booba::Image {
+    private:
+        uint32_t* pixels_;
+
+        uint32_t width_;
+        uint32_t height_;
+        uint32_t stride_;
+
+        PixelRect writable_;
+
+        // Premultiplied source row of blendRect and blendBlit, image of one tile is used by one thread
+        std::vector<uint32_t> blendBuffer_;
+
+        // Legacy filter of addFilter gets straight colors from operator()
+        bool isLegacyAccess_;
+        mutable LegacyPixels legacyPixels_;
+
+        PixelRect ClipRect(int32_t x, int32_t y, uint32_t w, uint32_t h) const;
+
+    public:
+        TileImage(uint32_t* pixels, uint32_t width, uint32_t height, uint32_t stride, const PixelRect& writable) :
+        pixels_(pixels),
+        width_(width), height_(height), stride_(stride),
+        writable_(writable),
+        blendBuffer_(),
+        isLegacyAccess_(0),
+        legacyPixels_()
+        {}
+
+        TileImage(const TileImage& image)            = delete;
+        TileImage& operator=(const TileImage& image) = delete;
+
+        virtual ~TileImage() override {}
+
+        virtual uint32_t getH() override {
+            return height_;
+        }
+
+        virtual uint32_t getW() override {
+            return width_;
+        }
+
+        virtual uint32_t getPixel(int32_t x, int32_t y) override {
+            legacyPixels_.Flush();
+
+            if ((x < 0) || (y < 0) || (uint32_t(x) >= width_) || (uint32_t(y) >= height_)) {
+                return 0;
+            }
+
+            return MyColor::FromPremultiplied(pixels_[size_t(y) * stride_ + uint32_t(x)]);
+        }
+
+        virtual void putPixel(uint32_t x, uint32_t y, uint32_t color) override {
+            legacyPixels_.Flush();
+
+            if (writable_.Contains({x, y, 1, 1})) {
+                pixels_[size_t(y) * stride_ + x] = MyColor(color).GetPremultiplied();
+            }
+        }
+
+        virtual uint32_t& operator()(uint32_t x, uint32_t y) override {
+            assert((x < width_) && (y < height_));
+
+            if (isLegacyAccess_) {
+                return legacyPixels_.Access(pixels_ + size_t(y) * stride_ + x);
+            }
+
+            return pixels_[size_t(y) * stride_ + x];
+        }
+
+        virtual const uint32_t& operator()(uint32_t x, uint32_t y) const override {
+            assert((x < width_) && (y < height_));
+
+            if (isLegacyAccess_) {
+                return legacyPixels_.Access(pixels_ + size_t(y) * stride_ + x);
+            }
+
+            return pixels_[size_t(y) * stride_ + x];
+        }
+
+        void SetLegacyAccess(bool isLegacyAccess) {
+            legacyPixels_.Flush();
+
+            isLegacyAccess_ = isLegacyAccess;
+        }
+
+        virtual booba::PixelBuffer lock(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool write) override;
+
+        // Pixels are not copied on lock, so there is nothing to do
+        virtual void unlock() override {}
+
+        virtual void fillRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) override;
+        virtual void putSpan(int32_t x, int32_t y, uint32_t w, const uint32_t* colors) override;
+        virtual void blit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) override;
+
+        virtual void blendRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) override;
+        virtual void blendBlit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) override;
+};
+
+// Runs tile filter over snapshot of image on JobSystem. Result is put to image by one blit in Commit,
+// so image never shows half-filtered state and the whole filter is one history step.
+// Filter of addFilter is run the same way, as the only tile covering the whole image.
+class FilterJob {
+    private:
+        booba::Filter* filter_;
+        Image* target_;
+
+        // Whole image filter and event of click which started it, used when filter_ is null
+        booba::Tool* wholeFilter_;
+        booba::Event event_;
+        bool isLegacyAccess_;
+
+        // Filters of modules without tile-parallel capability get their tiles one by one, from one job
+        bool isParallel_;
+
+        uint32_t width_;
+        uint32_t height_;
+
+        std::vector<uint32_t> source_;
+        std::vector<uint32_t> result_;
+
+        uint32_t tilesTotal_;
+        std::atomic<uint32_t> tilesDone_;
+        std::atomic<bool> isCancelled_;
+
+        std::mutex doneMutex_;
+        std::condition_variable doneCondition_;
+
+        void ProcessTile(const PixelRect& rect);
+
+    public:
+        FilterJob(Image* target, booba::Filter* filter, bool isParallel);
+        FilterJob(Image* target, booba::Tool* wholeFilter, const booba::Event& event, bool isLegacyAccess);
+        ~FilterJob();
+
+        FilterJob(const FilterJob& job)            = delete;
+        FilterJob& operator=(const FilterJob& job) = delete;
+
+        void Start();
+
+        // Tiles which are not started yet are skipped
+        void Cancel() {
+            isCancelled_ = 1;
+        }
+
+        void Wait();
+
+        bool IsDone() const {
+            return tilesDone_ == tilesTotal_;
+        }
+
+        float GetProgress() const {
+            return tilesTotal_ ? float(tilesDone_) / float(tilesTotal_) : 1.f;
+        }
+
+        void Commit();
+};
@@ -0,0 +1,242 @@
+#include "TiledDocument.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+TiledDocument::TiledDocument() :
+fd_(-1),
+mapping_(nullptr),
+mappingSize_(0),
+header_(),
+tilesInRow_(0),
+tilesInColumn_(0),
+dirtyTiles_(),
+version_(0),
+tileVersions_()
+{}
+
+TiledDocument::~TiledDocument() {
+    Close();
+}
+
+bool TiledDocument::Create(const std::string& path, uint32_t width, uint32_t height) {
+    Close();
+
+    if ((width == 0) || (height == 0)) {
+        return false;
+    }
+
+    std::memcpy(header_.magic, DocumentMagic, sizeof(DocumentMagic));
+
+    header_.version    = DocumentVersion;
+    header_.tileSize   = DocumentTileSize;
+    header_.width      = width;
+    header_.height     = height;
+    header_.flags      = 0;
+    header_.reserved   = 0;
+    header_.dataOffset = DocumentDataAlignment;
+
+    uint64_t tilesAmount = uint64_t((width + DocumentTileSize - 1) / DocumentTileSize) * ((height + DocumentTileSize - 1) / DocumentTileSize);
+    uint64_t fileSize    = header_.dataOffset + tilesAmount * DocumentTileSize * DocumentTileSize * sizeof(uint32_t);
+
+    // File which failed to open may be another format or older version, it is never overwritten
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if (fd < 0) {
+        if (errno == EEXIST) {
+            fprintf(stderr, "Document %s already exists and isn't replaced\n", path.c_str());
+        }
+        else {
+            fprintf(stderr, "Unable to create document %s\n", path.c_str());
+        }
+
+        return false;
+    }
+
+    bool isWritten = (ftruncate(fd, off_t(fileSize)) == 0) && (pwrite(fd, &header_, sizeof(header_), 0) == ssize_t(sizeof(header_)));
+    close(fd);
+
+    if (!isWritten) {
+        fprintf(stderr, "Unable to write document %s\n", path.c_str());
+
+        unlink(path.c_str());
+        return false;
+    }
+
+    return Open(path);
+}
+
+bool TiledDocument::Open(const std::string& path) {
+    Close();
+
+    fd_ = open(path.c_str(), O_RDWR);
+
+    if (fd_ < 0) {
+        return false;
+    }
+
+    if (pread(fd_, &header_, sizeof(header_), 0) != ssize_t(sizeof(header_)) ||
+        (std::memcmp(header_.magic, DocumentMagic, sizeof(DocumentMagic)) != 0) || (header_.version != DocumentVersion)) {
+        fprintf(stderr, "%s is not a tiled document\n", path.c_str());
+
+        Close();
+        return false;
+    }
+
+    if ((header_.flags & DocumentCompressedFlag) || (header_.tileSize == 0) || (header_.dataOffset % DocumentDataAlignment)) {
+        fprintf(stderr, "Document %s has unsupported layout\n", path.c_str());
+
+        Close();
+        return false;
+    }
+
+    return Map(path);
+}
+
+bool TiledDocument::Map(const std::string& path) {
+    tilesInRow_    = (header_.width  + header_.tileSize - 1) / header_.tileSize;
+    tilesInColumn_ = (header_.height + header_.tileSize - 1) / header_.tileSize;
+
+    mappingSize_ = size_t(header_.dataOffset) + size_t(tilesInRow_) * tilesInColumn_ * header_.tileSize * header_.tileSize * sizeof(uint32_t);
+
+    off_t fileSize = lseek(fd_, 0, SEEK_END);
+
+    if ((fileSize < 0) || (size_t(fileSize) < mappingSize_)) {
+        fprintf(stderr, "Document %s is truncated\n", path.c_str());
+
+        Close();
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Unable to map document %s\n", path.c_str());
+
+        Close();
+        return false;
+    }
+
+    mapping_ = static_cast<uint8_t*>(mapping);
+    dirtyTiles_.assign(size_t(tilesInRow_) * tilesInColumn_, 0);
+    tileVersions_.assign(size_t(tilesInRow_) * tilesInColumn_, 0);
+
+    return true;
+}
+
+void TiledDocument::Close() {
+    if (mapping_) {
+        Flush();
+        munmap(mapping_, mappingSize_);
+    }
+
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+
+    fd_          = -1;
+    mapping_     = nullptr;
+    mappingSize_ = 0;
+
+    dirtyTiles_.clear();
+    tileVersions_.clear();
+}
+
+bool TiledDocument::Flush() {
+    if (!mapping_) {
+        return false;
+    }
+
+    size_t tileBytes = size_t(header_.tileSize) * header_.tileSize * sizeof(uint32_t);
+    bool isSynced = 1;
+
+    for (size_t tileIdx = 0; tileIdx < dirtyTiles_.size(); tileIdx++) {
+        if (!dirtyTiles_[tileIdx]) {
+            continue;
+        }
+
+        if (msync(mapping_ + header_.dataOffset + tileIdx * tileBytes, tileBytes, MS_SYNC) != 0) {
+            isSynced = 0;
+        }
+
+        dirtyTiles_[tileIdx] = 0;
+    }
+
+    return isSynced;
+}
+
+void TiledDocument::ReadRect(const PixelRect& rect, uint32_t* dst, uint32_t dstStride) const {
+    PixelRect clipped = rect.Intersected({0, 0, header_.width, header_.height});
+
+    if (!mapping_ || clipped.IsEmpty()) {
+        return;
+    }
+
+    uint32_t tileSize = header_.tileSize;
+
+    for (uint32_t tileY = clipped.y / tileSize; tileY <= (clipped.Bottom() - 1) / tileSize; tileY++) {
+        for (uint32_t tileX = clipped.x / tileSize; tileX <= (clipped.Right() - 1) / tileSize; tileX++) {
+            PixelRect part = clipped.Intersected({tileX * tileSize, tileY * tileSize, tileSize, tileSize});
+            const uint32_t* tile = GetTile(tileX, tileY);
+
+            for (uint32_t curY = part.y; curY < part.Bottom(); curY++) {
+                std::memcpy(dst + size_t(curY - rect.y) * dstStride + (part.x - rect.x),
+                            tile + size_t(curY - tileY * tileSize) * tileSize + (part.x - tileX * tileSize),
+                            size_t(part.width) * sizeof(uint32_t));
+            }
+        }
+    }
+}
+
+void TiledDocument::WriteRect(const PixelRect& rect, const uint32_t* src, uint32_t srcStride) {
+    PixelRect clipped = rect.Intersected({0, 0, header_.width, header_.height});
+
+    if (!mapping_ || clipped.IsEmpty()) {
+        return;
+    }
+
+    uint32_t tileSize = header_.tileSize;
+    version_++;
+
+    for (uint32_t tileY = clipped.y / tileSize; tileY <= (clipped.Bottom() - 1) / tileSize; tileY++) {
+        for (uint32_t tileX = clipped.x / tileSize; tileX <= (clipped.Right() - 1) / tileSize; tileX++) {
+            PixelRect part = clipped.Intersected({tileX * tileSize, tileY * tileSize, tileSize, tileSize});
+            uint32_t* tile = GetTile(tileX, tileY);
+
+            for (uint32_t curY = part.y; curY < part.Bottom(); curY++) {
+                std::memcpy(tile + size_t(curY - tileY * tileSize) * tileSize + (part.x - tileX * tileSize),
+                            src + size_t(curY - rect.y) * srcStride + (part.x - rect.x),
+                            size_t(part.width) * sizeof(uint32_t));
+            }
+
+            dirtyTiles_[size_t(tileY) * tilesInRow_ + tileX]   = 1;
+            tileVersions_[size_t(tileY) * tilesInRow_ + tileX] = version_;
+        }
+    }
+}
+
+uint64_t TiledDocument::GetVersion(const PixelRect& rect) const {
+    PixelRect clipped = rect.Intersected({0, 0, header_.width, header_.height});
+
+    if (!mapping_ || clipped.IsEmpty()) {
+        return 0;
+    }
+
+    uint32_t tileSize = header_.tileSize;
+    uint64_t version  = 0;
+
+    for (uint32_t tileY = clipped.y / tileSize; tileY <= (clipped.Bottom() - 1) / tileSize; tileY++) {
+        for (uint32_t tileX = clipped.x / tileSize; tileX <= (clipped.Right() - 1) / tileSize; tileX++) {
+            version = std::max(version, tileVersions_[size_t(tileY) * tilesInRow_ + tileX]);
+        }
+    }
+
+    return version;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PixelRect.hpp"
+
+const char     DocumentMagic[8]  = {'A', 'B', 'O', 'B', 'A', 'T', 'I', 'L'};
+const uint32_t DocumentVersion   = 1;
+const uint32_t DocumentTileSize  = 256;
+
+// Tiles are stored raw for now, flag is reserved so compressed files are refused instead of misread
+const uint32_t DocumentCompressedFlag = 1;
+
+// Tiles data starts at page boundary, so every tile can be synced separately
+const uint64_t DocumentDataAlignment = 4096;
+
+struct DocumentHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t tileSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t dataOffset;
+};
+
+// Image file split into square tiles, stored row by row of tiles. Pixels are 0xRRGGBBAA, edge tiles
+// are stored full. File is mapped into memory, so OS reads in only tiles which were accessed.
+class TiledDocument {
+    private:
+        int fd_;
+
+        uint8_t* mapping_;
+        size_t   mappingSize_;
+
+        DocumentHeader header_;
+
+        uint32_t tilesInRow_;
+        uint32_t tilesInColumn_;
+
+        std::vector<bool> dirtyTiles_;
+
+        // Every write gets next version, tile keeps version of the last write into it
+        uint64_t version_;
+        std::vector<uint64_t> tileVersions_;
+
+        bool Map(const std::string& path);
+
+        uint32_t* GetTile(uint32_t tileX, uint32_t tileY) const {
+            size_t tileBytes = size_t(header_.tileSize) * header_.tileSize * sizeof(uint32_t);
+
+            return reinterpret_cast<uint32_t*>(mapping_ + header_.dataOffset + (size_t(tileY) * tilesInRow_ + tileX) * tileBytes);
+        }
+
+    public:
+        TiledDocument();
+        ~TiledDocument();
+
+        TiledDocument(const TiledDocument& document)            = delete;
+        TiledDocument& operator=(const TiledDocument& document) = delete;
+
+        // New file is sparse, so all its pixels are 0 until written. Fails if path already exists.
+        bool Create(const std::string& path, uint32_t width, uint32_t height);
+        bool Open(const std::string& path);
+        void Close();
+
+        // Writes changed tiles to disk
+        bool Flush();
+
+        bool IsOpen() const {
+            return mapping_;
+        }
+
+        uint32_t GetWidth() const {
+            return header_.width;
+        }
+
+        uint32_t GetHeight() const {
+            return header_.height;
+        }
+
+        // Pixels of rect outside of document are not touched
+        void ReadRect(const PixelRect& rect, uint32_t* dst, uint32_t dstStride) const;
+        void WriteRect(const PixelRect& rect, const uint32_t* src, uint32_t srcStride);
+
+        // Version of the last write into tiles of rect, copies made from rect are stale once it grows
+        uint64_t GetVersion(const PixelRect& rect) const;
+};
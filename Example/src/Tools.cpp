@@ -3,20 +3,55 @@
 ToolManager* ToolManager::instance_ = nullptr;
 
 void booba::addTool(booba::Tool* tool) {
-    ToolManager::GetInstance().AddTool(tool);
+    PluginManager::GetInstance().OnAddTool(tool, nullptr, PluginToolKind::Tool);
+}
+
+void booba::addFilter(booba::Tool* tool) {
+    PluginManager::GetInstance().OnAddTool(tool, nullptr, PluginToolKind::Filter);
+}
+
+void booba::addTileFilter(booba::Filter* filter) {
+    PluginManager::GetInstance().OnAddTool(filter, filter, PluginToolKind::TileFilter);
+}
+
+void booba::reportAbi(uint32_t version, uint32_t eventSize, uint64_t capabilities) {
+    PluginManager::GetInstance().OnReportAbi(version, eventSize, capabilities);
 }
 
 ToolManager::ToolManager() :
 activeTool_(nullptr),
 tools_(),
-textures_()
+tileFilters_(),
+filters_(),
+icons_(),
+abis_(),
+activeAbi_(LegacyPluginAbi)
 {
     
 }
 
 void ToolPalette::InitTools(Canvas* canvas, ToolManager* manager, const uint64_t amount) {
     for (uint64_t curTool = (manager->GetToolSize() - amount); curTool < manager->GetToolSize(); curTool++) {
-        *this += new ToolButton(canvas, manager->GetTool(curTool));
+        *this += new ToolButton(canvas, manager->GetTool(curTool), manager->GetToolIcon(curTool));
+    }
+}
+
+void ToolPalette::RemoveTool(booba::Tool* tool) {
+    for (auto& curWidget : *manager_.GetWidgetsList()) {
+        ToolButton* curButton = static_cast<ToolButton*>(curWidget);
+
+        if (curButton->GetTool() != tool) {
+            continue;
+        }
+
+        if (curActive_ == curButton) {
+            curActive_ = nullptr;
+        }
+
+        Remove(curButton);
+        delete curButton;
+
+        return;
     }
 }
 
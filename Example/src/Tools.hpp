@@ -4,6 +4,17 @@
 #include "../pluginsrc/tools.hpp"
 
 #include "Image.hpp"
+#include "History.hpp"
+#include "Stroke.hpp"
+#include "TileFilter.hpp"
+#include "AsyncTool.hpp"
+#include "PluginManager.hpp"
+#include "PluginAbi.hpp"
+#include "IconCache.hpp"
+#include "SetupBar.hpp"
+#include "LayerList.hpp"
+#include "TiledDocument.hpp"
+#include "Profiler.hpp"
 
 class Canvas;
 
@@ -15,7 +26,14 @@ class ToolManager {
         booba::Tool* activeTool_;
 
         std::vector<booba::Tool*> tools_;
-        std::vector<sf::Texture*> textures_; 
+        std::vector<booba::Filter*> tileFilters_;
+        // Tools registered by addFilter, they are applied once per click by filter job
+        std::vector<booba::Tool*> filters_;
+        std::vector<IconHandle> icons_;
+
+        // ABI of module of every tool, parallel to tools_
+        std::vector<PluginAbi> abis_;
+        PluginAbi activeAbi_;
 
         ToolManager();
     public:
@@ -30,24 +48,131 @@ class ToolManager {
             return *instance_;
         }
 
-        void ApplyActive(booba::Image* image, const booba::Event* event) {
-            if (activeTool_) {
+        // Tools of legacy modules write image by operator() without lock, so image tracks every such pixel for them
+        void ApplyActive(Image* image, const booba::Event* event) {
+            if (activeTool_ && IsEventSupported(*event)) {
+                ScopedTimer timer(ProfilePhase::ToolApply, activeTool_);
+
+                image->SetLegacyAccess(!activeAbi_.Has(booba::AbiRawBuffer));
                 activeTool_->apply(image, event);
+                image->SetLegacyAccess(0);
             }
         }
 
+        booba::Tool* GetActiveTool() {
+            return activeTool_;
+        }
+
+        bool IsActiveCapable(uint64_t capability) {
+            return activeTool_ && activeAbi_.Has(capability);
+        }
+
+        // supportsAsync isn't in vtable of legacy modules, so it is asked only if module reported it
+        bool IsActiveAsync() {
+            return IsActiveCapable(booba::AbiAsync | booba::AbiRawBuffer) && activeTool_->supportsAsync();
+        }
+
+        // Modules without batched events get separate MouseMoved positions only
+        bool IsEventSupported(const booba::Event& event) {
+            return (event.type != booba::EventType::StrokeMoved) || IsActiveCapable(booba::AbiBatchedEvents);
+        }
+
+        // Plugin of lazy tool is initialized here, on main thread, before tool can get any event
         void SelectTool(booba::Tool* newTool) {
+            PluginManager::GetInstance().Prepare(newTool);
+
             activeTool_ = newTool;
+            activeAbi_  = GetToolAbi(newTool);
+
+            if (SetupBar::GetInstance()) {
+                SetupBar::GetInstance()->ShowTool(newTool);
+            }
         }
 
-        void AddTool(booba::Tool* newTool) {
+        void AddTool(booba::Tool* newTool, const PluginAbi& abi = HostPluginAbi) {
             tools_.push_back(newTool);
+            abis_.push_back(abi);
+
+            Profiler::GetInstance().RegisterTool(newTool, PluginManager::GetInstance().GetPluginName(newTool));
+
+            icons_.push_back(IconCache::GetInstance().Request(newTool->getTexture()));
+        }
+
+        PluginAbi GetToolAbi(booba::Tool* tool) {
+            for (uint64_t toolIdx = 0; toolIdx < tools_.size(); toolIdx++) {
+                if (tools_[toolIdx] == tool) {
+                    return abis_[toolIdx];
+                }
+            }
 
-            sf::Texture* newTexture = new sf::Texture();
+            return LegacyPluginAbi;
+        }
 
-            newTexture->loadFromFile(newTool->getTexture());
+        void SetToolAbi(booba::Tool* tool, const PluginAbi& abi) {
+            for (uint64_t toolIdx = 0; toolIdx < tools_.size(); toolIdx++) {
+                if (tools_[toolIdx] == tool) {
+                    abis_[toolIdx] = abi;
+                }
+            }
 
-            textures_.push_back(newTexture);
+            if (activeTool_ == tool) {
+                activeAbi_ = abi;
+            }
+        }
+
+        void RemoveTool(booba::Tool* tool) {
+            Profiler::GetInstance().ForgetTool(tool);
+
+            if (SetupBar::GetInstance()) {
+                SetupBar::GetInstance()->ForgetTool(tool);
+            }
+
+            for (uint64_t toolIdx = 0; toolIdx < tools_.size(); toolIdx++) {
+                if (tools_[toolIdx] == tool) {
+                    tools_.erase(tools_.begin() + int64_t(toolIdx));
+                    icons_.erase(icons_.begin() + int64_t(toolIdx));
+                    abis_.erase(abis_.begin() + int64_t(toolIdx));
+
+                    break;
+                }
+            }
+
+            tileFilters_.erase(std::remove_if(tileFilters_.begin(), tileFilters_.end(), [tool](booba::Filter* filter) {
+                return static_cast<booba::Tool*>(filter) == tool;
+            }), tileFilters_.end());
+
+            filters_.erase(std::remove(filters_.begin(), filters_.end(), tool), filters_.end());
+
+            if (activeTool_ == tool) {
+                activeTool_ = nullptr;
+            }
+        }
+
+        void AddTileFilter(booba::Filter* newFilter, const PluginAbi& abi = HostPluginAbi) {
+            AddTool(newFilter, abi);
+
+            tileFilters_.push_back(newFilter);
+        }
+
+        // Plugins are built without common RTTI, so filters are recognized by registration
+        booba::Filter* GetActiveTileFilter() {
+            for (auto& curFilter : tileFilters_) {
+                if (static_cast<booba::Tool*>(curFilter) == activeTool_) {
+                    return curFilter;
+                }
+            }
+
+            return nullptr;
+        }
+
+        void AddFilter(booba::Tool* newFilter, const PluginAbi& abi = HostPluginAbi) {
+            AddTool(newFilter, abi);
+
+            filters_.push_back(newFilter);
+        }
+
+        booba::Tool* GetActiveFilter() {
+            return (std::find(filters_.begin(), filters_.end(), activeTool_) != filters_.end()) ? activeTool_ : nullptr;
         }
 
         uint64_t GetToolSize() {
@@ -58,8 +183,8 @@ class ToolManager {
             return tools_[toolIdx];
         }
 
-        sf::Texture* GetToolTexture(const uint32_t toolIdx) {
-            return textures_[toolIdx];
+        IconHandle GetToolIcon(const uint64_t toolIdx) {
+            return icons_[toolIdx];
         }
 };
 
@@ -78,12 +203,56 @@ class ToolPalette : public DynamicWindow {
         ToolPalette& operator=(const ToolPalette& palette) = delete;
 
         void InitTools(Canvas* canvas, ToolManager* manager, const uint64_t amount);
+        void RemoveTool(booba::Tool* tool);
         void SetTool(ToolButton* newTool);
 };
 
+const int64_t  FilterProgressHeight = 4;
+const uint32_t FilterProgressColor  = 0x9400d3ff;
+
+// Ctrl+Add and Ctrl+Subtract change opacity of active layer by it
+const uint8_t  LayerOpacityStep     = 32;
+
 class Canvas : public ImageWindow {
     private:
         uint32_t curToolIdx_;
+
+        History history_;
+
+        StrokeSampler stroke_;
+
+        // Position of the last event sent to tool, rel_x and rel_y are counted from it
+        CordsPair lastToolPos_;
+
+        // Running tile filter, canvas ignores tools until it is committed
+        std::unique_ptr<FilterJob> filterJob_;
+
+        AsyncToolRunner asyncRunner_;
+
+        // Events of current stroke go to asyncRunner_
+        bool isAsyncStroke_;
+        // Async stroke is released, its history step ends when the last event is merged
+        bool isStrokeEnding_;
+
+        // In document mode layers show part of document starting at docX_, docY_, it is a tile wider than canvas
+        // on every side. Changed parts of composite are written back on save and before viewport moves,
+        // document is flat, so viewport moves only while layers are flat too.
+        std::unique_ptr<TiledDocument> document_;
+        uint32_t docX_;
+        uint32_t docY_;
+        DirtyRegion docDirty_;
+
+        // View is dragged with right button, lastPanPos_ is in canvas coordinates
+        bool isPanning_;
+        CordsPair lastPanPos_;
+
+        // Shows layers, canvas works without it too
+        LayerList* layerList_;
+
+        // Screen point to image point
+        CordsPair ConvertToImage(const CordsPair& cords) {
+            return ViewToImage(ConvertRealXY(cords));
+        }
     public:
         ToolManager& toolManager_;
         ToolPalette* toolPalette_;
@@ -91,82 +260,710 @@ class Canvas : public ImageWindow {
         Canvas(uint32_t x, uint32_t y, uint32_t width, uint32_t height, ToolPalette* palette) :
         ImageWindow(x, y, width, height),
         curToolIdx_(0),
+        history_(&layers_),
+        stroke_(),
+        lastToolPos_({0, 0}),
+        filterJob_(nullptr),
+        asyncRunner_(width, height),
+        isAsyncStroke_(0), isStrokeEnding_(0),
+        document_(nullptr), docX_(0), docY_(0), docDirty_(),
+        isPanning_(0), lastPanPos_({0, 0}),
+        layerList_(nullptr),
         toolManager_(ToolManager::GetInstance()),
         toolPalette_(palette)
         {
-            std::string dlPath = "./Plugins";
-            
-            for (const auto& curFile : std::filesystem::directory_iterator(dlPath)) {
-                if (curFile.is_directory()) {
-                    continue;
-                }
+            AttachLayer(&GetActiveImage());
 
-                void* dlHandler = dlopen(curFile.path().c_str(), RTLD_LAZY);
-                
-                if (dlHandler) {
-                    void (*initFunc)()     = nullptr;
-                    *((void**)(&initFunc)) = dlsym(dlHandler, "init_module");
+            PluginManager::GetInstance().LoadAll(DefaultToolsPath);
 
-                    (*initFunc)();
-                }
-                else {
-                    fprintf(stderr, "Unable to open plugin: %s\n", dlerror());
-                }
-            }
-            
             toolPalette_->InitTools(this, &toolManager_, toolManager_.GetToolSize());
         }
 
         Canvas(const Canvas& canvas)            = delete;
         Canvas& operator=(const Canvas& canvas) = delete;
 
+        void SetLayerList(LayerList* layerList) {
+            layerList_ = layerList;
+        }
+
+        void AttachLayer(Image* layer) {
+            layer->SetWriteHandler<MethodCaller<Canvas, PixelRect>>(this, &Canvas::OnImageWrite);
+        }
+
+        // Called for writes into any layer, only active one is written while stroke is recorded
+        void OnImageWrite(const PixelRect& rect) {
+            history_.Touch(rect);
+
+            if (document_) {
+                docDirty_.Add(rect);
+            }
+        }
+
+        // Opens tiled document, if there is no such file and sizes are given, creates it
+        bool OpenDocument(const char* path, uint32_t width = 0, uint32_t height = 0) {
+            FinishJobs();
+
+            auto newDocument = std::make_unique<TiledDocument>();
+
+            if (!newDocument->Open(path) && (!width || !height || !newDocument->Create(path, width, height))) {
+                return false;
+            }
+
+            if (document_) {
+                SaveDocument();
+            }
+
+            document_ = std::move(newDocument);
+            docX_ = 0;
+            docY_ = 0;
+
+            layers_.Resize(GetViewportSize(uint32_t(GetWidth()),  document_->GetWidth()),
+                           GetViewportSize(uint32_t(GetHeight()), document_->GetHeight()));
+
+            history_.SetDocument(document_.get());
+
+            if (layerList_) {
+                layerList_->Refresh();
+            }
+
+            LoadViewport();
+            ResetView();
+            return true;
+        }
+
+        void SaveDocument() {
+            if (!document_) {
+                return;
+            }
+
+            FinishJobs();
+            StoreViewport();
+
+            if (!document_->Flush()) {
+                fprintf(stderr, "Unable to save document\n");
+            }
+        }
+
+        // Canvas rounded up to tiles and a tile on every side, but not bigger than document
+        static uint32_t GetViewportSize(uint32_t canvasSize, uint32_t docSize) {
+            return std::min((canvasSize + DocumentTileSize - 1) / DocumentTileSize * DocumentTileSize + 2 * DocumentTileSize, docSize);
+        }
+
+        // History is kept in document coordinates, so it stays after viewport moves.
+        // Document keeps only flattened pixels, so viewport doesn't move until layers are flattened by Ctrl+F.
+        // Zoomed out view shows the rest of document from its mip levels. Returns how far it moved.
+        CordsPair MoveViewport(int64_t dx, int64_t dy) {
+            if (!document_ || !layers_.IsFlat()) {
+                return {0, 0};
+            }
+
+            int64_t maxX = int64_t(document_->GetWidth())  - layers_.GetWidth();
+            int64_t maxY = int64_t(document_->GetHeight()) - layers_.GetHeight();
+
+            uint32_t newX = uint32_t(std::clamp(int64_t(docX_) + dx, int64_t(0), maxX));
+            uint32_t newY = uint32_t(std::clamp(int64_t(docY_) + dy, int64_t(0), maxY));
+
+            if ((newX == docX_) && (newY == docY_)) {
+                return {0, 0};
+            }
+
+            FinishJobs();
+            StoreViewport();
+
+            CordsPair moved = {int32_t(newX) - int32_t(docX_), int32_t(newY) - int32_t(docY_)};
+
+            docX_ = newX;
+            docY_ = newY;
+
+            LoadViewport();
+            return moved;
+        }
+
+        // View which left viewport along axis is centered in it again. Viewport moves by whole tiles
+        // if they keep view in it, so dragged view pages in only after it passes at least half of tile.
+        static int64_t GetPageShift(double view, double visibleSize, double viewportSize) {
+            double margin = viewportSize - visibleSize;
+
+            if ((margin < 0) || ((view >= 0) && (view <= margin))) {
+                return 0;
+            }
+
+            double  center = view - margin / 2;
+            int64_t shift  = int64_t(std::round(center / DocumentTileSize)) * int64_t(DocumentTileSize);
+
+            if ((double(shift) < view - margin) || (double(shift) > view)) {
+                shift = int64_t(std::round(center));
+            }
+
+            return shift;
+        }
+
+        // Dragged or zoomed view of document moves viewport when it leaves it, the same document point stays under cursor
+        virtual void SetView(double x, double y, double zoom) override {
+            if (document_) {
+                double newZoom = std::clamp(zoom, MinViewZoom, MaxViewZoom);
+
+                CordsPair moved = MoveViewport(GetPageShift(x, double(GetWidth())  / newZoom, double(layers_.GetWidth())),
+                                               GetPageShift(y, double(GetHeight()) / newZoom, double(layers_.GetHeight())));
+
+                x -= moved.x;
+                y -= moved.y;
+            }
+
+            ImageWindow::SetView(x, y, zoom);
+        }
+
+        // Layers are flat here, so background is the whole viewport
+        void LoadViewport() {
+            history_.SetOrigin(docX_, docY_);
+            ShowDocument(document_.get(), docX_, docY_);
+
+            Image& background = GetActiveImage();
+
+            background.Clear();
+            document_->ReadRect({docX_, docY_, background.width_, background.height_}, background.GetPixels(), background.GetStride());
+            background.MarkDirty();
+
+            docDirty_.Clear();
+            asyncRunner_.Invalidate();
+
+            SetChanged();
+        }
+
+        void StoreViewport() {
+            const Image& composite = layers_.Update();
+
+            for (auto& curRect : docDirty_.GetRects()) {
+                const uint32_t* srcPixels = composite.GetPixels() + size_t(curRect.y) * composite.GetStride() + curRect.x;
+
+                document_->WriteRect({docX_ + curRect.x, docY_ + curRect.y, curRect.width, curRect.height}, srcPixels, composite.GetStride());
+            }
+
+            docDirty_.Clear();
+        }
+
         booba::Event ConvertToStandartEvent(const Event& event) {
             Event standartEvent = event;
 
-            if (event.type_ == EventType::MousePressed) {
-                CordsPair convertedCords = ConvertRealXY({event.Oleg_.mbedata.x, event.Oleg_.mbedata.y});
+            if ((event.type_ == EventType::MousePressed) || (event.type_ == EventType::MouseReleased)) {
+                CordsPair convertedCords = ConvertToImage({event.Oleg_.mbedata.x, event.Oleg_.mbedata.y});
 
                 standartEvent.Oleg_.mbedata.x = convertedCords.x;
                 standartEvent.Oleg_.mbedata.y = convertedCords.y;
+
+                lastToolPos_ = convertedCords;
             }
             else if (event.type_ == EventType::MouseMoved) {
-                CordsPair convertedCords = ConvertRealXY({event.Oleg_.motion.x, event.Oleg_.motion.y});
+                CordsPair convertedCords = ConvertToImage({event.Oleg_.motion.x, event.Oleg_.motion.y});
+
+                standartEvent.Oleg_.motion.x     = convertedCords.x;
+                standartEvent.Oleg_.motion.y     = convertedCords.y;
+                standartEvent.Oleg_.motion.rel_x = convertedCords.x - lastToolPos_.x;
+                standartEvent.Oleg_.motion.rel_y = convertedCords.y - lastToolPos_.y;
 
-                standartEvent.Oleg_.motion.rel_x = convertedCords.x;
-                standartEvent.Oleg_.motion.rel_y = convertedCords.y;
+                lastToolPos_ = convertedCords;
             }
 
-            return *reinterpret_cast<booba::Event*>(&standartEvent);
+            return ConvertToPluginEvent(standartEvent);
+        }
+
+        // Canvas is redrawn only if tool really changed something
+        void ApplyTool(const booba::Event& stEvent) {
+            if (!toolManager_.IsEventSupported(stEvent)) {
+                return;
+            }
+
+            if (isAsyncStroke_) {
+                asyncRunner_.Push(toolManager_.GetActiveTool(), stEvent);
+                return;
+            }
+
+            FinishAsync();
+            toolManager_.ApplyActive(&GetActiveImage(), &stEvent);
+
+            if (GetActiveImage().IsDirty()) {
+                asyncRunner_.Invalidate();
+                SetChanged();
+            }
+        }
+
+        // Setup widgets of active tool talk to it by usual events, changes made by one of them are one history step
+        void ApplySetupEvent(const booba::Event& stEvent) {
+            if (filterJob_ || stroke_.IsActive()) {
+                return;
+            }
+
+            FinishAsync();
+
+            history_.BeginStroke();
+            ApplyTool(stEvent);
+            history_.EndStroke();
+        }
+
+        // Image can be changed synchronously only after all async changes are in it
+        void FinishAsync() {
+            if (asyncRunner_.Drain(GetActiveImage())) {
+                SetChanged();
+            }
+
+            if (isStrokeEnding_) {
+                history_.EndStroke();
+                isStrokeEnding_ = 0;
+            }
+        }
+
+        // All positions of merged move are resampled and given to tool as one path
+        void ApplyStroke(const Event& curEvent) {
+            stroke_.ClearPoints();
+
+            if (curEvent.path_) {
+                for (uint32_t pointIdx = 0; pointIdx < curEvent.pathSize_; pointIdx++) {
+                    stroke_.AddSample(ConvertToImage(curEvent.path_[pointIdx]));
+                }
+            }
+            else {
+                stroke_.AddSample(ConvertToImage({curEvent.Oleg_.motion.x, curEvent.Oleg_.motion.y}));
+            }
+
+            if (stroke_.GetPoints().empty()) {
+                return;
+            }
+
+            Event strokeEvent;
+            strokeEvent.type_                 = EventType::StrokeMoved;
+            strokeEvent.Oleg_.stedata.points = stroke_.GetPoints().data();
+            strokeEvent.Oleg_.stedata.count  = uint32_t(stroke_.GetPoints().size());
+
+            ApplyTool(ConvertToPluginEvent(strokeEvent));
         }
 
         virtual void OnClick(const Event& curEvent) override {
             Window::OnClick(curEvent);
 
+            if ((curEvent.Oleg_.mbedata.button == MouseButton::Right) && IsClicked({curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y})) {
+                isPanning_  = 1;
+                lastPanPos_ = ConvertRealXY({curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y});
+
+                return;
+            }
+
+            if (filterJob_) {
+                return;
+            }
+
             if (IsClicked({curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y})) {
+                FinishAsync();
+
+                booba::Filter* tileFilter = toolManager_.GetActiveTileFilter();
+
+                if (tileFilter) {
+                    StartFilter(tileFilter);
+                    return;
+                }
+
                 booba::Event stEvent = ConvertToStandartEvent(curEvent);
 
-                toolManager_.ApplyActive(&image_, &stEvent);
+                booba::Tool* filter = toolManager_.GetActiveFilter();
+
+                if (filter) {
+                    StartFilter(filter, stEvent);
+                    return;
+                }
+
+                history_.BeginStroke();
+                stroke_.Begin(lastToolPos_);
+
+                isAsyncStroke_ = toolManager_.IsActiveAsync();
+
+                if (isAsyncStroke_) {
+                    asyncRunner_.Sync(GetActiveImage());
+                }
+
+                ApplyTool(stEvent);
             }
         }
 
         virtual void OnMove(const Event& curEvent) override {
             Window::OnMove(curEvent);
 
-            if (IsClicked({curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y})) {
-                booba::Event stEvent = ConvertToStandartEvent(curEvent);
-                
-                toolManager_.ApplyActive(&image_, &stEvent);
+            if (isPanning_) {
+                CordsPair panPos = ConvertRealXY({curEvent.Oleg_.motion.x, curEvent.Oleg_.motion.y});
+
+                PanView(lastPanPos_.x - panPos.x, lastPanPos_.y - panPos.y);
+                lastPanPos_ = panPos;
+
+                return;
+            }
+
+            if (filterJob_) {
+                return;
+            }
+
+            // Modules with batched events get the stroke instead of moves while it is drawn, others get only moves
+            if (stroke_.IsActive() && toolManager_.IsActiveCapable(booba::AbiBatchedEvents)) {
+                ApplyStroke(curEvent);
+                return;
+            }
+
+            if (!curEvent.path_) {
+                ApplyMove(curEvent, {curEvent.Oleg_.motion.x, curEvent.Oleg_.motion.y});
+                return;
             }
+
+            // Moves of frame are coalesced, every position of path is still given to tool, so it can interpolate
+            for (uint32_t pointIdx = 0; pointIdx < curEvent.pathSize_; pointIdx++) {
+                ApplyMove(curEvent, curEvent.path_[pointIdx]);
+            }
+        }
+
+        // Relative motion is counted from lastToolPos_ by ConvertToStandartEvent
+        void ApplyMove(const Event& curEvent, const CordsPair& cords) {
+            if (!IsClicked(cords)) {
+                return;
+            }
+
+            Event moveEvent = curEvent;
+            moveEvent.Oleg_.motion.x = cords.x;
+            moveEvent.Oleg_.motion.y = cords.y;
+
+            booba::Event stEvent = ConvertToStandartEvent(moveEvent);
+
+            ApplyTool(stEvent);
         }
 
         virtual void OnRelease(const Event& curEvent) override {
             Window::OnRelease(curEvent);
 
+            if (isPanning_ && (curEvent.Oleg_.mbedata.button == MouseButton::Right)) {
+                isPanning_ = 0;
+                return;
+            }
+
+            if (filterJob_) {
+                return;
+            }
+
             booba::Event stEvent = ConvertToStandartEvent(curEvent);
-            toolManager_.ApplyActive(&image_, &stEvent);
+            ApplyTool(stEvent);
+
+            stroke_.End();
+
+            if (isAsyncStroke_) {
+                isAsyncStroke_  = 0;
+                isStrokeEnding_ = 1;
+            }
+            else {
+                history_.EndStroke();
+            }
+        }
+
+        virtual void OnKeyboard(const Event& curEvent) override {
+            Window::OnKeyboard(curEvent);
+
+            if (filterJob_) {
+                return;
+            }
+
+            if (ChangeLayerByKey(curEvent.Oleg_.kpedata.code, curEvent.Oleg_.kpedata.ctrl)) {
+                return;
+            }
+
+            if (!curEvent.Oleg_.kpedata.ctrl) {
+                MoveByKey(curEvent.Oleg_.kpedata.code);
+                return;
+            }
+
+            if (curEvent.Oleg_.kpedata.code == Key::S) {
+                SaveDocument();
+                return;
+            }
+
+            if (curEvent.Oleg_.kpedata.code == Key::Num0) {
+                ResetView();
+                return;
+            }
+
+            FinishAsync();
+
+            bool isChanged = 0;
+
+            if (curEvent.Oleg_.kpedata.code == Key::Z) {
+                isChanged = history_.Undo();
+            }
+            else if (curEvent.Oleg_.kpedata.code == Key::Y) {
+                isChanged = history_.Redo();
+            }
+
+            if (isChanged) {
+                // Undo swaps pixels directly, without write handler
+                if (document_) {
+                    docDirty_.Add({0, 0, layers_.GetWidth(), layers_.GetHeight()});
+                }
+
+                asyncRunner_.Invalidate();
+                SetChanged();
+            }
+        }
+
+        // Zoom goes around cursor, so the point under it can be zoomed into
+        virtual void OnWheel(const Event& curEvent) override {
+            Window::OnWheel(curEvent);
+
+            ZoomAt(ConvertRealXY({curEvent.Oleg_.wedata.x, curEvent.Oleg_.wedata.y}), std::pow(ViewZoomStep, double(curEvent.Oleg_.wedata.delta)));
+        }
+
+        // Arrows move document viewport by tile
+        void MoveByKey(Key code) {
+            int64_t dx = 0;
+            int64_t dy = 0;
+
+            if (code == Key::Left) {
+                dx = -int64_t(DocumentTileSize);
+            }
+            else if (code == Key::Right) {
+                dx = int64_t(DocumentTileSize);
+            }
+            else if (code == Key::Up) {
+                dy = -int64_t(DocumentTileSize);
+            }
+            else if (code == Key::Down) {
+                dy = int64_t(DocumentTileSize);
+            }
+            else {
+                return;
+            }
+
+            if (document_ && !layers_.IsFlat()) {
+                ShowLayerStatus("Flatten layers by Ctrl+F to move viewport");
+                return;
+            }
+
+            MoveViewport(dx, dy);
+        }
+
+        // PageUp and PageDown choose upper and lower layer. With Ctrl L adds layer, Delete removes active one,
+        // H hides it, B changes its blend mode, Add and Subtract change its opacity, F flattens all layers.
+        bool ChangeLayerByKey(Key code, bool isCtrl) {
+            uint32_t activeIdx = layers_.GetActiveIdx();
+            const Layer& active = layers_.GetLayerInfo(activeIdx);
+
+            if (code == Key::PageUp) {
+                SelectLayer(activeIdx + 1);
+                return true;
+            }
+
+            if (code == Key::PageDown) {
+                if (activeIdx) {
+                    SelectLayer(activeIdx - 1);
+                }
+
+                return true;
+            }
+
+            if (!isCtrl) {
+                return false;
+            }
+
+            if (code == Key::L) {
+                AddLayer();
+                return true;
+            }
+
+            if (code == Key::Delete) {
+                RemoveLayer(activeIdx);
+                return true;
+            }
+
+            if (code == Key::F) {
+                FlattenLayers();
+                return true;
+            }
+
+            if (code == Key::H) {
+                layers_.SetVisible(activeIdx, !active.isVisible);
+            }
+            else if (code == Key::B) {
+                layers_.SetMode(activeIdx, BlendMode((uint32_t(active.mode) + 1) % BlendModesAmount));
+            }
+            else if (code == Key::Add) {
+                layers_.SetOpacity(activeIdx, uint8_t(std::min(active.opacity + LayerOpacityStep, 255)));
+            }
+            else if (code == Key::Subtract) {
+                layers_.SetOpacity(activeIdx, uint8_t(std::max(active.opacity - LayerOpacityStep, 0)));
+            }
+            else {
+                return false;
+            }
+
+            OnCompositeChanged();
+            return true;
+        }
+
+        // Layers are changed only when nothing else writes into them
+        void AddLayer() {
+            FinishJobs();
+
+            Image* layer = layers_.AddLayer();
+
+            if (!layer) {
+                ShowLayerStatus("Canvas has as many layers as it can");
+                return;
+            }
+
+            AttachLayer(layer);
+            history_.OnLayerAdded(layers_.GetActiveIdx());
+            OnActiveLayerChanged();
+        }
+
+        void RemoveLayer(uint32_t layerIdx) {
+            FinishJobs();
+
+            if (!layers_.RemoveLayer(layerIdx)) {
+                ShowLayerStatus("Background can't be removed");
+                return;
+            }
+
+            history_.OnLayerRemoved(layerIdx);
+            OnActiveLayerChanged();
+        }
+
+        // Flattening isn't undone, history starts again on background
+        void FlattenLayers() {
+            if (layers_.IsFlat()) {
+                return;
+            }
+
+            FinishJobs();
+
+            layers_.Flatten();
+            history_.Reset();
+            OnActiveLayerChanged();
         }
 
-        ~Canvas() {}
+        void SelectLayer(uint32_t layerIdx) {
+            if ((layerIdx >= layers_.GetLayersAmount()) || (layerIdx == layers_.GetActiveIdx())) {
+                return;
+            }
+
+            FinishJobs();
+
+            layers_.SetActive(layerIdx);
+            OnActiveLayerChanged();
+        }
+
+        // Entries of history keep their layers, only async tool has to start on new active layer
+        void OnActiveLayerChanged() {
+            asyncRunner_.Invalidate();
+
+            OnCompositeChanged();
+        }
+
+        void OnCompositeChanged() {
+            if (document_) {
+                docDirty_.Add({0, 0, layers_.GetWidth(), layers_.GetHeight()});
+            }
+
+            if (layerList_) {
+                layerList_->Refresh();
+            }
+
+            SetChanged();
+        }
+
+        void ShowLayerStatus(const char* text) {
+            if (layerList_) {
+                layerList_->ShowStatus(text);
+            }
+        }
+
+        void CommitFilter() {
+            history_.BeginStroke();
+            filterJob_->Commit();
+            history_.EndStroke();
+
+            asyncRunner_.Invalidate();
+
+            filterJob_.reset();
+            SetChanged();
+        }
+
+        // Waits for async tools and filter, so image is changed only by caller
+        void FinishJobs() {
+            FinishAsync();
+
+            if (filterJob_) {
+                filterJob_->Wait();
+                CommitFilter();
+            }
+        }
+
+        // Nothing may run tools of plugins while they are reloaded, image itself stays untouched
+        void ReloadPlugins() {
+            PluginManager& pluginManager = PluginManager::GetInstance();
+
+            if (!pluginManager.IsReloadReady()) {
+                return;
+            }
+
+            FinishJobs();
+
+            std::vector<booba::Tool*> removedTools;
+            uint64_t addedAmount = pluginManager.ReloadChanged(removedTools);
+
+            for (auto& curTool : removedTools) {
+                toolPalette_->RemoveTool(curTool);
+            }
+
+            toolPalette_->InitTools(this, &toolManager_, addedAmount);
+        }
+
+        void StartFilter(booba::Filter* filter) {
+            filterJob_ = std::make_unique<FilterJob>(&GetActiveImage(), filter, toolManager_.IsActiveCapable(booba::AbiTileParallel));
+            filterJob_->Start();
+
+            SetChanged();
+        }
+
+        void StartFilter(booba::Tool* filter, const booba::Event& event) {
+            filterJob_ = std::make_unique<FilterJob>(&GetActiveImage(), filter, event, !toolManager_.IsActiveCapable(booba::AbiRawBuffer));
+            filterJob_->Start();
+
+            SetChanged();
+        }
+
+        virtual void ReDraw() override {
+            ImageWindow::ReDraw();
+
+            if (filterJob_) {
+                Rectangle progressRect({int64_t(float(GetWidth()) * filterJob_->GetProgress()), FilterProgressHeight, 0, GetHeight() - FilterProgressHeight});
+                progressRect.Draw(widgetContainer_, FilterProgressColor);
+            }
+        }
+
+        // While filter or async tool runs canvas is changed every frame, so main loop doesn't wait for events
+        virtual void OnTick(const Event& curEvent) override {
+            if (asyncRunner_.Merge(GetActiveImage())) {
+                SetChanged();
+            }
+
+            if (isStrokeEnding_ && asyncRunner_.IsIdle()) {
+                FinishAsync();
+            }
+
+            if (filterJob_ && filterJob_->IsDone()) {
+                CommitFilter();
+            }
+
+            ImageWindow::OnTick(curEvent);
+
+            if (filterJob_ || isAsyncStroke_ || isStrokeEnding_) {
+                SetChanged();
+            }
+        }
+
+        ~Canvas() {
+            SaveDocument();
+        }
 };
 
 const uint32_t DefaultToolButtonWidth  = 50;
@@ -177,24 +974,24 @@ class ToolButton : public Button {
         Canvas*       canvas_;
 
         booba::Tool*  tool_;
-        sf::Texture*  toolTexture_;
+        IconHandle    icon_;
+
+        bool isIconReady_;
 
     public:
-        ToolButton(Canvas* curCanvas, booba::Tool* curTool) :
+        ToolButton(Canvas* curCanvas, booba::Tool* curTool, IconHandle icon) :
         Button(0, 0, DefaultToolButtonWidth, DefaultToolButtonHeight),
-        canvas_(curCanvas), tool_(curTool), toolTexture_(nullptr)
+        canvas_(curCanvas), tool_(curTool), icon_(icon), isIconReady_(0)
         {
-            clickAction_ = new MethodCaller<ToolButton, CordsPair>(this, &ToolButton::SetMeToCanvas);
-        
-            for (uint32_t toolIdx = 0; toolIdx < canvas_->toolManager_.GetToolSize(); toolIdx++) {
-                if (canvas_->toolManager_.GetTool(toolIdx) == curTool) {
-                    toolTexture_ = canvas_->toolManager_.GetToolTexture(toolIdx);
-                }
-            }
+            SetHandler<MethodCaller<ToolButton, CordsPair>>(this, &ToolButton::SetMeToCanvas);
         }
 
-        ToolButton(const ToolButton& toolB)            = default;
-        ToolButton& operator=(const ToolButton& toolB) = default;
+        ToolButton(const ToolButton& toolB)            = delete;
+        ToolButton& operator=(const ToolButton& toolB) = delete;
+
+        booba::Tool* GetTool() {
+            return tool_;
+        }
 
         virtual void FlagClicked([[maybe_unused]] const CordsPair& cords) override {}
         virtual void FlagReleased() override {}
@@ -211,10 +1008,26 @@ class ToolButton : public Button {
         virtual void ReDraw() override {
             Button::ReDraw();
 
-            sf::Texture texture;
+            sf::IntRect atlasRect;
 
-            Rectangle iconRect({DefaultToolButtonWidth, DefaultToolButtonHeight, 0, 0});
-            iconRect.Draw(widgetContainer_, toolTexture_);
+            if (IconCache::GetInstance().GetRect(icon_, atlasRect)) {
+                Rectangle iconRect({DefaultToolButtonWidth, DefaultToolButtonHeight, 0, 0});
+                iconRect.Draw(widgetContainer_, &IconCache::GetInstance().GetTexture(), atlasRect);
+            }
+        }
+
+        // Until icon is decoded button stays changed, so main loop keeps ticking and picks it up
+        virtual void OnTick(const Event& curEvent) override {
+            if (!isIconReady_ && IconCache::GetInstance().IsReady(icon_)) {
+                isIconReady_ = 1;
+                SetChanged();
+            }
+
+            Button::OnTick(curEvent);
+
+            if (!isIconReady_) {
+                SetChanged();
+            }
         }
 }; 
 
@@ -5,7 +5,8 @@ bool CmpDbl(const double num1, const double num2) {
 }
 
 int64_t GetTimeMiliseconds() {
-    auto curTime = std::chrono::system_clock::now();
+    // Monotonic, so clock corrections don't break click debouncing
+    auto curTime = std::chrono::steady_clock::now();
     auto sinceEpoch = curTime.time_since_epoch();
 
     auto miliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(sinceEpoch);
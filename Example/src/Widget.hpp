@@ -1,13 +1,16 @@
 #pragma once
 
-#include <list>
+#include <vector>
 #include <chrono>
+#include <algorithm>
 
 #include "Utilities.hpp"
 
 #include "CordsPair.hpp"
 #include "Event.hpp"
 #include "Primitives.hpp"
+#include "Profiler.hpp"
+#include "WidgetPool.hpp"
 
 class Window;
 
@@ -17,9 +20,13 @@ class Window;
 #define HAND_OF_MIDAS OnRelease
 
 class Widget {
+    private:
+        // Bumped on every change of widgets geometry, indices built for older generation are rebuilt
+        static uint64_t layoutGeneration_;
+
     protected:
         Widget* parent_;
-        sf::RenderTexture widgetContainer_;
+        Surface widgetContainer_;
 
         uint32_t widgetColor_;
     private:
@@ -29,6 +36,9 @@ class Widget {
         uint32_t shiftX_;
         uint32_t shiftY_;
 
+        CordsPair absoluteOrigin_;
+        uint64_t  originGeneration_;
+
     protected:   
         bool isClicked_;
         bool isHolded_;
@@ -37,9 +47,10 @@ class Widget {
         Widget(uint32_t shiftX, uint32_t shiftY, int64_t width, int64_t height) :
         parent_(nullptr), 
         widgetContainer_(),
-        widgetColor_(0xffffff00),
+        widgetColor_(0xffffffff),
         width_(width), height_(height),
         shiftX_(shiftX), shiftY_(shiftY),
+        absoluteOrigin_({0, 0}), originGeneration_(UINT64_MAX),
         isClicked_(0), isHolded_(0), isChanged_(1)
         {
             widgetContainer_.create(uint32_t(width_), uint32_t(height_));
@@ -47,6 +58,15 @@ class Widget {
 
         virtual ~Widget() {}
 
+        // Size of dynamic type comes to delete through virtual destructor, so it finds the same block
+        static void* operator new(size_t size) {
+            return WidgetPool::GetInstance().Allocate(size);
+        }
+
+        static void operator delete(void* ptr, size_t size) {
+            WidgetPool::GetInstance().Free(ptr, size);
+        }
+
         Widget& operator=([[maybe_unused]] const Widget& widgToCpy) = default;
         Widget(const Widget& widgToCpy) = default;
 
@@ -85,12 +105,14 @@ class Widget {
 
         virtual void ReDraw() = 0;
 
-        sf::RenderTexture& GetRenderTexture() {
+        Surface& GetRenderTexture() {
             return widgetContainer_;
         }
 
         virtual void ProcessRedraw() {
             if (isChanged_) {
+                ScopedTimer timer(ProfilePhase::ReDraw);
+
                 widgetContainer_.clear();
                 ReDraw();
 
@@ -98,16 +120,27 @@ class Widget {
             }
         }
 
+        // Parent calls display() itself after all children are placed
         virtual void PlaceTexture() {
-            sf::Sprite sprite(widgetContainer_.getTexture());
+            ScopedTimer timer(ProfilePhase::PlaceTexture);
+
+            sf::Sprite sprite(widgetContainer_.getTexture(), widgetContainer_.getTextureRect());
             sprite.setPosition({float(shiftX_), float(shiftY_)});
 
             parent_->GetRenderTexture().draw(sprite);
-            parent_->GetRenderTexture().display();
         }
 
+        bool IsChanged() const {
+            return isChanged_;
+        }
+
+        // Widget is ticked only when its parent was changed, so it has to be placed again every time
         virtual void HOT_FIESTA([[maybe_unused]] const Event& curEvent) {
-            ProcessRedraw();
+            if (isChanged_) {
+                ProcessRedraw();
+                widgetContainer_.display();
+            }
+
             PlaceTexture();
         }
 
@@ -126,12 +159,22 @@ class Widget {
 
         }
 
+        virtual void OnWheel([[maybe_unused]] const Event& curEvent) {
+
+        }
+
         virtual Widget* GetParent() {
             return parent_;
         }
 
         virtual void SetParent(Widget* newParent) {
             parent_ = newParent;
+
+            layoutGeneration_++;
+        }
+
+        static uint64_t GetLayoutGeneration() {
+            return layoutGeneration_;
         }
 
         int64_t GetWidth() const {
@@ -165,6 +208,8 @@ class Widget {
             height_ = newHeight;
             
             widgetContainer_.create(uint32_t(width_), uint32_t(height_));
+
+            layoutGeneration_++;
             SetChanged();
         }
 
@@ -172,53 +217,111 @@ class Widget {
             shiftX_ = newXShift;
             shiftY_ = newYShift;
 
+            layoutGeneration_++;
             SetChanged();
         }
 
-        CordsPair ConvertXY(const CordsPair& cords) {
-            Widget* curWidg = this;
-
-            int32_t x = cords.x;
-            int32_t y = cords.y;
+        // Origin of widget in coordinates of the root, cached until layout changes
+        CordsPair GetAbsoluteOrigin() {
+            if (originGeneration_ != layoutGeneration_) {
+                if (parent_) {
+                    CordsPair parentOrigin = parent_->GetAbsoluteOrigin();
 
-            while (curWidg->parent_) {
-                x += curWidg->shiftX_;
-                y += curWidg->shiftY_;
+                    absoluteOrigin_ = {parentOrigin.x + int32_t(shiftX_), parentOrigin.y + int32_t(shiftY_)};
+                }
+                else {
+                    absoluteOrigin_ = {0, 0};
+                }
 
-                curWidg = curWidg->parent_;
+                originGeneration_ = layoutGeneration_;
             }
 
-            return {x, y};
+            return absoluteOrigin_;
+        }
+
+        CordsPair ConvertXY(const CordsPair& cords) {
+            CordsPair origin = GetAbsoluteOrigin();
+
+            return {cords.x + origin.x, cords.y + origin.y};
         }
 
         CordsPair ConvertRealXY(const CordsPair& cords) {
-            std::list<Widget*> parentsList = {};
+            CordsPair origin = GetAbsoluteOrigin();
+
+            return {cords.x - origin.x, cords.y - origin.y};
+        }
+};
+
+// Children are indexed by their rects in parent coordinates. Index is sorted by top of rect and keeps
+// max bottom of every prefix, so search stops at first prefix which lies above the point.
+class ChildrenManager {
+    private:
+        struct IndexEntry {
+            Widget* widget;
+
+            int64_t left;
+            int64_t top;
+            int64_t right;
+            int64_t bottom;
+
+            int64_t maxBottom;
+        };
+
+        std::vector<Widget*> widgets_;
+
+        std::vector<IndexEntry> index_;
+        uint64_t indexGeneration_;
+        bool isIndexValid_;
 
-            for (Widget* curWidg = this; curWidg->parent_; curWidg = curWidg->parent_) {
-                parentsList.push_front(curWidg);
+        // Widgets which got previous move and press, they must see the cursor leaving. Pressed ones get
+        // every move until release.
+        std::vector<Widget*> hovered_;
+        std::vector<Widget*> pressed_;
+        std::vector<Widget*> underCursor_;
+
+        void BuildIndex() {
+            index_.clear();
+
+            for (auto& curWidget : widgets_) {
+                int64_t left = curWidget->GetShiftX();
+                int64_t top  = curWidget->GetShiftY();
+
+                index_.push_back({curWidget, left, top, left + curWidget->GetWidth(), top + curWidget->GetHeight(), 0});
             }
 
-            int32_t x = cords.x;
-            int32_t y = cords.y;
+            std::stable_sort(index_.begin(), index_.end(), [](const IndexEntry& a, const IndexEntry& b) {
+                return a.top < b.top;
+            });
+
+            int64_t maxBottom = INT64_MIN;
 
-            for (auto& curWidg : parentsList) {
-                x -= curWidg->shiftX_;
-                y -= curWidg->shiftY_;
+            for (auto& curEntry : index_) {
+                maxBottom = std::max(maxBottom, curEntry.bottom);
+                curEntry.maxBottom = maxBottom;
             }
 
-            return {x, y};
+            indexGeneration_ = Widget::GetLayoutGeneration();
+            isIndexValid_    = 1;
         }
-};
 
-class ChildrenManager {
-    private:
-        std::list<Widget*> widgets_;
+        static void Erase(std::vector<Widget*>& widgets, const Widget* widgetToErase) {
+            widgets.erase(std::remove(widgets.begin(), widgets.end(), widgetToErase), widgets.end());
+        }
+
+        static bool Contains(const std::vector<Widget*>& widgets, const Widget* widget) {
+            return std::find(widgets.begin(), widgets.end(), widget) != widgets.end();
+        }
 
     public:
         ChildrenManager() :
-        widgets_()
+        widgets_(),
+        index_(), indexGeneration_(0), isIndexValid_(0),
+        hovered_(), pressed_(), underCursor_()
         {}
 
+        ChildrenManager(const ChildrenManager& manager)            = delete;
+        ChildrenManager& operator=(const ChildrenManager& manager) = delete;
+
         ~ChildrenManager() {
             for (auto& curWidget : widgets_) {
                 delete curWidget;
@@ -231,32 +334,77 @@ class ChildrenManager {
             }
 
             widgets_.clear();
+
+            hovered_.clear();
+            pressed_.clear();
+            isIndexValid_ = 0;
         }
 
-        std::list<Widget*>* GetWidgetsList() {
+        std::vector<Widget*>* GetWidgetsList() {
             return &widgets_;
         }
 
         void operator+=(Widget* newWidget) {
             widgets_.push_back(newWidget);
+
+            isIndexValid_ = 0;
         }
 
         void operator-=(Widget* widgetToClose) {
-            for (auto it = widgets_.begin(); it != widgets_.end(); it++) {
-                if (*it == widgetToClose) {
-                    widgets_.erase(it);
+            Erase(widgets_, widgetToClose);
+            Erase(hovered_, widgetToClose);
+            Erase(pressed_, widgetToClose);
+            isIndexValid_ = 0;
+        }
+
+        // Children which rects contain cords given in parent coordinates, bounds are inclusive as in Window::IsClicked
+        void FindUnder(const CordsPair& cords, std::vector<Widget*>& found) {
+            if (!isIndexValid_ || (indexGeneration_ != Widget::GetLayoutGeneration())) {
+                BuildIndex();
+            }
+
+            found.clear();
+
+            auto end = std::upper_bound(index_.begin(), index_.end(), int64_t(cords.y), [](int64_t y, const IndexEntry& entry) {
+                return y < entry.top;
+            });
+
+            for (auto it = end; (it != index_.begin()) && ((it - 1)->maxBottom >= cords.y); it--) {
+                const IndexEntry& curEntry = *(it - 1);
+
+                if ((curEntry.left <= cords.x) && (cords.x <= curEntry.right) && (cords.y <= curEntry.bottom)) {
+                    found.push_back(curEntry.widget);
                 }
-            }  
+            }
         }
 
-        void TriggerMove(const Event& curEvent) {
-            for (auto& curWidget : widgets_) {
+        void TriggerMove(const Event& curEvent, const CordsPair& cords) {
+            FindUnder(cords, underCursor_);
+
+            for (auto& curWidget : underCursor_) {
                 curWidget->OnMove(curEvent);
             }
+
+            for (auto& curWidget : hovered_) {
+                if (!Contains(underCursor_, curWidget)) {
+                    curWidget->OnMove(curEvent);
+                }
+            }
+
+            // Pressed widgets follow the cursor until release, so drags can leave them
+            for (auto& curWidget : pressed_) {
+                if (!Contains(underCursor_, curWidget) && !Contains(hovered_, curWidget)) {
+                    curWidget->OnMove(curEvent);
+                }
+            }
+
+            std::swap(hovered_, underCursor_);
         }
 
-        void TriggerClick(const Event& curEvent) {
-            for (auto& curWidget : widgets_) {
+        void TriggerClick(const Event& curEvent, const CordsPair& cords) {
+            FindUnder(cords, pressed_);
+
+            for (auto& curWidget : pressed_) {
                 curWidget->OnClick(curEvent);
             }
         }
@@ -267,10 +415,22 @@ class ChildrenManager {
             }
         }
 
+        // Release goes to widgets which got the press, wherever the cursor is now
         void TriggerRelease(const Event& curEvent) {
-            for (auto& curWidget : widgets_) {
+            for (auto& curWidget : pressed_) {
                 curWidget->OnRelease(curEvent);
             }
+
+            pressed_.clear();
+        }
+
+        // underCursor_ is only scratch between moves, so it can be reused here
+        void TriggerWheel(const Event& curEvent, const CordsPair& cords) {
+            FindUnder(cords, underCursor_);
+
+            for (auto& curWidget : underCursor_) {
+                curWidget->OnWheel(curEvent);
+            }
         }
 
         void TriggetKeyPressed(const Event& curEvent) {
@@ -0,0 +1,59 @@
+#include "WidgetPool.hpp"
+
+#include <new>
+
+WidgetPool::WidgetPool() :
+freeLists_(),
+chunks_()
+{
+
+}
+
+// Chunk is cut into blocks of one size class, they are pushed into its free list
+void WidgetPool::AddChunk(size_t sizeClass) {
+    size_t blockSize = (sizeClass + 1) * WidgetBlockGranule;
+
+    chunks_.push_back(std::make_unique<uint8_t[]>(WidgetChunkSize));
+    uint8_t* chunk = chunks_.back().get();
+
+    for (size_t offset = 0; offset + blockSize <= WidgetChunkSize; offset += blockSize) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + offset);
+
+        block->next = freeLists_[sizeClass];
+        freeLists_[sizeClass] = block;
+    }
+}
+
+void* WidgetPool::Allocate(size_t size) {
+    if (!size || (size > MaxPooledWidgetSize)) {
+        return ::operator new(size);
+    }
+
+    size_t sizeClass = GetSizeClass(size);
+
+    if (!freeLists_[sizeClass]) {
+        AddChunk(sizeClass);
+    }
+
+    FreeBlock* block = freeLists_[sizeClass];
+    freeLists_[sizeClass] = block->next;
+
+    return block;
+}
+
+void WidgetPool::Free(void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+
+    if (!size || (size > MaxPooledWidgetSize)) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    size_t sizeClass = GetSizeClass(size);
+
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = freeLists_[sizeClass];
+    freeLists_[sizeClass] = block;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Blocks are multiples of granule, bigger widgets are allocated by global new
+const size_t WidgetBlockGranule     = 64;
+const size_t MaxPooledWidgetSize    = 4096;
+const size_t WidgetChunkSize        = 64 * 1024;
+
+// Memory of widgets, one free list per block size. Freed block keeps pointer to the next free one,
+// so neither allocation nor free touch the heap once chunk of block size exists.
+// Widgets are created and deleted by main thread only, so pool isn't locked.
+class WidgetPool {
+    private:
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        static const size_t SizeClassesAmount = MaxPooledWidgetSize / WidgetBlockGranule;
+
+        FreeBlock* freeLists_[SizeClassesAmount];
+        std::vector<std::unique_ptr<uint8_t[]>> chunks_;
+
+        WidgetPool();
+
+        static size_t GetSizeClass(size_t size) {
+            return (size + WidgetBlockGranule - 1) / WidgetBlockGranule - 1;
+        }
+
+        void AddChunk(size_t sizeClass);
+
+    public:
+        WidgetPool(const WidgetPool& pool)            = delete;
+        WidgetPool& operator=(const WidgetPool& pool) = delete;
+
+        static WidgetPool& GetInstance() {
+            static WidgetPool instance;
+
+            return instance;
+        }
+
+        void* Allocate(size_t size);
+        void  Free(void* ptr, size_t size);
+
+        uint64_t GetChunksAmount() const {
+            return chunks_.size();
+        }
+};
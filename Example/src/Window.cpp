@@ -1,3 +1,5 @@
 #include "Window.hpp"
 
 #include <iostream>
+
+uint64_t Widget::layoutGeneration_ = 0;
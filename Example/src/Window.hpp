@@ -1,6 +1,9 @@
 #pragma once
 
+#include <thread>
+
 #include "Widget.hpp"
+#include "EventRecorder.hpp"
 
 class DynamicWindow;
 
@@ -22,7 +25,7 @@ class Window : public Widget {
         virtual void OnMove(const Event& curEvent) override {
             Widget::OnMove(curEvent);
 
-            manager_.TriggerMove(curEvent);
+            manager_.TriggerMove(curEvent, ConvertRealXY({curEvent.Oleg_.motion.x, curEvent.Oleg_.motion.y}));
         }
 
         virtual bool IsClicked(const CordsPair& vec) override {
@@ -35,7 +38,7 @@ class Window : public Widget {
         virtual void OnClick(const Event& curEvent) override {
             Widget::OnClick(curEvent);
 
-            manager_.TriggerClick(curEvent);
+            manager_.TriggerClick(curEvent, ConvertRealXY({curEvent.Oleg_.mbedata.x, curEvent.Oleg_.mbedata.y}));
         }
 
         virtual void ReDraw() override {
@@ -44,9 +47,15 @@ class Window : public Widget {
             realWindowRect.Draw(widgetContainer_, widgetColor_);  
         }
 
+        // Changes of children are propagated to parents by SetChanged. So if window is not changed,
+        // its texture from previous frame is still valid and children are neither redrawn nor placed.
         virtual void OnTick(const Event& curEvent) override {
-            ProcessRedraw();
-            manager_.TriggerTick(curEvent);
+            if (isChanged_) {
+                ProcessRedraw();
+                manager_.TriggerTick(curEvent);
+
+                widgetContainer_.display();
+            }
 
             PlaceTexture();
         }
@@ -61,7 +70,13 @@ class Window : public Widget {
             manager_.TriggetKeyPressed(curEvent);
         }
 
+        virtual void OnWheel(const Event& curEvent) override {
+            manager_.TriggerWheel(curEvent, ConvertRealXY({curEvent.Oleg_.wedata.x, curEvent.Oleg_.wedata.y}));
+        }
+
+        // Children are drawn into container, so it can't share atlas page with them
         virtual void operator+=(Widget* newWidget) {
+            widgetContainer_.makeDedicated();
             newWidget->SetParent(this);
 
             manager_ += newWidget;
@@ -75,7 +90,7 @@ class Window : public Widget {
 
 
         virtual void SetParent(Widget* newParent) override {
-            parent_ = newParent;
+            Widget::SetParent(newParent);
 
             for (auto& curChild : *manager_.GetWidgetsList()) {
                 curChild->SetParent(this);
@@ -87,6 +102,8 @@ const int64_t TimeBetweenClicks = 30;
 const int64_t TimeBetweenKeys   = 50;
 const int64_t TimeBetweenTicks  = 10;
 
+const size_t DefaultMovePathCapacity = 256;
+
 class RealWindow final : public Window {
     private:
         sf::RenderWindow realWindow_;
@@ -96,12 +113,41 @@ class RealWindow final : public Window {
         int64_t lastReleasedTime_;
         int64_t lastTickTime_;
         int64_t lastMoveTime_;
+
+        std::vector<CordsPair> movePath_;
+        Event lastMove_;
+
+        // Time of event which is handled now, recorded one while replaying
+        int64_t eventTime_;
+
+        EventRecorder* recorder_;
+
+        EventReplayer* replayer_;
+        bool isRealtimeReplay_;
+        int64_t replayStart_;
+        std::vector<RecordedEvent> replayFrame_;
+        int64_t replayFrameTime_;
+        bool hasReplayFrame_;
+
+        // Event taken by WaitEvent, it is handled first by the next PollEvent
+        sf::Event waitedEvent_;
+        bool hasWaitedEvent_;
     public:
         RealWindow(uint32_t width, uint32_t height) :
         Window(0, 0, width, height),
         realWindow_(sf::VideoMode(width, height), "Window"),
-        lastPressedTime_(0), lastKeyPressedTime_(0), lastReleasedTime_(0), lastTickTime_(0), lastMoveTime_(0)
-        {};
+        lastPressedTime_(0), lastKeyPressedTime_(0), lastReleasedTime_(0), lastTickTime_(0), lastMoveTime_(0),
+        movePath_(), lastMove_(),
+        eventTime_(0),
+        recorder_(nullptr),
+        replayer_(nullptr), isRealtimeReplay_(0), replayStart_(0), replayFrame_(), replayFrameTime_(0), hasReplayFrame_(0),
+        waitedEvent_(), hasWaitedEvent_(0)
+        {
+            movePath_.reserve(DefaultMovePathCapacity);
+        };
+
+        RealWindow(const RealWindow& window)            = delete;
+        RealWindow& operator=(const RealWindow& window) = delete;
 
         ~RealWindow() {
             if (realWindow_.isOpen()) {
@@ -110,7 +156,9 @@ class RealWindow final : public Window {
         }
 
         virtual void PlaceTexture() override {
-            sf::Sprite sprite(widgetContainer_.getTexture());
+            ScopedTimer timer(ProfilePhase::PlaceTexture);
+
+            sf::Sprite sprite(widgetContainer_.getTexture(), widgetContainer_.getTextureRect());
             sprite.setPosition({float(GetShiftX()), float(GetShiftY())});
 
             realWindow_.draw(sprite);
@@ -136,36 +184,176 @@ class RealWindow final : public Window {
             realWindow_.display();
         }
 
-        void PollEvent() {
-            sf::Event curEvent;
-            realWindow_.pollEvent(curEvent);
+        void SetVerticalSync(bool isEnabled) {
+            realWindow_.setVerticalSyncEnabled(isEnabled);
+        }
 
-            Event myEvent(curEvent);
+        // Nothing has to be redrawn, so frame can be skipped until next event
+        bool IsIdle() const {
+            return !IsChanged();
+        }
 
-            switch (myEvent.type_) {
-                case EventType::Closed: {
+        // Converted events are written to recorder as they come
+        void SetRecorder(EventRecorder* recorder) {
+            recorder_ = recorder;
+        }
+
+        // While replaying, events of real window are ignored except closing. Replay is played at
+        // recorded speed or as fast as possible, every recorded frame is still handled as one frame.
+        void SetReplayer(EventReplayer* replayer, bool isRealtime) {
+            replayer_         = replayer;
+            isRealtimeReplay_ = isRealtime;
+            replayStart_      = GetTimeMiliseconds();
+            hasReplayFrame_   = 0;
+
+            // Recorded time starts from zero, the first click mustn't be taken for a double one
+            lastPressedTime_ = -TimeBetweenClicks;
+        }
+
+        bool IsReplaying() const {
+            return replayer_;
+        }
+
+        // Blocks until at least one event comes or timeoutMs passes, negative timeout waits for event only.
+        // Event isn't handled here, so waiting can be kept out of frame time by starting the frame after WaitEvent.
+        void WaitEvent(int64_t timeoutMs = -1) {
+            if (replayer_ || hasWaitedEvent_) {
+                return;
+            }
+
+            if (timeoutMs < 0) {
+                hasWaitedEvent_ = realWindow_.waitEvent(waitedEvent_);
+                return;
+            }
+
+            // SFML can't wait with timeout, so window is polled once a tick
+            int64_t deadline = GetTimeMiliseconds() + timeoutMs;
+
+            while (!(hasWaitedEvent_ = realWindow_.pollEvent(waitedEvent_)) && (GetTimeMiliseconds() < deadline)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(TimeBetweenTicks));
+            }
+        }
+
+        // Drains all pending events, then redraws widgets once. Returns false when replay is over.
+        bool PollEvent() {
+            if (replayer_) {
+                return PollReplay();
+            }
+
+            sf::Event sfEvent;
+
+            bool hasEvent = hasWaitedEvent_;
+
+            if (hasWaitedEvent_) {
+                sfEvent         = waitedEvent_;
+                hasWaitedEvent_ = 0;
+            }
+            else {
+                hasEvent = realWindow_.pollEvent(sfEvent);
+            }
+
+            for (; hasEvent; hasEvent = realWindow_.pollEvent(sfEvent)) {
+                Event curEvent(sfEvent);
+
+                if (recorder_) {
+                    recorder_->Record(curEvent);
+                }
+
+                HandleEvent(curEvent, GetTimeMiliseconds());
+            }
+
+            FlushMoves();
+
+            if (recorder_) {
+                recorder_->RecordFrame();
+            }
+
+            OnTick(Event());
+            return true;
+        }
+
+    private:
+        void HandleEvent(const Event& curEvent, int64_t eventTime) {
+            eventTime_ = eventTime;
+
+            if (curEvent.type_ == EventType::MouseMoved) {
+                if ((curEvent.Oleg_.motion.y < 0) || (curEvent.Oleg_.motion.y > GetHeight())) {
+                    return;
+                }
+
+                movePath_.push_back({curEvent.Oleg_.motion.x, curEvent.Oleg_.motion.y});
+                lastMove_ = curEvent;
+
+                return;
+            }
+
+            FlushMoves();
+            DispatchEvent(curEvent);
+        }
+
+        bool PollReplay() {
+            sf::Event sfEvent;
+
+            while (realWindow_.pollEvent(sfEvent)) {
+                if (sfEvent.type == sf::Event::Closed) {
                     Close();
+                }
+            }
 
-                    break;
+            if (!hasReplayFrame_) {
+                hasReplayFrame_ = replayer_->NextFrame(replayFrame_, replayFrameTime_);
+
+                if (!hasReplayFrame_) {
+                    return false;
                 }
+            }
 
-                case EventType::MouseMoved: {
-                    if ((curEvent.mouseMove.y < 0) || (curEvent.mouseMove.y > GetHeight())) {
-                        break;
-                    }
+            // Frame isn't due yet, widgets are still ticked, so async work goes on
+            if (!isRealtimeReplay_ || (GetTimeMiliseconds() - replayStart_ >= replayFrameTime_ / 1000)) {
+                for (auto& curRecorded : replayFrame_) {
+                    HandleEvent(curRecorded.event, curRecorded.timeUs / 1000);
+                }
 
-                    OnMove(curEvent);
+                FlushMoves();
+                hasReplayFrame_ = 0;
+            }
+
+            OnTick(Event());
+            return true;
+        }
+
+        void FlushMoves() {
+            if (movePath_.empty()) {
+                return;
+            }
+
+            ScopedTimer timer(ProfilePhase::Events);
+
+            lastMove_.path_     = movePath_.data();
+            lastMove_.pathSize_ = uint32_t(movePath_.size());
+
+            OnMove(lastMove_);
+
+            movePath_.clear();
+        }
+
+        void DispatchEvent(const Event& curEvent) {
+            ScopedTimer timer(ProfilePhase::Events);
+
+            switch (curEvent.type_) {
+                case EventType::Closed: {
+                    Close();
 
                     break;
                 }
 
                 case EventType::MousePressed: {
-                    if ((GetTimeMiliseconds() - lastPressedTime_) < TimeBetweenClicks)
+                    if ((eventTime_ - lastPressedTime_) < TimeBetweenClicks)
                         break;
 
                     OnClick(curEvent);
 
-                    lastPressedTime_ = GetTimeMiliseconds();
+                    lastPressedTime_ = eventTime_;
                     break;
                 }
 
@@ -181,17 +369,23 @@ class RealWindow final : public Window {
                     break;
                 }
 
+                case EventType::MouseWheeled: {
+                    OnWheel(curEvent);
+
+                    break;
+                }
+
                 case EventType::NoEvent:
+                case EventType::MouseMoved:
                 case EventType::ButtonClicked:
                 case EventType::ScrollbarMoved:
                 case EventType::CanvasMPressed:
                 case EventType::CanvasMReleased:
                 case EventType::CanvasMMoved:
+                case EventType::StrokeMoved:
                 default:
                     break;
             }
-
-            OnTick(curEvent);
         }
 };
 
@@ -202,9 +396,28 @@ class DynamicWindow : public Window {
         {}
 
         void operator+=(Widget* windowToAdd) override {
+            widgetContainer_.makeDedicated();
+
             windowToAdd->SetShifts(0, uint32_t(GetHeight()));
             SetSizes(std::max(GetWidth(), windowToAdd->GetWidth()), GetHeight() + windowToAdd->GetHeight());
 
             Window::operator+=(windowToAdd);
         }
+
+        // Children below removed one are moved up
+        void Remove(Widget* windowToRemove) {
+            *this -= windowToRemove;
+
+            int64_t newWidth  = 0;
+            int64_t newHeight = 0;
+
+            for (auto& curChild : *manager_.GetWidgetsList()) {
+                curChild->SetShifts(0, uint32_t(newHeight));
+
+                newWidth   = std::max(newWidth, curChild->GetWidth());
+                newHeight += curChild->GetHeight();
+            }
+
+            SetSizes(newWidth, newHeight);
+        }
 };
@@ -16,10 +16,30 @@ namespace booba { // boot of outstanding best api
 
     /**
      * @brief We require you to implement this;
-     * Only addTool and addFilter can be called in this function.
+     * Only addTool, addFilter, addTileFilter and reportAbi can be called in this function.
      */
     extern "C" void init_module();
 
+    /**
+     * @brief Version of this header. Module reports it by reportAbi from init_module.
+     * Module which doesn't report is treated as version 1: it gets no StrokeMoved events,
+     * supportsAsync isn't called and operator() of Image works without lock, pixel by pixel, with straight colors.
+     */
+    const uint32_t AbiVersion = 2;
+
+    /**
+     * @brief Capabilities module asks for in reportAbi. Host enables fast path only for asked ones.
+     */
+    const uint64_t AbiRawBuffer     = 1u << 0; // Image::operator() is used only inside lock, host doesn't track single pixels.
+    const uint64_t AbiBatchedEvents = 1u << 1; // Tool gets StrokeMoved instead of separate MouseMoved positions.
+    const uint64_t AbiTileParallel  = 1u << 2; // applyTile of Filter can be called for several tiles at once.
+    const uint64_t AbiAsync         = 1u << 3; // supportsAsync is asked. Needs AbiRawBuffer, image of worker can't track pixels.
+
+    /**
+     * @brief Size of Oleg, it is fixed, so new event data can be added without changing layout of Event.
+     */
+    const uint32_t EventDataSize = 32;
+
     enum class EventType
     {
         NoEvent        = 0, // Stub. Should be ignored.
@@ -32,6 +52,7 @@ namespace booba { // boot of outstanding best api
         CanvasMPressed  = 6, // Same as MousePressed, but on canvas. Data structure - CanvasEventData.
         CanvasMReleased = 7, // Same as MouseReleased, but on canvas. Data structure - CanvasEventData.
         CanvasMMoved    = 8, // Same as MouseMoved, but on canvas. Data structure - CanvasEventData.
+        StrokeMoved     = 9, // Mouse moved over image with pressed button. Data structure: StrokeEventData.
 
     };
 
@@ -45,7 +66,7 @@ namespace booba { // boot of outstanding best api
     {
         int32_t x, y;
         /**
-         * @brief Relative to previous mouse position.
+         * @brief Relative to previous mouse position sent to tool.
          */
         int32_t rel_x, rel_y; 
     };
@@ -87,6 +108,21 @@ namespace booba { // boot of outstanding best api
         int32_t x, y; 
     };
 
+    struct Point
+    {
+        int32_t x, y;
+    };
+
+    struct StrokeEventData
+    {
+        /**
+         * @brief Points of stroke path since previous StrokeMoved, resampled by host with fixed spacing.
+         * Start of stroke is not included, it comes with MousePressed. Array is valid only during apply.
+         */
+        const Point* points;
+        uint32_t count;
+    };
+
     /**
      * @brief booba::Event is used to transmit event inside plugin. 
      */
@@ -101,9 +137,32 @@ namespace booba { // boot of outstanding best api
             ButtonClickedEventData bcedata;
             ScrollMovedEventData smedata;
             CanvasEventData cedata;
+            StrokeEventData stedata;
+            uint8_t reserved[EventDataSize];
         } Oleg; //Object loading event group.
     };
 
+    static_assert(sizeof(Event::Oleg) == EventDataSize, "Event data must fit into EventDataSize");
+
+
+    /**
+     * @brief Region of image pixels locked by Image::lock.
+     * Pixel (x + i, y + j) of image is pixels[j * stride + i].
+     * Pixels are 0xRRGGBBAA premultiplied by alpha: every channel is already multiplied by alpha / 255.
+     */
+    struct PixelBuffer
+    {
+        uint32_t* pixels;
+        uint32_t  w, h;
+        /**
+         * @brief Distance between starts of neighbour rows in pixels. Can be greater than w.
+         */
+        uint32_t  stride;
+        /**
+         * @brief Image coords of the first pixel. Region may be clipped, so they can differ from ones given to lock.
+         */
+        uint32_t  x, y;
+    };
 
     class Image
     {
@@ -127,7 +186,7 @@ namespace booba { // boot of outstanding best api
          * 
          * @param x - x coord. Must be less than width
          * @param y - y coord. Must be less than height
-         * @return uint32_t - color of pixel
+         * @return uint32_t - straight (not premultiplied) color of pixel
          */
         virtual uint32_t getPixel(int32_t x, int32_t y) = 0;
 
@@ -136,12 +195,13 @@ namespace booba { // boot of outstanding best api
          * 
          * @param x - x coord. Must be less than width
          * @param y - y coord. Must be less than height
-         * @param color - color of new pixel.
+         * @param color - straight color of new pixel, it replaces old one.
          */
         virtual void putPixel(uint32_t x, uint32_t y, uint32_t color) = 0;     
 
         /**
-         * @brief Reference access to pixels.
+         * @brief Reference access to premultiplied pixels.
+         * Point must lie inside region locked by lock().
          * 
          * @param x - x coord. Must be less than width
          * @param y - y coord. Must be less than height
@@ -151,12 +211,90 @@ namespace booba { // boot of outstanding best api
 
         /**
          * @brief Const reference access to pixels.
+         * Point must lie inside region locked by lock().
          * 
          * @param x - x coord. Must be less than width
          * @param y - y coord. Must be less than height
          * @return uint32_t& - reference to color of point.
          */
         virtual const uint32_t& operator()(uint32_t x, uint32_t y) const = 0;
+
+        /**
+         * @brief Gives direct access to rectangle of pixels. Use it for bulk operations instead of getPixel/putPixel.
+         * Only one region can be locked at a time. Region is clipped by image bounds, write region may be clipped
+         * further, e.g. to tile of filter. Granted region is given by x, y, w and h of result.
+         * 
+         * @param x - x coord of region
+         * @param y - y coord of region
+         * @param w - width of region
+         * @param h - height of region
+         * @param write - if you are going to change pixels. Otherwise changes may be lost.
+         * @return PixelBuffer - locked pixels. pixels is nullptr if unsuccess.
+         */
+        virtual PixelBuffer lock(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool write) = 0;
+
+        /**
+         * @brief Commits changes made in locked region and unlocks it.
+         * Buffer returned by lock() is invalid after this call.
+         */
+        virtual void unlock() = 0;
+
+        /**
+         * @brief Fills rectangle with one color. Rectangle is clipped by image bounds.
+         * 
+         * @param x - x coord of rectangle
+         * @param y - y coord of rectangle
+         * @param w - width of rectangle
+         * @param h - height of rectangle
+         * @param color - straight color to fill with, it replaces old pixels.
+         */
+        virtual void fillRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) = 0;
+
+        /**
+         * @brief Puts horizontal line of pixels on image. Line is clipped by image bounds.
+         * 
+         * @param x - x coord of first pixel
+         * @param y - y coord of line
+         * @param w - amount of pixels
+         * @param colors - w straight colors of pixels.
+         */
+        virtual void putSpan(int32_t x, int32_t y, uint32_t w, const uint32_t* colors) = 0;
+
+        /**
+         * @brief Copies rectangle of pixels from buffer to image. Rectangle is clipped by image bounds.
+         * 
+         * @param x - x coord of rectangle on image
+         * @param y - y coord of rectangle on image
+         * @param w - width of rectangle
+         * @param h - height of rectangle
+         * @param pixels - straight source pixels. Pixel (i, j) of rectangle is pixels[j * stride + i].
+         * @param stride - distance between rows of source in pixels.
+         */
+        virtual void blit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) = 0;
+
+        /**
+         * @brief Blends one color over rectangle. Rectangle is clipped by image bounds.
+         * Use it instead of getPixel/putPixel for translucent drawing.
+         *
+         * @param x - x coord of rectangle
+         * @param y - y coord of rectangle
+         * @param w - width of rectangle
+         * @param h - height of rectangle
+         * @param color - straight color, its alpha is opacity.
+         */
+        virtual void blendRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color) = 0;
+
+        /**
+         * @brief Blends rectangle of pixels from buffer over image. Rectangle is clipped by image bounds.
+         *
+         * @param x - x coord of rectangle on image
+         * @param y - y coord of rectangle on image
+         * @param w - width of rectangle
+         * @param h - height of rectangle
+         * @param pixels - straight source pixels. Pixel (i, j) of rectangle is pixels[j * stride + i].
+         * @param stride - distance between rows of source in pixels.
+         */
+        virtual void blendBlit(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint32_t* pixels, uint32_t stride) = 0;
     protected:
         virtual ~Image() = 0;
     };
@@ -204,8 +342,39 @@ namespace booba { // boot of outstanding best api
         /**
          * @brief Build widget on toolbar by using createButoon/createLabel/createScrollbar/createCanvas
          * They will be added to toolbar.
+         * It is called once, when tool is selected for the first time. Toolbar shows widgets of selected tool only,
+         * their events come to apply of this tool.
          */
         virtual void buildSetupWidget() = 0;
+
+        /**
+         * @brief If tool can be applied on worker thread of app. Such tool gets events in the same order,
+         * but image changes become visible in next frames. Tool must not call createButton & co from apply.
+         * 
+         * @return true if apply can be called from other thread.
+         */
+        virtual bool supportsAsync() { return false; }
+    };
+
+    /**
+     * @brief Filter which can process image by parts.
+     * Host splits image into tiles and calls applyTile for them from several threads at once.
+     */
+    class Filter : public Tool
+    {
+    public:
+        /**
+         * @brief Processes one tile of image. Must not change state of filter and call functions of app,
+         * except of pixel functions.
+         * 
+         * @param src - whole image before filter. Read-only.
+         * @param dst - result image. Only pixels of tile can be written, other writes are ignored.
+         * @param x - x coordinate of tile
+         * @param y - y coordinate of tile
+         * @param w - width of tile
+         * @param h - height of tile
+         */
+        virtual void applyTile(Image* src, Image* dst, uint32_t x, uint32_t y, uint32_t w, uint32_t h) = 0;
     };
 
     // This functions are implemented by GUI lib. 
@@ -251,6 +420,7 @@ namespace booba { // boot of outstanding best api
     /**
      * @brief Creates canvas on some given toolbar.
      * This function can only be called during buildSetupWidget();
+     * Emits CanvasMPressed, CanvasMMoved and CanvasMReleased with coordinates relative to canvas.
      * @param x - x coordinate of new canvas
      * @param y - y coordinate of new canvas
      * @param w - width of new canvas
@@ -261,6 +431,8 @@ namespace booba { // boot of outstanding best api
     
     /**
      * @brief Puts pixel to canvas with given id
+     * Pixel is put to buffer of canvas, all pixels put during a frame are shown at once in the next one,
+     * so tool can redraw whole preview on every event.
      * @param canvas - id of canvas, returned by createCanvas
      * @param x - x coordinate of pixel.
      * @param y - y coordinate of pixel.
@@ -270,6 +442,8 @@ namespace booba { // boot of outstanding best api
     
     /**
      * @brief Blits image to canvas
+     * Image is loaded once for all sprites and icons, it is drawn over pixels of canvas when it is ready.
+     * Sprite put at the same place replaces previous one.
      * @param canvas - id of canvas, returned by createCanvas
      * @param x - x coordinate of sprite.
      * @param y - y coordinate of sprite.  
@@ -280,6 +454,81 @@ namespace booba { // boot of outstanding best api
      */
     extern "C" void putSprite(uint64_t canvas, int32_t x, int32_t y, uint32_t w, uint32_t h, const char* texture);
     
+    /**
+     * @brief Fills count pixels with color. Uses fastest SIMD instructions of CPU.
+     * @param dst - pixels to fill.
+     * @param count - amount of pixels.
+     * @param color - color to fill with.
+     */
+    extern "C" void fillPixels(uint32_t* dst, uint32_t count, uint32_t color);
+
+    /**
+     * @brief Blends src over dst: dst = src + dst * (1 - src.alpha). Both colors must be premultiplied by alpha.
+     * Uses fastest SIMD instructions of CPU.
+     * @param dst - pixels to blend on.
+     * @param src - pixels to blend.
+     * @param count - amount of pixels.
+     */
+    extern "C" void blendPixels(uint32_t* dst, const uint32_t* src, uint32_t count);
+
+    /**
+     * @brief Multiplies color channels by alpha. dst can be the same as src.
+     * Uses fastest SIMD instructions of CPU.
+     * @param dst - premultiplied pixels.
+     * @param src - source pixels.
+     * @param count - amount of pixels.
+     */
+    extern "C" void premultiplyPixels(uint32_t* dst, const uint32_t* src, uint32_t count);
+    
+    /**
+     * @brief Shape of brush registered by createBrush.
+     */
+    struct BrushShape
+    {
+        /**
+         * @brief 0..1, part of radius which is not faded to edge. Used only by round brush.
+         */
+        float hardness;
+        /**
+         * @brief Distance between stamps of strokeBrush in brush sizes, e.g. 0.25. Default is used if it is not positive.
+         */
+        float spacing;
+        /**
+         * @brief maskW x maskH coverage bitmap, row by row, 255 is fully covered. It is stretched to brush size.
+         * Round brush is used if mask is nullptr. Host copies it, so it may be freed after createBrush.
+         */
+        const uint8_t* mask;
+        uint32_t maskW, maskH;
+    };
+
+    /**
+     * @brief Registers brush once, host keeps masks rasterized for every size and subpixel offset it is stamped with.
+     * @param shape - shape of brush.
+     * @return id of brush, 0 if shape is wrong.
+     */
+    extern "C" uint64_t createBrush(const BrushShape* shape);
+
+    /**
+     * @brief Blends one stamp of brush centered at (x, y) over image. Stamp is clipped by image.
+     * @param image - image to draw on, it must not be locked.
+     * @param brush - id from createBrush.
+     * @param size - diameter in pixels.
+     * @param color - straight color, its alpha is multiplied by brush coverage.
+     */
+    extern "C" void stampBrush (Image* image, uint64_t brush, float x, float y, float size, uint32_t color);
+
+    /**
+     * @brief Stamps brush along polyline: at points[0] and then every spacing * size pixels.
+     * Path between points of different calls is not joined, StrokeMoved points are dense enough for it.
+     * @param image - image to draw on, it must not be locked.
+     * @param brush - id from createBrush.
+     * @param points - polyline, e.g. StrokeEventData points.
+     * @param count - amount of points.
+     * @param size - diameter in pixels.
+     * @param color - straight color, its alpha is multiplied by brush coverage.
+     */
+    extern "C" void strokeBrush(Image* image, uint64_t brush, const Point* points, uint32_t count, float size, uint32_t color);
+
     /**
      * @brief Adds tool to application.
      * @param tool - tool pointer. App will delete it on exit itself.
@@ -288,11 +537,30 @@ namespace booba { // boot of outstanding best api
 
    /**
      * @brief Adds filter to application.
-     * May be different with addTool only by place whrere icon will be placed.
+     * Click on image with selected filter calls apply once with MousePressed event, not on UI thread.
+     * apply gets copy of image, result is put to image at once, when apply returns.
      * @param tool - tool pointer. App will delete it on exit itself.
      */
     extern "C" void addFilter(Tool* tool);
 
+    /**
+     * @brief Adds tile filter to application.
+     * Click on image with selected filter runs it over the whole image in parallel,
+     * result is put to image at once, when all tiles are done.
+     * @param filter - filter pointer. App will delete it on exit itself.
+     */
+    extern "C" void addTileFilter(Filter* filter);
+
+    /**
+     * @brief Reports header module was built with and capabilities it wants. Called only from init_module:
+     * booba::reportAbi(booba::AbiVersion, sizeof(booba::Event), booba::AbiRawBuffer | booba::AbiBatchedEvents);
+     * Module with other eventSize is treated as version 1, unknown capabilities are ignored.
+     * @param version - AbiVersion of header.
+     * @param eventSize - sizeof(Event) of module.
+     * @param capabilities - mask of Abi* capabilities.
+     */
+    extern "C" void reportAbi(uint32_t version, uint32_t eventSize, uint64_t capabilities);
+
     /**
      * @brief Pointer to ApplicationCotext.
      * Pointer itself should be not changed. But fields can be changed.